@@ -0,0 +1,381 @@
+/*
+ * XDU - Benchmark harness.
+ *
+ * xdubench is xdu with a display that draws nothing.  It loads the
+ * tree the same way xdu does, then instead of handling events, times
+ * each stage of xdu on that tree and reports.
+ *
+ * Copyright (c)	Phillip C. Dykstra	1991, 1993, 1994
+ * The X Consortium, and any party obtaining a copy of these files from
+ * the X Consortium, directly or indirectly, is granted, free of charge, a
+ * full and unrestricted irrevocable, world-wide, paid up, royalty-free,
+ * nonexclusive right and license to deal in this software and
+ * documentation files (the "Software"), including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons who receive
+ * copies from any such party to do so.  This license includes without
+ * limitation a license to do the foregoing actions under any patents of
+ * the party supplying this software to the X Consortium.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include "xdu.h"
+#include "stats.h"
+
+/* internal routines */
+static int brepaint();
+static int bdrawrect();
+static int btextheight();
+static struct display bdisplay = { bdrawrect, btextheight, brepaint };
+
+static int width = 1600;	/* of the pretend window */
+static int height = 1200;
+static int repeat = 5;		/* times to repeat the drawing phases */
+static long npoints = 100000;	/* hit tests to make */
+static long nfinds = 1000;	/* names to find */
+static double scantime;		/* seconds to read and scan the inputs */
+static long ndraws;		/* calls to xdrawrect() */
+
+#define	MAXFOUND	20	/* biggest matches kept, as xdu lists */
+
+static char *orders[] = {
+	"first", "last", "alpha", "ralpha", "size", "rsize", NULL
+};
+static char *layouts[] = {
+	"columns", "treemap", NULL
+};
+
+static char usage[] = "\
+Usage: xdubench [-options ...] filename ...\n\
+\n\
+Times each stage of xdu on the output of du in the files\n\
+  options include:\n\
+  -geometry WxH  Size of the display to lay out (1600x1200)\n\
+  -repeat num    Times to repeat each drawing phase (5)\n\
+  -points num    Number of hit tests (100000)\n\
+  -finds num     Number of names to find (1000)\n\
+  -j num         Threads to read the files on (1)\n\
+  -scan          Time scanning the directories named instead\n\
+  -snapshot file Reuse and update a saved scan\n\
+  -apparent      Count the apparent sizes of scanned files\n\
+  -rate num      Scan at most num files a second\n\
+  -estimate      Time the estimate, and making it exact\n\
+  and any of xdu's sorting options, or others that say what to read\n\
+";
+
+/*
+ * Report one phase: its time, and how many things a second it did.
+ */
+static void
+report(phase, secs, count, what)
+char *phase;
+double secs;
+double count;
+char *what;
+{
+	printf("%-16s %10.3f sec %14.0f %-10s", phase, secs, count, what);
+	if (secs > 0)
+		printf(" %14.0f /sec\n", count / secs);
+	else
+		printf("\n");
+}
+
+/*
+ * Read the input the way parse_file() does, without building a tree,
+ * so that the cost of reading and scanning can be told apart from the
+ * cost of putting the entries into the tree.
+ */
+static void
+scanfile(filename)
+char *filename;
+{
+	char	buf[4096];
+	char	name[4096];
+	long	size;
+	struct	input	in;
+	struct	reader	*rp;
+	double	t;
+
+	memset((char *)&in, 0, sizeof(in));
+	in.filename = filename;
+	t = stattime();
+	rp = ropen(&in);
+	while (rgets(buf,sizeof(buf),rp) != NULL)
+		sscanf(buf, "%ld %s\n", &size, name);
+	rclose(rp);
+	scantime += stattime() - t;
+}
+
+/*
+ * pseudo random numbers, the same on every run
+ */
+static unsigned long
+rnd()
+{
+	static	unsigned long seed = 1;
+
+	seed ^= (seed << 13) & 0xffffffffUL;
+	seed ^= seed >> 17;
+	seed ^= (seed << 5) & 0xffffffffUL;
+	return	seed;
+}
+
+/*
+ * Four letters (or all, if fewer) from the name of a node picked
+ * at random, to look for
+ */
+static void
+pickname(buf, len)
+char *buf;
+int len;
+{
+	struct	node *np, *cp;
+	int	n;
+
+	np = &top;
+	while (np->child != NODE_NULL && rnd() % 4 != 0) {
+		n = 0;
+		for (cp = np->child; cp != NODE_NULL; cp = cp->peer)
+			n++;
+		n = rnd() % n;
+		for (cp = np->child; n > 0; cp = cp->peer)
+			n--;
+		np = cp;
+	}
+	n = strlen(NAME(np));
+	if (n > 4) {
+		strncpy(buf, NAME(np) + rnd() % (n - 3), 4);
+		buf[4] = '\0';
+	} else {
+		strncpy(buf, NAME(np), len - 1);
+		buf[len-1] = '\0';
+	}
+}
+
+main(argc, argv)
+int argc;
+char **argv;
+{
+	struct	node *found[MAXFOUND], **tops;
+	struct	rusage	ru;
+	char	**op, **lp;
+	char	phase[64];
+	double	t;
+	long	c, v, i, hits;
+	int	r, n, k;
+
+	/* one thread, unless asked, so the phases can be told apart */
+	nthreads = 1;
+
+	/* take out the options we know, leaving the rest for load() */
+	n = 1;
+	for (i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-geometry") == 0 && i+1 < argc) {
+			if (sscanf(argv[++i], "%dx%d", &width, &height) != 2
+			 || width < 1 || height < 1) {
+				fprintf(stderr, usage);
+				exit(1);
+			}
+		} else if (strcmp(argv[i], "-repeat") == 0 && i+1 < argc) {
+			repeat = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-points") == 0 && i+1 < argc) {
+			npoints = atol(argv[++i]);
+		} else if (strcmp(argv[i], "-finds") == 0 && i+1 < argc) {
+			nfinds = atol(argv[++i]);
+		} else if (strcmp(argv[i], "-j") == 0 && i+1 < argc) {
+			nthreads = atoi(argv[++i]);
+		} else if ((k = loadoption(argv[i])) > 0 && i+k <= argc) {
+			argv[n++] = argv[i];	/* for load() */
+			if (k > 1)
+				argv[n++] = argv[++i];
+		} else if (strcmp(argv[i], "-apparent") == 0) {
+			setmeasure("apparent");
+		} else if (strcmp(argv[i], "-n") == 0) {
+			setorder("size");
+		} else if (strcmp(argv[i], "-rn") == 0) {
+			setorder("rsize");
+		} else if (strcmp(argv[i], "-a") == 0) {
+			setorder("alpha");
+		} else if (strcmp(argv[i], "-ra") == 0) {
+			setorder("ralpha");
+		} else if (argv[i][0] == '-' && argv[i][1] != '\0') {
+			fprintf(stderr, usage);
+			exit(1);
+		} else {
+			argv[n++] = argv[i];
+		}
+	}
+	argv[n] = NULL;
+	argc = n;
+	if (argc < 2) {
+		fprintf(stderr, usage);
+		exit(1);
+	}
+
+	/* we want the whole display drawn in one go */
+	display = &bdisplay;
+	budget = 0;
+
+	/* time reading the du files by themselves, if there are any */
+	for (i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-scan") == 0)
+			break;		/* the rest are directories */
+		if ((k = loadoption(argv[i])) > 1)
+			i++;
+		else if (k == 0)
+			scanfile(argv[i]);
+	}
+	load(argc, argv);
+
+	printf("%-16s %14s %14s %-10s %14s\n",
+		"phase", "time", "count", "", "rate");
+
+	/* loading, as timed by load() */
+	if (estimating) {
+		report("estimate", stats.estimatetime, (double)stats.estdirs,
+			"dirs");
+		report("  files", stats.estimatetime, (double)stats.estsampled,
+			"files");
+		t = stattime();
+		while (estimateupdate() > 0)
+			;
+		t = stattime() - t;
+		report("make exact", t, (double)stats.refined, "dirs");
+	} else if (stats.scandirs > 0) {
+		report("scan", stats.parsetime, (double)stats.scandirs, "dirs");
+		report("  files", stats.parsetime, (double)stats.scanfiles,
+			"files");
+		report("  unchanged", stats.parsetime, (double)stats.scanreused,
+			"dirs");
+		report("  hard links", stats.parsetime, (double)stats.scanlinks,
+			"links");
+		report("  operations", stats.parsetime, (double)stats.scanops,
+			"ops");
+		if (stats.throttletime > 0 || stats.backoffs > 0)
+			report("  held back", stats.throttletime,
+				(double)stats.backoffs, "backoffs");
+	} else if (stats.threads > 1) {
+		/* read at once, so reading and building overlap */
+		sprintf(phase, "read+build x%ld", stats.threads);
+		report(phase, stats.parsetime, (double)stats.lines, "lines");
+		report("  inputs", stats.parsetime, (double)stats.inputs,
+			"inputs");
+	} else {
+		report("read+scan", scantime, (double)stats.lines, "lines");
+		report("  bytes", scantime, (double)stats.readbytes, "bytes");
+		report("tree build", stats.parsetime - scantime,
+			(double)stats.lines, "lines");
+		report("  compares", stats.parsetime - scantime,
+			(double)stats.strcmps, "strcmps");
+	}
+	report("totals", stats.totaltime, (double)stats.nodes, "nodes");
+
+	/* each sort order, ending up sorted by size */
+	t = stattime();
+	nameranks();
+	report("rank names", stattime() - t, (double)stats.names, "names");
+	for (op = orders; *op != NULL; op++) {
+		setorder(*op);
+		c = stats.compares;
+		t = stattime();
+		sorttree(&top, order);
+		t = stattime() - t;
+		sprintf(phase, "sort %s", *op);
+		report(phase, t, (double)(stats.compares - c), "compares");
+	}
+	setorder("size");
+	sorttree(&top, order);
+
+	for (lp = layouts; *lp != NULL; lp++) {
+		/* lay out and draw the whole tree from the root */
+		setlayout(*lp);
+		c = ndraws;
+		v = stats.visits;
+		t = stattime();
+		for (r = 0; r < repeat; r++)
+			brepaint();
+		t = stattime() - t;
+		sprintf(phase, "draw %s", *lp);
+		report(phase, t, (double)(ndraws - c), "boxes");
+		report("  visits", t, (double)(stats.visits - v), "nodes");
+
+		/* then hit test all over it */
+		hits = 0;
+		t = stattime();
+		for (i = 0; i < npoints; i++) {
+			if (findnode(topp, (int)(rnd() % width),
+			    (int)(rnd() % height)) != NULL)
+				hits++;
+		}
+		t = stattime() - t;
+		sprintf(phase, "hit %s", *lp);
+		report(phase, t, (double)npoints, "points");
+	}
+
+	/* index the names, then find bits of random ones */
+	t = stattime();
+	searchmore(0);
+	t = stattime() - t;
+	report("index names", t, (double)stats.searchnodes, "names");
+	hits = 0;
+	t = stattime();
+	for (i = 0; i < nfinds; i++) {
+		pickname(phase, sizeof(phase));
+		hits += searchfind(phase, found, MAXFOUND);
+	}
+	t = stattime() - t;
+	report("find", t, (double)nfinds, "finds");
+	report("  matches", t, (double)hits, "nodes");
+
+	/* the biggest anywhere, as the k key lists them */
+	tops = (struct node **)malloc(2 * topk * sizeof(struct node *));
+	v = stats.topvisits;
+	t = stattime();
+	for (r = 0; r < repeat; r++)
+		topfind(&top, topk, tops, (int *)NULL, tops + topk, (int *)NULL);
+	t = stattime() - t;
+	sprintf(phase, "top %d", topk);
+	report(phase, t, (double)(stats.topvisits - v), "nodes");
+
+	/* the space by extension, as the e key shows it */
+	v = stats.breakvisits;
+	t = stattime();
+	for (r = 0; r < repeat; r++) {
+		totalstale = 1;		/* so it isn't just kept from the last */
+		breakdown(&top, BY_EXT, &n);
+	}
+	t = stattime() - t;
+	report("breakdown", t, (double)(stats.breakvisits - v), "nodes");
+
+	getrusage(RUSAGE_SELF, &ru);
+	printf("%-16s %10ld KB\n", "peak rss", (long)ru.ru_maxrss);
+	exit(0);
+}
+
+/*  Display Routines  */
+
+static int
+brepaint()
+{
+	if (repaint(width, height))
+		while (drawmore())
+			;
+}
+
+static int
+bdrawrect(name, size, x, y, width, height)
+char *name;
+char *size;	/* as it should be shown */
+int x, y, width, height;
+{
+	ndraws++;
+}
+
+static int
+btextheight()
+{
+	return	14;
+}
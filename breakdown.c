@@ -0,0 +1,547 @@
+/*
+ * XDU - What the space is taken by, and whose it is.
+ *
+ * Besides where the space goes, the space below a node can be broken
+ * down by the extensions of the files' names and by who owns them.
+ * A directory that was scanned keeps how much of its own size was in
+ * files of each extension and of each owner (a few of each, as a
+ * rule).  Of du output only the names are known, so a node with
+ * nothing below it goes by the extension of its name, and has no
+ * owner.  What isn't in any file known of (the directories themselves,
+ * estimates, and the own size of a directory du listed) is "(other)".
+ *
+ * A breakdown is one walk over the subtree, adding up into a hash
+ * table for each.  A big subtree is cut up amongst threads as for the
+ * totals, each thread with tables of its own, which are merged at the
+ * end.  The last few breakdowns are kept, so going back to a node
+ * costs nothing until the tree changes.
+ *
+ * Copyright (c)	Phillip C. Dykstra	1991, 1993, 1994
+ * The X Consortium, and any party obtaining a copy of these files from
+ * the X Consortium, directly or indirectly, is granted, free of charge, a
+ * full and unrestricted irrevocable, world-wide, paid up, royalty-free,
+ * nonexclusive right and license to deal in this software and
+ * documentation files (the "Software"), including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons who receive
+ * copies from any such party to do so.  This license includes without
+ * limitation a license to do the foregoing actions under any patents of
+ * the party supplying this software to the X Consortium.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <unistd.h>
+#include <pwd.h>
+#include <pthread.h>
+#include "xdu.h"
+#include "stats.h"
+
+#define	MAXEXT		8	/* longer than this isn't an extension */
+#define	NCACHE		16	/* breakdowns kept */
+#define	NTASKS		16	/* subtrees to cut the tree into, per thread */
+#define	MINSPLIT	65536	/* fewer nodes than this aren't worth threads */
+#define	KEY_EMPTY	0xfffffffdU	/* a free slot in a tally */
+
+/* EXPORTS: routines that this module exports outside */
+extern unsigned int extkey();
+extern void addshare();
+extern void clearshares();
+extern struct share *breakdown();
+extern char *breaktext();
+extern char *keyname();
+
+/* internal routines */
+static void tally();
+static void visit();
+static void walk();
+static void *worker();
+static void extnames();
+static void compute();
+static int sharecmp();
+
+/*
+ * Tally Structure
+ * Space added up by key, in an open hash table.  Sizes are kept in
+ * bytes, so that apparent sizes add up before they are rounded.
+ */
+struct tally {
+	struct	share *s;	/* own is what is added up */
+	long	n;		/* keys in it */
+	long	max;		/* slots, a power of two */
+};
+
+/*
+ * One breakdown of a node, by each of the things it can be broken
+ * down by, biggest first
+ */
+static struct cache {
+	struct	node *np;
+	long	gen;		/* totalgen when it was made */
+	struct	share *shares[NBY];
+	int	nshares[NBY];
+} cache[NCACHE];
+static int nextcache;
+
+/* the subtrees below the top levels, for the threads */
+static struct node **tasks;
+static long ntasks, nexttask, grab;
+static pthread_mutex_t tasklock = PTHREAD_MUTEX_INITIALIZER;
+
+/* extension of each name, alongside namestrs[] */
+static unsigned int *extids[NAMECHUNKS];
+static unsigned int nextids;
+#define	EXTID(id)	extids[(id) >> NAMESHIFT][(id) & NAMEMASK]
+
+/*
+ * The key of a file name's extension, taken to be what follows the
+ * last dot, if it is short and all letters and digits (so .bashrc and
+ * core.12345678901 have none).  Version numbers are passed over, so
+ * libc.so.6 goes with the .so files.
+ */
+unsigned int
+extkey(name)
+char *name;
+{
+	char	*dot, *end, *s, ext[MAXEXT + 2];
+	int	digits;
+
+	end = name + strlen(name);
+	for (dot = end - 1; dot > name; dot--) {
+		if (*dot != '.')
+			continue;
+		if (end - dot - 1 < 1 || end - dot - 1 > MAXEXT)
+			return	KEY_NONE;
+		digits = 1;
+		for (s = dot + 1; s < end; s++) {
+			if (!isalnum((unsigned char)*s))
+				return	KEY_NONE;
+			if (!isdigit((unsigned char)*s))
+				digits = 0;
+		}
+		if (!digits) {
+			memcpy(ext, dot, end - dot);
+			ext[end - dot] = '\0';
+			return	intern(ext);
+		}
+		end = dot;	/* try the one before */
+	}
+	return	KEY_NONE;
+}
+
+/*
+ * Count a file of some kind in a directory, or take one out (with
+ * own and bytes negative)
+ */
+void
+addshare(dp, by, key, own, bytes)
+struct dir *dp;
+int by;
+unsigned int key;
+long own, bytes;
+{
+	struct	share	*sp;
+	int	i, n;
+
+	n = dp->nshares[by];
+	for (i = 0, sp = dp->shares[by]; i < n; i++, sp++) {
+		if (sp->key == key) {
+			sp->own += own;
+			sp->bytes += bytes;
+			return;
+		}
+	}
+	/* grown each time the count reaches a power of two */
+	if ((n & (n - 1)) == 0) {
+		dp->shares[by] = (struct share *)realloc((char *)dp->shares[by],
+			(n ? 2 * n : 1) * sizeof(struct share));
+		if (dp->shares[by] == NULL) {
+			fprintf(stderr, "xdu: out of memory\n");
+			exit(1);
+		}
+	}
+	sp = &dp->shares[by][n];
+	sp->key = key;
+	sp->own = own;
+	sp->bytes = bytes;
+	dp->nshares[by]++;
+}
+
+/*
+ * Forget what a directory's files were, to count them again
+ */
+void
+clearshares(dp)
+struct dir *dp;
+{
+	int	by;
+
+	for (by = 0; by < NBY; by++) {
+		if (dp->shares[by] != NULL)
+			free((char *)dp->shares[by]);
+		dp->shares[by] = NULL;
+		dp->nshares[by] = 0;
+	}
+}
+
+/*
+ * Add v bytes to key in a tally
+ */
+static void
+tally(tp, key, v)
+struct tally *tp;
+unsigned int key;
+long v;
+{
+	struct	share	*old, *sp;
+	long	i, n;
+
+	if (v == 0)
+		return;
+	if (2 * (tp->n + 1) > tp->max) {
+		old = tp->s;
+		n = tp->max;
+		tp->max = n ? 2 * n : 64;
+		tp->s = (struct share *)malloc(tp->max * sizeof(struct share));
+		if (tp->s == NULL) {
+			fprintf(stderr, "xdu: out of memory\n");
+			exit(1);
+		}
+		for (i = 0; i < tp->max; i++)
+			tp->s[i].key = KEY_EMPTY;
+		tp->n = 0;
+		for (i = 0; i < n; i++)
+			if (old[i].key != KEY_EMPTY)
+				tally(tp, old[i].key, old[i].own);
+		if (old != NULL)
+			free((char *)old);
+	}
+	i = (key * 2654435761U) & (tp->max - 1);
+	for (sp = &tp->s[i]; sp->key != KEY_EMPTY; sp = &tp->s[i]) {
+		if (sp->key == key) {
+			sp->own += v;
+			return;
+		}
+		i = (i + 1) & (tp->max - 1);
+	}
+	sp->key = key;
+	sp->own = v;
+	tp->n++;
+}
+
+/*
+ * Add what is in the one node np to the tallies, one for each
+ * thing it can be broken down by
+ */
+static void
+visit(t, np)
+struct tally *t;
+struct node *np;
+{
+	struct	share	*sp;
+	long	own, left, v;
+	int	by, i;
+
+	own = np->own * 1024;
+	if (np->dir != NULL) {
+		for (by = 0; by < NBY; by++) {
+			left = own;
+			sp = np->dir->shares[by];
+			for (i = 0; i < np->dir->nshares[by]; i++, sp++) {
+				v = (measure == MEASURE_APPARENT)
+					? sp->bytes : sp->own * 1024;
+				tally(&t[by], sp->key, v);
+				left -= v;
+			}
+			tally(&t[by], KEY_OTHER, left);
+		}
+	} else if (np->child == NODE_NULL) {
+		tally(&t[BY_EXT], EXTID(np->nameid), own);
+		tally(&t[BY_OWNER], KEY_OTHER, own);
+	} else {
+		tally(&t[BY_EXT], KEY_OTHER, own);
+		tally(&t[BY_OWNER], KEY_OTHER, own);
+	}
+}
+
+/*
+ * Add np and everything below it to the tallies, counting the nodes
+ * looked at in *visitsp
+ */
+static void
+walk(t, np, visitsp)
+struct tally *t;
+struct node *np;
+long *visitsp;
+{
+	struct	node *cp;
+
+	visit(t, np);
+	(*visitsp)++;
+	for (cp = np->child; cp != NODE_NULL; cp = cp->peer)
+		walk(t, cp, visitsp);
+}
+
+/*
+ * Thread State
+ * A breaking down thread's own tallies
+ */
+struct worker {
+	pthread_t tid;
+	struct	tally t[NBY];
+	long	visits;
+};
+
+/*
+ * breaking down thread: take subtrees off the list until there are
+ * none left
+ */
+static void *
+worker(arg)
+void *arg;
+{
+	struct	worker	*wp;
+	long	i, n;
+
+	wp = (struct worker *)arg;
+	for (;;) {
+		pthread_mutex_lock(&tasklock);
+		i = nexttask;
+		n = (ntasks - i < grab) ? ntasks - i : grab;
+		nexttask += n;
+		pthread_mutex_unlock(&tasklock);
+		if (n <= 0)
+			break;
+		for (; n > 0; n--, i++)
+			walk(wp->t, tasks[i], &wp->visits);
+	}
+	return	arg;
+}
+
+/*
+ * Find the extensions of the names new since the last time, so the
+ * threads can look them up
+ */
+static void
+extnames()
+{
+	unsigned int	c;
+
+	/* nnames grows as extensions are added */
+	for (; nextids < nnames; nextids++) {
+		c = nextids >> NAMESHIFT;
+		if ((nextids & NAMEMASK) == 0) {
+			extids[c] = (unsigned int *)malloc(NAMECHUNK
+				* sizeof(unsigned int));
+			if (extids[c] == NULL) {
+				fprintf(stderr, "xdu: out of memory\n");
+				exit(1);
+			}
+		}
+		EXTID(nextids) = extkey(namestr(nextids));
+	}
+}
+
+static int sortby;		/* what the shares being sorted are of */
+
+/*
+ * Biggest first, the same size by name, so that the order doesn't
+ * depend on which thread named an extension first
+ */
+static int
+sharecmp(p1, p2)
+struct share *p1, *p2;
+{
+	if (p1->own != p2->own)
+		return	(p1->own > p2->own) ? -1 : 1;
+	if (sortby == BY_EXT && p1->key < KEY_OTHER && p2->key < KEY_OTHER)
+		return	namecmp(p1->key, p2->key);
+	return	(p1->key < p2->key) ? -1 : (p1->key > p2->key);
+}
+
+/*
+ * Break down the space below np into cp
+ */
+static void
+compute(np, cp)
+struct node *np;
+struct cache *cp;
+{
+	struct	tally	t[NBY];
+	struct	worker	*workers;
+	struct	node	**upper;
+	struct	share	*sp;
+	double	start;
+	long	nupper, i, j;
+	int	n, by;
+
+	start = stattime();
+	extnames();
+	bzero((char *)t, sizeof(t));
+	n = nthreads;
+	if (n <= 0)
+		n = sysconf(_SC_NPROCESSORS_ONLN);
+	if (n <= 1 || np->files + np->dirs < MINSPLIT) {
+		walk(t, np, &stats.breakvisits);
+	} else {
+		nupper = cuttree(np, n, &upper, &tasks, &ntasks);
+		for (i = 0; i < nupper; i++)
+			visit(t, upper[i]);
+		stats.breakvisits += nupper;
+		free((char *)upper);
+
+		nexttask = 0;
+		grab = ntasks / (NTASKS * n);	/* a few at a time when there are lots */
+		if (grab < 1)
+			grab = 1;
+		if (n > ntasks)
+			n = ntasks;
+		workers = (struct worker *)calloc(n, sizeof(struct worker));
+		if (workers == NULL) {
+			fprintf(stderr, "xdu: out of memory\n");
+			exit(1);
+		}
+		for (i = 0; i < n; i++) {
+			if (pthread_create(&workers[i].tid, NULL, worker,
+			    (void *)&workers[i]) != 0) {
+				fprintf(stderr, "xdu: can't start thread\n");
+				exit(1);
+			}
+		}
+
+		/* merge each thread's tallies into ours as it finishes */
+		for (i = 0; i < n; i++) {
+			pthread_join(workers[i].tid, NULL);
+			stats.breakvisits += workers[i].visits;
+			for (by = 0; by < NBY; by++) {
+				sp = workers[i].t[by].s;
+				for (j = 0; j < workers[i].t[by].max; j++, sp++)
+					if (sp->key != KEY_EMPTY)
+						tally(&t[by], sp->key, sp->own);
+				if (workers[i].t[by].s != NULL)
+					free((char *)workers[i].t[by].s);
+			}
+		}
+		free((char *)workers);
+		free((char *)tasks);
+	}
+
+	/* in kilobytes, biggest first */
+	for (by = 0; by < NBY; by++) {
+		cp->shares[by] = (struct share *)malloc((t[by].n + 1)
+			* sizeof(struct share));
+		if (cp->shares[by] == NULL) {
+			fprintf(stderr, "xdu: out of memory\n");
+			exit(1);
+		}
+		cp->nshares[by] = 0;
+		for (j = 0, sp = t[by].s; j < t[by].max; j++, sp++) {
+			if (sp->key == KEY_EMPTY)
+				continue;
+			i = cp->nshares[by]++;
+			cp->shares[by][i].key = sp->key;
+			cp->shares[by][i].bytes = sp->own;
+			cp->shares[by][i].own = (sp->own > 0)
+				? (sp->own + 1023) / 1024 : sp->own / 1024;
+		}
+		sortby = by;
+		qsort((char *)cp->shares[by], cp->nshares[by],
+			sizeof(struct share), sharecmp);
+		if (t[by].s != NULL)
+			free((char *)t[by].s);
+	}
+	stats.breakdowns++;
+	stats.breaktime += stattime() - start;
+}
+
+/*
+ * The space below np broken down by by, biggest first, with own in
+ * kilobytes of the measure being shown.  The array is ours, and is
+ * good until the next call.  *nsharesp is set to the number in it.
+ */
+struct share *
+breakdown(np, by, nsharesp)
+struct node *np;
+int by;
+int *nsharesp;
+{
+	struct	cache	*cp;
+	int	i;
+
+	totals();		/* own sizes, and whether the tree changed */
+	for (cp = cache; cp < &cache[NCACHE]; cp++) {
+		if (cp->np == np && cp->gen == totalgen) {
+			stats.breakhits++;
+			*nsharesp = cp->nshares[by];
+			return	cp->shares[by];
+		}
+	}
+
+	cp = &cache[nextcache];
+	nextcache = (nextcache + 1) % NCACHE;
+	for (i = 0; i < NBY; i++)
+		if (cp->shares[i] != NULL)
+			free((char *)cp->shares[i]);
+	cp->np = np;
+	cp->gen = totalgen;
+	compute(np, cp);
+	*nsharesp = cp->nshares[by];
+	return	cp->shares[by];
+}
+
+/*
+ * The name of a key, in buf if it has to be made up
+ */
+char *
+keyname(by, key, buf)
+int by;
+unsigned int key;
+char *buf;
+{
+	struct	passwd	*pw;
+
+	if (key == KEY_OTHER)
+		return	"(other)";
+	if (by == BY_EXT)
+		return	(key == KEY_NONE) ? "(none)" : namestr(key);
+	if ((pw = getpwuid((uid_t)key)) != NULL)
+		return	pw->pw_name;
+	sprintf(buf, "%u", key);
+	return	buf;
+}
+
+/*
+ * The breakdown of np as text: a heading, then a line for each of
+ * the biggest topk, with its size and its share of the whole.  The
+ * text is malloc'd.
+ */
+char *
+breaktext(np, by)
+struct node *np;
+int by;
+{
+	struct	share	*sp;
+	char	*buf, name[32];
+	long	len;
+	int	n, all, i;
+
+	sp = breakdown(np, by, &all);
+	n = (all > topk) ? topk : all;
+	buf = malloc((n + 3) * 80);
+	if (buf == NULL) {
+		fprintf(stderr, "xdu: out of memory\n");
+		exit(1);
+	}
+	sprintf(buf, "Space by %s:\n", by == BY_EXT ? "extension" : "owner");
+	len = strlen(buf);
+	for (i = 0; i < n; i++, sp++) {
+		sprintf(&buf[len], "%-12ld %5.1f%%  %.40s\n", sp->own,
+			np->size > 0 ? 100.0 * sp->own / np->size : 0.0,
+			keyname(by, sp->key, name));
+		len += strlen(&buf[len]);
+	}
+	if (all > n)
+		sprintf(&buf[len], "and %d more\n", all - n);
+	return	buf;
+}
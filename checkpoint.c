@@ -0,0 +1,683 @@
+/*
+ * XDU - Checkpointing a scan, so that it can be picked up again.
+ *
+ * A scan of a very large tree can take hours, and if it is stopped
+ * part way, everything read so far is lost.  With -checkpoint, what
+ * has been read is kept in a log file as the scan goes, and the next
+ * scan of the same directories with the same log starts from where it
+ * leaves off: the directories already read are taken from the log,
+ * and only the rest are read.
+ *
+ * The log is only ever appended to.  After the header it has a line
+ * for each directory named to -scan, and a record for each directory
+ * read, with what is in it and a line for each of its subdirectories,
+ * giving each a number.  A directory with a number but no record of
+ * its own was found but not yet read, so the log says both what has
+ * been done and what is left to do.
+ *
+ * Each scanning thread keeps its records to itself until it has
+ * CHECKBUF bytes of them, or hasn't written any for CHECKINTERVAL
+ * seconds, then writes them all at once, so the log costs one write
+ * for many directories and the threads seldom wait on each other.
+ * Only whole records are written, so the only one a crash can cut off
+ * is the last, which is dropped (and the directory read again) when
+ * the scan is resumed.  Records from different threads can be in any
+ * order, and one whose directory's parent has no record is not used.
+ * A directory is numbered by the thread that finds it, in strides of
+ * the number of threads, so no two get the same number without the
+ * threads having to agree on it.
+ *
+ * Changes made since a directory was read don't show until it is
+ * read again.  The log is removed once the scan is done; to keep
+ * the scan, use -snapshot.
+ *
+ * Copyright (c)	Phillip C. Dykstra	1991, 1993, 1994
+ * The X Consortium, and any party obtaining a copy of these files from
+ * the X Consortium, directly or indirectly, is granted, free of charge, a
+ * full and unrestricted irrevocable, world-wide, paid up, royalty-free,
+ * nonexclusive right and license to deal in this software and
+ * documentation files (the "Software"), including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons who receive
+ * copies from any such party to do so.  This license includes without
+ * limitation a license to do the foregoing actions under any patents of
+ * the party supplying this software to the X Consortium.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include "xdu.h"
+#include "stats.h"
+
+#define	CHECKMAGIC	"xdu-checkpoint"
+#define	CHECKVERSION	1
+#define	CHECKBUF	65536	/* bytes a thread keeps before writing */
+#define	CHECKINTERVAL	5	/* most seconds it keeps them */
+
+/* EXPORTS: routines that this module exports outside */
+extern long checkopen();
+extern struct node *checkresume();
+extern void checktop();
+extern struct checkbuf *checkbuf();
+extern long checkid();
+extern void checkdir();
+extern void checkfree();
+extern void checkdone();
+char *checkname = NULL;		/* the log, if checkpointing */
+
+/* IMPORTS: routines that this module uses from xdu.c and scan.c */
+extern void freetree();
+extern void addlink();
+
+/* internal routines */
+static char *room();
+static void putname();
+static void unescape();
+static void flush();
+static long find();
+static struct node *lookup();
+static struct node *place();
+static void apply();
+static long readcheck();
+static void keep();
+
+/*
+ * Checkpoint Buffer
+ * The records one scanning thread has made since it last wrote
+ */
+struct checkbuf {
+	char	*buf;
+	int	len;
+	int	max;
+	double	written;	/* when it last wrote them */
+	long	nextid;		/* number for the next directory it finds */
+	int	stride;
+};
+
+static int checkfd = -1;		/* the log, open to append */
+static long nextid = 1;		/* past any number in the log */
+static double synced;		/* when it was last forced to disk */
+static struct node resumed;	/* the trees read back from the log */
+static pthread_mutex_t checklock = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * Slot Structure
+ * A directory read back from the log, by its number
+ */
+struct slot {
+	long	id;
+	struct	node *np;
+};
+static struct slot *slots = NULL;
+static long nslots = 0;
+static long nused = 0;
+
+/*
+ * Make sure there are n more bytes free at the end of a
+ * buffer, and return where they start
+ */
+static char *
+room(cp, n)
+struct checkbuf *cp;
+int n;
+{
+	if (cp->len + n > cp->max) {
+		while (cp->len + n > cp->max)
+			cp->max = cp->max ? 2 * cp->max : CHECKBUF + 2 * MAXPATH;
+		cp->buf = realloc(cp->buf, cp->max);
+		if (cp->buf == NULL) {
+			fprintf(stderr, "xdu: out of memory\n");
+			exit(1);
+		}
+	}
+	return	&cp->buf[cp->len];
+}
+
+/*
+ * Add a name and a newline to a buffer, with backslashes and
+ * newlines written as \\ and \n, as in a snapshot
+ */
+static void
+putname(cp, s)
+struct checkbuf *cp;
+char *s;
+{
+	char	*d;
+
+	d = room(cp, 2 * strlen(s) + 2);
+	for (; *s != '\0'; s++) {
+		if (*s == '\\' || *s == '\n') {
+			*d++ = '\\';
+			*d++ = *s == '\n' ? 'n' : '\\';
+		} else {
+			*d++ = *s;
+		}
+	}
+	*d++ = '\n';
+	cp->len = d - cp->buf;
+}
+
+/*
+ * Undo putname() on a line read back, in place
+ */
+static void
+unescape(s)
+char *s;
+{
+	char	*d;
+
+	for (d = s; *s != '\0' && *s != '\n'; s++) {
+		if (*s == '\\' && s[1] == 'n') {
+			*d++ = '\n';
+			s++;
+		} else if (*s == '\\' && s[1] == '\\') {
+			*d++ = '\\';
+			s++;
+		} else {
+			*d++ = *s;
+		}
+	}
+	*d = '\0';
+}
+
+/*
+ * Write out the records in a buffer, and every CHECKINTERVAL
+ * seconds make sure that the log is on the disk
+ */
+static void
+flush(cp)
+struct checkbuf *cp;
+{
+	double	t;
+	char	*s;
+	int	n;
+
+	t = stattime();
+	pthread_mutex_lock(&checklock);
+	for (s = cp->buf; checkfd >= 0 && s < &cp->buf[cp->len]; s += n) {
+		if ((n = write(checkfd, s, &cp->buf[cp->len] - s)) < 0) {
+			if (errno == EINTR) {
+				n = 0;
+				continue;
+			}
+			fprintf(stderr, "xdu: can't write \"%s\", not checkpointing\n",
+				checkname);
+			close(checkfd);
+			checkfd = -1;
+		}
+	}
+	if (checkfd >= 0 && t - synced >= CHECKINTERVAL) {
+		fsync(checkfd);
+		synced = t;
+	}
+	stats.checkwrites++;
+	stats.checkbytes += cp->len;
+	cp->len = 0;
+	cp->written = stattime();
+	stats.checktime += cp->written - t;
+	pthread_mutex_unlock(&checklock);
+}
+
+/*
+ * A new buffer for scanning thread i of n, or NULL
+ * if not checkpointing
+ */
+struct checkbuf *
+checkbuf(i, n)
+int i, n;
+{
+	struct	checkbuf *cp;
+
+	if (checkfd < 0)
+		return	(struct checkbuf *)NULL;
+	cp = (struct checkbuf *)calloc(1, sizeof(struct checkbuf));
+	cp->written = stattime();
+	cp->nextid = nextid + i;
+	cp->stride = n;
+	return	cp;
+}
+
+/*
+ * A number for a directory just found, by the thread with the buffer
+ * cp, or by the only thread running if it is NULL.  0 if not
+ * checkpointing.
+ */
+long
+checkid(cp)
+struct checkbuf *cp;
+{
+	long	id;
+
+	if (cp != NULL) {
+		id = cp->nextid;
+		cp->nextid += cp->stride;
+	} else if (checkfd >= 0) {
+		id = nextid++;
+	} else {
+		id = 0;
+	}
+	return	id;
+}
+
+/*
+ * Add the record for the directory np, just read, to a thread's
+ * buffer, and write the buffer out if it is time to:
+ *	d id own bytes files
+ * followed by its extensions, owners and hard links as in a snapshot,
+ * a line for each subdirectory:
+ *	s id own bytes inode mtime ctime name
+ * with the size of the subdirectory itself, and then a line with
+ * just a '.'.  All are tab separated.
+ */
+void
+checkdir(cp, np)
+struct checkbuf *cp;
+struct node *np;
+{
+	struct	node	*sp;
+	struct	dirlink	*lp;
+	struct	share	*hp;
+	struct	dir	*dp;
+	int	i;
+
+	dp = np->dir;
+	cp->len += sprintf(room(cp, 128), "d\t%ld\t%ld\t%ld\t%ld\n",
+		dp->checkid, dp->own, dp->bytes, dp->files);
+	hp = dp->shares[BY_EXT];
+	for (i = 0; i < dp->nshares[BY_EXT]; i++, hp++)
+		cp->len += sprintf(room(cp, 128), "e\t%ld\t%ld\t%s\n",
+			hp->own, hp->bytes,
+			hp->key == KEY_NONE ? "-" : namestr(hp->key));
+	hp = dp->shares[BY_OWNER];
+	for (i = 0; i < dp->nshares[BY_OWNER]; i++, hp++)
+		cp->len += sprintf(room(cp, 128), "u\t%ld\t%ld\t%u\n",
+			hp->own, hp->bytes, hp->key);
+	for (i = 0; i < dp->nlinks; i++) {
+		lp = &dp->links[i];
+		cp->len += sprintf(room(cp, 160), "=\t%lu\t%lu\t%ld\t%ld\t%u\t%s\n",
+			lp->dev, lp->ino, lp->own, lp->bytes, lp->uid,
+			lp->ext == KEY_NONE ? "-" : namestr(lp->ext));
+	}
+	for (sp = np->child; sp != NODE_NULL; sp = sp->peer) {
+		dp = sp->dir;
+		cp->len += sprintf(room(cp, 160), "s\t%ld\t%ld\t%ld\t%lu\t%ld\t%ld\t",
+			dp->checkid, dp->own, dp->bytes, dp->ino, dp->mtime,
+			dp->ctime);
+		putname(cp, NAME(sp));
+	}
+	cp->len += sprintf(room(cp, 2), ".\n");
+
+	if (cp->len >= CHECKBUF || stattime() - cp->written >= CHECKINTERVAL)
+		flush(cp);
+}
+
+/*
+ * A thread has finished scanning: write out what it has left
+ * and let go of its buffer
+ */
+void
+checkfree(cp)
+struct checkbuf *cp;
+{
+	if (cp == NULL)
+		return;
+	if (cp->len > 0)
+		flush(cp);
+	if (cp->nextid > nextid)
+		nextid = cp->nextid;	/* none of the threads is running */
+	if (cp->buf != NULL)
+		free(cp->buf);
+	free((char *)cp);
+}
+
+/*
+ * Note a directory named to -scan, before anything below it is read:
+ *	t id own bytes inode mtime ctime path
+ */
+void
+checktop(np)
+struct node *np;
+{
+	struct	checkbuf c;
+	struct	dir	*dp;
+
+	if (checkfd < 0)
+		return;
+	bzero((char *)&c, sizeof(c));
+	dp = np->dir;
+	c.len = sprintf(room(&c, 160), "t\t%ld\t%ld\t%ld\t%lu\t%ld\t%ld\t",
+		dp->checkid, dp->own, dp->bytes, dp->ino, dp->mtime, dp->ctime);
+	putname(&c, NAME(np));
+	flush(&c);
+	free(c.buf);
+}
+
+/*
+ * The slot the directory numbered id is in, or would go in
+ */
+static long
+find(id)
+long id;
+{
+	long	i;
+
+	for (i = (unsigned long)id * 2654435761UL % nslots;
+	    slots[i].np != NODE_NULL && slots[i].id != id; i = (i + 1) % nslots)
+		;
+	return	i;
+}
+
+/*
+ * The directory numbered id, read back from the log, made if it
+ * hasn't been seen yet.  A directory is unread until its record is.
+ */
+static struct node *
+lookup(id)
+long id;
+{
+	struct	slot	*old;
+	struct	node	*np;
+	long	i, n;
+
+	if (2 * (nused + 1) > nslots) {
+		/* half full: twice the slots */
+		old = slots;
+		n = nslots;
+		nslots = nslots ? 2 * nslots : 4096;
+		slots = (struct slot *)calloc(nslots, sizeof(struct slot));
+		for (i = 0; i < n; i++) {
+			if (old[i].np != NODE_NULL)
+				slots[find(old[i].id)] = old[i];
+		}
+		if (old != NULL)
+			free((char *)old);
+	}
+	i = find(id);
+	if (slots[i].np != NODE_NULL)
+		return	slots[i].np;
+
+	np = (struct node *)calloc(1, sizeof(struct node));
+	np->dir = (struct dir *)calloc(1, sizeof(struct dir));
+	np->dir->checkid = id;
+	np->dir->unread = 1;
+	np->dir->wd = -1;
+	slots[i].id = id;
+	slots[i].np = np;
+	nused++;
+	if (id >= nextid)
+		nextid = id + 1;
+	return	np;
+}
+
+/*
+ * Put the directory on a 't' or 's' line under pp.  Returns
+ * NODE_NULL if the line is bad, or the directory already has a place.
+ */
+static struct node *
+place(buf, pp)
+char *buf;
+struct node *pp;
+{
+	struct	node	*np;
+	long	id, own, bytes, mtime, ctime;
+	unsigned long ino;
+	int	off;
+
+	if (sscanf(&buf[1], "%ld %ld %ld %lu %ld %ld%n", &id, &own, &bytes,
+	    &ino, &mtime, &ctime, &off) != 6 || buf[1+off] != '\t')
+		return	NODE_NULL;
+	np = lookup(id);
+	if (np->parent != NODE_NULL)
+		return	NODE_NULL;
+	if (np->dir->unread) {
+		/* only the directory itself, until it is read */
+		np->dir->own = own;
+		np->dir->bytes = bytes;
+	}
+	np->dir->ino = ino;
+	np->dir->mtime = mtime;
+	np->dir->ctime = ctime;
+	unescape(&buf[1+off+1]);
+	np->nameid = intern(&buf[1+off+1]);
+	np->parent = pp;
+	return	np;
+}
+
+/*
+ * Use a whole record read back from the log
+ */
+static void
+apply(rp)
+struct checkbuf *rp;
+{
+	struct	node	*np, *cp, **tail;
+	char	*s, *e;
+	char	ext[32];
+	long	id, own, bytes, files;
+	unsigned long dev, ino;
+	unsigned int uid;
+
+	*room(rp, 1) = '\0';
+	if (sscanf(rp->buf, "d %ld %ld %ld %ld", &id, &own, &bytes, &files) != 4)
+		return;
+	np = lookup(id);
+	if (!np->dir->unread)
+		return;		/* read twice: keep the first */
+	np->dir->own = own;
+	np->dir->bytes = bytes;
+	np->dir->files = files;
+	np->dir->unread = 0;
+
+	tail = &np->child;
+	for (s = strchr(rp->buf, '\n') + 1; *s != '\0'; s = e) {
+		if ((e = strchr(s, '\n')) == NULL)
+			break;
+		e++;
+		if (s[0] == 'e' || s[0] == 'u') {
+			if (sscanf(&s[1], "%ld %ld %31s", &own, &bytes, ext) != 3)
+				break;
+			if (s[0] == 'u')
+				addshare(np->dir, BY_OWNER,
+					(unsigned int)strtoul(ext, (char **)NULL, 10),
+					own, bytes);
+			else
+				addshare(np->dir, BY_EXT, strcmp(ext, "-") == 0
+					? KEY_NONE : intern(ext), own, bytes);
+		} else if (s[0] == '=') {
+			if (sscanf(&s[1], "%lu %lu %ld %ld %u %31s",
+			    &dev, &ino, &own, &bytes, &uid, ext) != 6)
+				break;
+			addlink(np->dir, dev, ino, own, bytes, strcmp(ext, "-") == 0
+				? KEY_NONE : intern(ext), uid);
+		} else if (s[0] == 's') {
+			if ((cp = place(s, np)) == NODE_NULL)
+				break;
+			*tail = cp;
+			tail = &cp->peer;
+		} else {
+			break;
+		}
+	}
+}
+
+/*
+ * Read the log back into trees under resumed, as far as it goes
+ * whole.  Returns where the last whole record in it ends.
+ */
+static long
+readcheck(fp)
+FILE *fp;
+{
+	char	buf[2 * MAXPATH + 128];
+	struct	checkbuf rec;
+	struct	node	*np, **tail;
+	long	good;
+	int	n;
+
+	bzero((char *)&rec, sizeof(rec));
+	tail = &resumed.child;
+	good = ftell(fp);
+	while (fgets(buf, sizeof(buf), fp) != NULL) {
+		if (strchr(buf, '\n') == NULL)
+			break;		/* cut off */
+		if (buf[0] == '.' && rec.len > 0) {
+			apply(&rec);
+			rec.len = 0;
+		} else if (buf[0] == 't' && rec.len == 0) {
+			if ((np = place(buf, &resumed)) == NODE_NULL)
+				break;
+			*tail = np;
+			tail = &np->peer;
+		} else if ((buf[0] == 'd') == (rec.len == 0)) {
+			n = strlen(buf);
+			strcpy(room(&rec, n + 1), buf);
+			rec.len += n;
+			continue;
+		} else {
+			break;
+		}
+		good = ftell(fp);
+	}
+	if (rec.buf != NULL)
+		free(rec.buf);
+	return	good;
+}
+
+/*
+ * Mark np and everything below it to be kept, numbering them as
+ * makenode() would have.  They stay in the slots, as taking them
+ * out would break the chains that find() follows to the others.
+ */
+static void
+keep(np)
+struct node *np;
+{
+	struct	node	*cp;
+
+	np->dir->kept = 1;
+	np->num = stats.nodes++;
+	if (!np->dir->unread)
+		stats.checkresumed++;
+	for (cp = np->child; cp != NODE_NULL; cp = cp->peer)
+		keep(cp);
+}
+
+/*
+ * Open the log for the directories about to be scanned, reading
+ * back what it has from a scan that was stopped.  Returns when that
+ * scan started, or now if there wasn't one.
+ */
+long
+checkopen()
+{
+	char	buf[128], magic[32];
+	struct	node	*np;
+	FILE	*fp;
+	long	start, good, i;
+	int	version;
+
+	start = time((time_t *)0);
+	good = 0;
+	if ((fp = fopen(checkname, "r")) != NULL) {
+		if (fgets(buf, sizeof(buf), fp) == NULL) {
+			;	/* empty, as good as missing */
+		} else if (sscanf(buf, "%31s", magic) != 1
+		 || strcmp(magic, CHECKMAGIC) != 0) {
+			/* someone else's file, which is theirs to keep */
+			fprintf(stderr, "xdu: \"%s\" isn't a checkpoint\n",
+				checkname);
+			exit(1);
+		} else if (sscanf(buf, "%31s %d %ld", magic, &version,
+		    &start) == 3 && version == CHECKVERSION) {
+			good = readcheck(fp);
+		} else {
+			fprintf(stderr,
+			    "xdu: checkpoint \"%s\" can't be read, starting afresh\n",
+				checkname);
+			start = time((time_t *)0);
+		}
+		fclose(fp);
+	}
+
+	/* what is below the scanned trees is kept, anything else goes */
+	for (np = resumed.child; np != NODE_NULL; np = np->peer)
+		keep(np);
+	for (i = 0; i < nslots; i++) {
+		if ((np = slots[i].np) == NODE_NULL)
+			continue;
+		if (np->dir->kept) {
+			np->dir->kept = 0;
+		} else {
+			np->child = NODE_NULL;	/* they are in the slots too */
+			freetree(np);
+		}
+	}
+	if (slots != NULL)
+		free((char *)slots);
+	slots = NULL;
+	nslots = nused = 0;
+
+	/* carry on from the last whole record */
+	if ((checkfd = open(checkname, O_WRONLY|O_CREAT|O_APPEND, 0666)) < 0
+	 || ftruncate(checkfd, (off_t)good) < 0) {
+		fprintf(stderr, "xdu: can't write \"%s\"\n", checkname);
+		exit(1);
+	}
+	if (good == 0) {
+		sprintf(buf, "%s %d %ld\n", CHECKMAGIC, CHECKVERSION, start);
+		if (write(checkfd, buf, strlen(buf)) < 0) {
+			fprintf(stderr, "xdu: can't write \"%s\"\n", checkname);
+			exit(1);
+		}
+	}
+	synced = stattime();
+	return	start;
+}
+
+/*
+ * The tree read back from the log for the directory path, to carry
+ * on scanning, or NODE_NULL if there isn't one.  The directories in
+ * it that haven't been read are marked unread.
+ */
+struct node *
+checkresume(path)
+char *path;
+{
+	struct	node	*np, **npp;
+
+	for (npp = &resumed.child; (np = *npp) != NODE_NULL; npp = &np->peer) {
+		if (strcmp(NAME(np), path) == 0) {
+			*npp = np->peer;
+			np->peer = NODE_NULL;
+			np->parent = NODE_NULL;
+			return	np;
+		}
+	}
+	return	NODE_NULL;
+}
+
+/*
+ * The scan is done, so the log isn't needed any more
+ */
+void
+checkdone()
+{
+	struct	node	*np, *next;
+
+	if (checkfd >= 0) {
+		close(checkfd);
+		unlink(checkname);
+		checkfd = -1;
+	}
+	for (np = resumed.child; np != NODE_NULL; np = next) {
+		next = np->peer;
+		freetree(np);	/* directories no longer scanned */
+	}
+	resumed.child = NODE_NULL;
+}
@@ -0,0 +1,217 @@
+/*
+ * XDU - Keeping a tree to a number of nodes while it is read.
+ *
+ * du lists a directory after everything in it, so once its own line
+ * has been read, the directory is finished: nothing more will be
+ * added below it, and its size is the total for all of it.  Each
+ * input keeps the directories it has finished in a heap, smallest
+ * first.  When the input has more nodes than its share of the
+ * budget, the smallest of them are collapsed, one at a time, until it
+ * is back within it: everything below is added up (totals.c) and let
+ * go, and the directory is kept as a single node with those totals,
+ * marked with how many nodes went.  Sizes stay exact, only the
+ * detail is lost.
+ *
+ * A directory has to come off the heap after everything below it that
+ * is in the heap, which is let go when it is collapsed.  du doesn't
+ * promise that nothing below a directory is bigger (a sorted listing
+ * doesn't even finish it last), so it goes in by the biggest of its
+ * size and what below it went in by, and the deeper ones are taken
+ * first amongst those of the same.  Until a directory is collapsed,
+ * its own size isn't known (totals.c works it out after), so "own"
+ * keeps the biggest that anything from it down went in by.  One that
+ * comes off the heap with something bigger put in below it since goes
+ * back in, by that.
+ *
+ * Copyright (c)	Phillip C. Dykstra	1991, 1993, 1994
+ * The X Consortium, and any party obtaining a copy of these files from
+ * the X Consortium, directly or indirectly, is granted, free of charge, a
+ * full and unrestricted irrevocable, world-wide, paid up, royalty-free,
+ * nonexclusive right and license to deal in this software and
+ * documentation files (the "Software"), including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons who receive
+ * copies from any such party to do so.  This license includes without
+ * limitation a license to do the foregoing actions under any patents of
+ * the party supplying this software to the X Consortium.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "xdu.h"
+#include "stats.h"
+
+/* EXPORTS: routines that this module exports outside */
+extern void finished();
+extern void trim();
+extern void endtrim();
+long nodebudget = 0;		/* nodes to keep, 0 for all of them */
+
+/* internal routines */
+static int before();
+static void push();
+static void collapse();
+static long prune();
+
+/*
+ * Done Structure
+ * A finished directory waiting in the heap, with the size and the
+ * level below the input's top it was finished at.
+ */
+struct done {
+	struct	node *np;
+	long	size;
+	int	level;
+};
+
+/*
+ * Should d1 come off the heap before d2?  Smallest first, and of the
+ * same size, the deepest.
+ */
+static int
+before(d1, d2)
+struct done *d1, *d2;
+{
+	if (d1->size != d2->size)
+		return	d1->size < d2->size;
+	return	d1->level > d2->level;
+}
+
+/*
+ * The line for np was just read, and there are nodes below it, so it
+ * is finished: put it in the heap.  The tops of the input are kept.
+ */
+void
+finished(np, ip)
+struct node *np;
+struct input *ip;
+{
+	struct	node	*pp;
+	struct	done	d;
+
+	if (np->parent == ip->rootp)
+		return;
+	d.np = np;
+	d.size = (np->own > np->size) ? np->own : np->size;
+	np->own = d.size;
+	d.level = 1;
+	for (pp = np->parent; pp != ip->rootp && pp != NODE_NULL;
+	    pp = pp->parent) {
+		if (pp->own < d.size)
+			pp->own = d.size;	/* so it comes off after */
+		d.level++;
+	}
+	push(&d, ip);
+}
+
+/*
+ * Put d in the heap
+ */
+static void
+push(dp, ip)
+struct done *dp;
+struct input *ip;
+{
+	long	i, j;
+
+	if (ip->ndone >= ip->maxdone) {
+		ip->maxdone = ip->maxdone ? 2 * ip->maxdone : 1024;
+		ip->done = (struct done *)realloc((char *)ip->done,
+			ip->maxdone * sizeof(struct done));
+		if (ip->done == NULL) {
+			fprintf(stderr, "xdu: out of memory\n");
+			exit(1);
+		}
+	}
+	/* sift it up from the end */
+	for (i = ip->ndone++; i > 0; i = j) {
+		j = (i - 1) / 2;
+		if (!before(dp, &ip->done[j]))
+			break;
+		ip->done[i] = ip->done[j];
+	}
+	ip->done[i] = *dp;
+}
+
+/*
+ * Collapse the smallest finished directories until the input is
+ * within its share of the budget, or there are none left to collapse
+ */
+void
+trim(ip)
+struct input *ip;
+{
+	struct	done	d, last;
+	long	i, j;
+
+	while (ip->nodes - ip->freed > ip->budget && ip->ndone > 0) {
+		d = ip->done[0];
+
+		/* sift the last one down from the top */
+		last = ip->done[--ip->ndone];
+		for (i = 0; (j = 2 * i + 1) < ip->ndone; i = j) {
+			if (j + 1 < ip->ndone
+			 && before(&ip->done[j+1], &ip->done[j]))
+				j++;
+			if (!before(&ip->done[j], &last))
+				break;
+			ip->done[i] = ip->done[j];
+		}
+		ip->done[i] = last;
+
+		if (d.np->own > d.size) {
+			/* something bigger below went in since */
+			d.size = d.np->own;
+			push(&d, ip);
+		} else if (d.np->child != NODE_NULL)
+			collapse(d.np, ip);
+	}
+}
+
+/*
+ * Add up np and let go of everything below it
+ */
+static void
+collapse(np, ip)
+struct node *np;
+struct input *ip;
+{
+	subtotal(np);		/* while there's something to add up */
+	np->hidden = prune(np, ip);
+	ip->collapsed++;
+}
+
+/*
+ * Free everything below np, returning how many nodes have gone from
+ * below it, counting those already gone from below them
+ */
+static long
+prune(np, ip)
+struct node *np;
+struct input *ip;
+{
+	struct	node	*cp, *next;
+	long	n;
+
+	n = np->hidden;
+	for (cp = np->child; cp != NODE_NULL; cp = next) {
+		next = cp->peer;
+		n += 1 + prune(cp, ip);
+		free((char *)cp);	/* the name stays in the dictionary */
+		ip->freed++;
+	}
+	np->child = NODE_NULL;
+	return	n;
+}
+
+/*
+ * The input has been read, nothing more will be collapsed
+ */
+void
+endtrim(ip)
+struct input *ip;
+{
+	if (ip->done != NULL)
+		free((char *)ip->done);
+	ip->done = NULL;
+	ip->ndone = ip->maxdone = 0;
+}
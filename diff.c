@@ -0,0 +1,160 @@
+/*
+ * XDU - Snapshot Differences.
+ *
+ * Turns two trees loaded from du outputs of the same place, taken at
+ * different times, into one tree of the changes between them.  Every
+ * node's delta is its new size less its old size (so things that went
+ * away have negative deltas).  Its size, which is what the display is
+ * laid out by, becomes the total amount of change from there down:
+ * the absolute change in its own files plus the sizes of its children.
+ *
+ * Copyright (c)	Phillip C. Dykstra	1991, 1993, 1994
+ * The X Consortium, and any party obtaining a copy of these files from
+ * the X Consortium, directly or indirectly, is granted, free of charge, a
+ * full and unrestricted irrevocable, world-wide, paid up, royalty-free,
+ * nonexclusive right and license to deal in this software and
+ * documentation files (the "Software"), including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons who receive
+ * copies from any such party to do so.  This license includes without
+ * limitation a license to do the foregoing actions under any patents of
+ * the party supplying this software to the X Consortium.
+ */
+#include <stdio.h>
+#include <string.h>
+#include "xdu.h"
+#include "stats.h"
+
+/* EXPORTS: routines that this module exports outside */
+extern void difftree();
+
+/* internal routines */
+static struct node *namesort();
+static void marktree();
+
+/*
+ * Sort a list of peers into name order.  A merge sort, since there
+ * can be a great many of them and we only have the forward links.
+ */
+static struct node *
+namesort(list)
+struct node *list;
+{
+	struct	node	*a, *b, *np, **npp;
+
+	if (list == NODE_NULL || list->peer == NODE_NULL)
+		return	list;
+
+	/* split in two, a slow and a fast walker finding the middle */
+	a = list;
+	for (b = list->peer; b != NODE_NULL && b->peer != NODE_NULL;
+	    b = b->peer->peer)
+		a = a->peer;
+	b = a->peer;
+	a->peer = NODE_NULL;
+	a = namesort(list);
+	b = namesort(b);
+
+	/* and merge the halves back together */
+	npp = &list;
+	while (a != NODE_NULL && b != NODE_NULL) {
+		stats.strcmps++;
+		if (namecmp(a->nameid, b->nameid) <= 0) {
+			np = a;
+			a = a->peer;
+		} else {
+			np = b;
+			b = b->peer;
+		}
+		*npp = np;
+		npp = &np->peer;
+	}
+	*npp = (a != NODE_NULL) ? a : b;
+
+	return	list;
+}
+
+/*
+ * Mark a whole tree as added (sign 1) or removed (sign -1).
+ * Its size is then the total change already.
+ */
+static void
+marktree(np, sign)
+struct node *np;
+int sign;
+{
+	struct	node	*subnp;
+
+	np->delta = sign * np->size;
+	for (subnp = np->child; subnp != NODE_NULL; subnp = subnp->peer)
+		marktree(subnp, sign);
+}
+
+/*
+ * Make the new tree at np into the difference from the old tree at op,
+ * which is taken apart in the process.  The children of both are put in
+ * name order so that they can be matched up in one pass.  Children only
+ * in the old tree are moved over into the new one, marked as removed.
+ */
+void
+difftree(np, op)
+struct node *np;	/* new tree */
+struct node *op;	/* old tree */
+{
+	struct	node	*nc, *oc, *next, **npp;
+	long	childdelta;
+
+	np->delta = np->size - op->size;
+
+	nc = namesort(np->child);
+	oc = namesort(op->child);
+	op->child = NODE_NULL;
+
+	npp = &np->child;
+	while (nc != NODE_NULL || oc != NODE_NULL) {
+		int	cmp;
+
+		if (nc == NODE_NULL)
+			cmp = 1;
+		else if (oc == NODE_NULL)
+			cmp = -1;
+		else {
+			stats.strcmps++;
+			cmp = namecmp(nc->nameid, oc->nameid);
+		}
+
+		if (cmp < 0) {
+			/* only in the new tree: added */
+			marktree(nc, 1);
+			*npp = nc;
+			nc = nc->peer;
+		} else if (cmp > 0) {
+			/* only in the old tree: removed */
+			marktree(oc, -1);
+			oc->parent = np;
+			*npp = oc;
+			oc = oc->peer;
+		} else {
+			/* in both */
+			next = oc->peer;
+			difftree(nc, oc);
+			*npp = nc;
+			nc = nc->peer;
+			oc = next;
+		}
+		npp = &(*npp)->peer;
+	}
+	*npp = NODE_NULL;
+
+	/* our size is the change here plus all of the change below */
+	childdelta = 0;
+	np->size = 0;
+	for (nc = np->child; nc != NODE_NULL; nc = nc->peer) {
+		childdelta += nc->delta;
+		np->size += nc->size;
+	}
+	if (np->delta - childdelta < 0)
+		np->size -= np->delta - childdelta;
+	else
+		np->size += np->delta - childdelta;
+}
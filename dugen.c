@@ -0,0 +1,220 @@
+/*
+ *			D U G E N . C
+ *
+ * Generate synthetic "du" output for benchmarking xdu.
+ *
+ * The output is a function of the options only: the same options
+ * always give the same tree, on any machine.  Lines come out in the
+ * order du prints them, every directory after its subdirectories,
+ * and each size is the directory's own size plus that of everything
+ * below it.
+ *
+ * Copyright (c)	Phillip C. Dykstra	1991, 1993, 1994
+ * The X Consortium, and any party obtaining a copy of these files from
+ * the X Consortium, directly or indirectly, is granted, free of charge, a
+ * full and unrestricted irrevocable, world-wide, paid up, royalty-free,
+ * nonexclusive right and license to deal in this software and
+ * documentation files (the "Software"), including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons who receive
+ * copies from any such party to do so.  This license includes without
+ * limitation a license to do the foregoing actions under any patents of
+ * the party supplying this software to the X Consortium.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define	MAXDEPTH	64	/* deepest tree we will make */
+#define	MAXPATH		4096	/* max total pathname length */
+
+/* fan-out distributions */
+#define	DIST_FIXED	1	/* always fanout children */
+#define	DIST_UNIFORM	2	/* 0 to 2*fanout children */
+#define	DIST_GEOMETRIC	3	/* geometric, mean fanout */
+
+int	depth = 6;		/* levels below the root */
+int	fanout = 8;		/* mean subdirectories per directory */
+int	dist = DIST_UNIFORM;
+int	namelen = 8;		/* mean name length */
+long	maxlines = 1000000;	/* lines to write at most */
+unsigned long seed = 1;
+char	*rootname = ".";
+
+long	lines = 0;		/* lines written */
+long	pending = 0;		/* directories made but not yet written */
+char	path[MAXPATH];
+
+static char usage[] = "\
+Usage: dugen [-options ...] > du.out\n\
+\n\
+Writes synthetic du output to standard out\n\
+  options include:\n\
+  -seed num     Random number seed (1)\n\
+  -depth num    Levels of directories below the root (6)\n\
+  -fanout num   Mean subdirectories per directory (8)\n\
+  -dist name    Fan-out distribution: fixed, uniform, geometric (uniform)\n\
+  -namelen num  Mean name length (8)\n\
+  -lines num    Most lines to write (1000000)\n\
+  -root name    Name of the top directory (.)\n\
+";
+
+/*
+ * 32 bit xorshift - we want the same numbers everywhere,
+ * so we don't use the C library's generator.
+ */
+unsigned long
+rnd()
+{
+	seed ^= (seed << 13) & 0xffffffffUL;
+	seed ^= seed >> 17;
+	seed ^= (seed << 5) & 0xffffffffUL;
+	return	seed;
+}
+
+/*
+ * how many subdirectories the next directory gets
+ */
+int
+nchildren()
+{
+	int	n;
+
+	switch (dist) {
+	case DIST_FIXED:
+		return	fanout;
+	case DIST_UNIFORM:
+		return	rnd() % (2*fanout + 1);
+	case DIST_GEOMETRIC:
+		/* keep going with probability fanout/(fanout+1) */
+		n = 0;
+		while (rnd() % (fanout + 1) != 0)
+			n++;
+		return	n;
+	}
+	return	0;
+}
+
+/*
+ * size of the files in a directory, in kilobytes: mostly small,
+ * with the occasional very large one
+ */
+long
+ownsize()
+{
+	return	(rnd() % 64 + 1) << (rnd() % 14);
+}
+
+/*
+ * append a name to path at offset len, unique among the siblings
+ * because it ends with the (decimal) sibling number and is otherwise
+ * all letters.  Returns the new length of path.
+ */
+int
+addname(len, index)
+int len;
+int index;
+{
+	char	digits[16];
+	int	n, nd, i;
+
+	n = rnd() % (2*namelen) + 1;
+	nd = sprintf(digits, "%d", index);
+	if (n < nd)
+		n = nd;
+	if (len + 1 + n >= MAXPATH)
+		return	-1;
+
+	path[len++] = '/';
+	for (i = 0; i < n - nd; i++)
+		path[len++] = 'a' + rnd() % 26;
+	for (i = 0; i < nd; i++)
+		path[len++] = digits[i];
+	path[len] = '\0';
+
+	return	len;
+}
+
+/*
+ * write out the directory in path (of length len) at the given level,
+ * all of its subdirectories first.  Returns its total size.
+ */
+long
+gendir(len, level)
+int len;
+int level;
+{
+	long	size;
+	int	i, n, sublen;
+
+	size = ownsize();
+	n = (level < depth) ? nchildren() : 0;
+	for (i = 0; i < n; i++) {
+		/* leave room for the lines we still owe */
+		if (lines + pending + 1 >= maxlines)
+			break;
+		if ((sublen = addname(len, i)) < 0)
+			break;
+		pending++;
+		size += gendir(sublen, level+1);
+		path[len] = '\0';
+	}
+
+	printf("%ld\t%s\n", size, path);
+	lines++;
+	pending--;
+
+	return	size;
+}
+
+main(argc,argv)
+int argc;
+char **argv;
+{
+	static	char	buf[1<<16];
+
+	while (--argc > 0) {
+		argv++;
+		if (argc > 1 && strcmp(*argv, "-seed") == 0) {
+			seed = atol(*++argv); argc--;
+		} else if (argc > 1 && strcmp(*argv, "-depth") == 0) {
+			depth = atoi(*++argv); argc--;
+		} else if (argc > 1 && strcmp(*argv, "-fanout") == 0) {
+			fanout = atoi(*++argv); argc--;
+		} else if (argc > 1 && strcmp(*argv, "-namelen") == 0) {
+			namelen = atoi(*++argv); argc--;
+		} else if (argc > 1 && strcmp(*argv, "-lines") == 0) {
+			maxlines = atol(*++argv); argc--;
+		} else if (argc > 1 && strcmp(*argv, "-root") == 0) {
+			rootname = *++argv; argc--;
+		} else if (argc > 1 && strcmp(*argv, "-dist") == 0) {
+			argv++; argc--;
+			if (strcmp(*argv, "fixed") == 0)
+				dist = DIST_FIXED;
+			else if (strcmp(*argv, "uniform") == 0)
+				dist = DIST_UNIFORM;
+			else if (strcmp(*argv, "geometric") == 0)
+				dist = DIST_GEOMETRIC;
+			else {
+				fprintf(stderr, "dugen: bad distribution \"%s\"\n", *argv);
+				exit(1);
+			}
+		} else {
+			fprintf(stderr, usage);
+			exit(1);
+		}
+	}
+	if (depth < 0 || depth > MAXDEPTH || fanout < 0 || namelen < 1
+	 || maxlines < 1 || (seed &= 0xffffffffUL) == 0) {
+		fprintf(stderr, usage);
+		exit(1);
+	}
+
+	setvbuf(stdout, buf, _IOFBF, sizeof(buf));
+	strcpy(path, rootname);
+	pending = 1;
+	gendir(strlen(path), 0);
+	fflush(stdout);
+
+	exit(0);
+}
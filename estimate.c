@@ -0,0 +1,495 @@
+/*
+ * XDU - Estimating a scan, then making it exact.
+ *
+ * With -estimate, -scan doesn't read everything before showing
+ * anything.  For ESTTIME seconds it reads directories breadth first,
+ * but only ESTFAN of the subdirectories of each, and lstat()s only
+ * ESTSAMPLE of the files in each; the rest of the files are taken to
+ * be like the ones looked at.  A subdirectory that wasn't read is
+ * taken to be like the ones next to it that were (or, if none were,
+ * like the average directory read).  That is shown straight away.
+ *
+ * Each directory keeps the variance of its own estimate and of its
+ * subtree's, so every size has an error bound.  Then, a little at a
+ * time while xdu is otherwise idle, the directory adding the most
+ * uncertainty is made exact: found by going down from the top into
+ * whichever subtree is least certain, which also tends to be the
+ * biggest.  Files are counted in full by rescandir(); a directory
+ * that wasn't read is read the same way as before, its estimate being
+ * shared among its subdirectories until they are read in turn.
+ *
+ * Copyright (c)	Phillip C. Dykstra	1991, 1993, 1994
+ * The X Consortium, and any party obtaining a copy of these files from
+ * the X Consortium, directly or indirectly, is granted, free of charge, a
+ * full and unrestricted irrevocable, world-wide, paid up, royalty-free,
+ * nonexclusive right and license to deal in this software and
+ * documentation files (the "Software"), including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons who receive
+ * copies from any such party to do so.  This license includes without
+ * limitation a license to do the foregoing actions under any patents of
+ * the party supplying this software to the X Consortium.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "xdu.h"
+#include "stats.h"
+
+#define	ESTTIME		2.0	/* seconds to spend on the first look */
+#define	ESTFAN		8	/* subdirectories of each to read then */
+#define	ESTSAMPLE	32	/* files of each directory to look at */
+#define	ESTBUDGET	100	/* most msec of refining per update */
+
+/* kilobytes allocated to a file, as du -k counts them */
+#define	KBYTES(st)	(((long)(st).st_blocks + 1) / 2)
+
+/* EXPORTS: routines that this module exports outside */
+extern void estimateall();
+extern int estimateupdate();
+extern void unestimate();
+extern void dropestimate();
+int estimating = 0;		/* estimates left to make exact */
+
+/* internal routines */
+static void addvar();
+static void readest();
+static void guesstree();
+static void share();
+static struct node *worst();
+
+static double dirkb;		/* average own size of directories read */
+static double dirbytes;
+static long ndirs;
+
+/*
+ * Add dvar to the variance of np's subtree, and to its ancestors'
+ */
+static void
+addvar(np, dvar)
+struct node *np;
+double dvar;
+{
+	for (; np != NODE_NULL && np->dir != NULL; np = np->parent) {
+		np->dir->var += dvar;
+		if (np->dir->var < 0)
+			np->dir->var = 0;	/* rounding */
+	}
+}
+
+/*
+ * Forget that a directory's own size was estimated, because it has
+ * just been counted exactly.  Any estimates below it stand.
+ */
+void
+unestimate(np)
+struct node *np;
+{
+	if (np->dir == NULL || np->dir->est == 0)
+		return;
+	addvar(np, -np->dir->ownvar);
+	np->dir->est = 0;
+	np->dir->ownvar = 0;
+}
+
+/*
+ * Take the uncertainty of a subtree out of its ancestors,
+ * because the subtree is about to be taken out of the tree
+ */
+void
+dropestimate(np)
+struct node *np;
+{
+	if (np->dir != NULL && np->dir->var > 0)
+		addvar(np->parent, -np->dir->var);
+}
+
+/*
+ * Read the directory np for an estimate.  Every entry is read, but
+ * only a sample of the files is looked at, and the subdirectories get
+ * nodes but aren't read: they are marked EST_UNREAD, sizes still to
+ * be guessed.  Sets np's own size and variance, not its subtree's.
+ */
+static void
+readest(np, hold)
+struct node *np;
+int hold;	/* wait here to keep to the scan rate */
+{
+	char	path[MAXPATH];
+	struct	stat	st;
+	struct	dirent	*dp;
+	struct	node	*cp, **npp;
+	DIR	*dirp;
+	char	**files;
+	double	start, kb, sum, sumsq, sumbytes, links;
+	long	ops;
+	int	len, n, nfiles, maxfiles, m, i;
+
+	start = stattime();
+	nodepath(np, path);
+	len = strlen(path);
+	np->dir->est = 0;
+	np->dir->ownvar = 0;
+	ops = 2;
+	if (lstat(path, &st) == 0) {
+		np->dir->own = KBYTES(st);
+		np->dir->bytes = st.st_size;
+		np->dir->ino = st.st_ino;
+		np->dir->mtime = st.st_mtime;
+		np->dir->ctime = st.st_ctime;
+	}
+	if ((dirp = opendir(path)) == NULL) {
+		fprintf(stderr, "xdu: can't read \"%s\"\n", path);
+		return;
+	}
+
+	nfiles = 0;
+	maxfiles = 64;
+	files = (char **)malloc(maxfiles * sizeof(char *));
+	for (npp = &np->child; *npp != NODE_NULL; npp = &(*npp)->peer)
+		;
+	while ((dp = readdir(dirp)) != NULL) {
+		if (strcmp(dp->d_name, ".") == 0 || strcmp(dp->d_name, "..") == 0)
+			continue;
+		n = strlen(dp->d_name);
+		if (len + 1 + n >= MAXPATH)
+			continue;
+		path[len] = '/';
+		strcpy(&path[len+1], dp->d_name);
+		if (dp->d_type == DT_DIR || dp->d_type == DT_UNKNOWN) {
+			ops++;
+			if (lstat(path, &st) < 0)
+				continue;
+			if (S_ISDIR(st.st_mode)) {
+				cp = newdir((struct worker *)NULL, dp->d_name, &st);
+				cp->dir->est = EST_UNREAD;
+				cp->parent = np;
+				*npp = cp;
+				npp = &cp->peer;
+				continue;
+			}
+		}
+		if (nfiles >= maxfiles) {
+			maxfiles *= 2;
+			files = (char **)realloc((char *)files,
+				maxfiles * sizeof(char *));
+		}
+		files[nfiles++] = strdup(dp->d_name);
+	}
+	closedir(dirp);
+
+	/* an even spread of the files, scaled up to all of them */
+	m = (nfiles < ESTSAMPLE) ? nfiles : ESTSAMPLE;
+	sum = sumsq = sumbytes = 0;
+	links = 0;
+	for (i = 0; i < m; i++) {
+		strcpy(&path[len+1], files[(long)i * nfiles / m]);
+		ops++;
+		if (lstat(path, &st) < 0)
+			continue;
+		kb = KBYTES(st);
+		sum += kb;
+		sumsq += kb * kb;
+		sumbytes += st.st_size;
+		if (st.st_nlink > 1)
+			links += kb;
+	}
+	stats.estfiles += nfiles;
+	np->dir->files = nfiles;	/* those we know exactly */
+	stats.estsampled += m;
+	if (m > 0) {
+		np->dir->own += sum * nfiles / m;
+		np->dir->bytes += sumbytes * nfiles / m;
+		if (m < nfiles) {
+			np->dir->est = EST_FILES;
+			/* the variance of a sample total, without replacement */
+			np->dir->ownvar = (double)nfiles * nfiles
+				* (sumsq - sum * sum / m) / (m > 1 ? m - 1 : 1) / m
+				* (nfiles - m) / nfiles;
+			/* files all alike in the sample needn't be all alike */
+			kb = (sum > 0) ? sum / m : 1;
+			if (np->dir->ownvar < kb * kb * nfiles * (nfiles - m) / m)
+				np->dir->ownvar = kb * kb * nfiles * (nfiles - m) / m;
+		}
+		if (links > 0) {
+			/*
+			 * counted once per link until rescandir(), and the
+			 * other links may be anywhere: all of it may go
+			 */
+			np->dir->est = EST_FILES;
+			kb = links * nfiles / m;
+			if (np->dir->ownvar < kb * kb)
+				np->dir->ownvar = kb * kb;
+		}
+	}
+	for (i = 0; i < nfiles; i++)
+		free(files[i]);
+	free((char *)files);
+
+	dirkb = (dirkb * ndirs + np->dir->own) / (ndirs + 1);
+	dirbytes = (dirbytes * ndirs + np->dir->bytes) / (ndirs + 1);
+	ndirs++;
+	stats.estdirs++;
+	ratepace(ops, stattime() - start, hold);
+}
+
+/*
+ * Guess the sizes of the directories that weren't read in the first
+ * look, bottom up, and add up the variances.  The sizes of np's
+ * subtree go in *kbp and *bytesp.
+ */
+static void
+guesstree(np, kbp, bytesp)
+struct node *np;
+double *kbp, *bytesp;
+{
+	struct	node	*cp;
+	double	kb, bytes, ckb, cbytes, sum, sumsq, sumbytes, mean, var;
+	int	n, u;
+
+	kb = np->dir->own;
+	bytes = np->dir->bytes;
+	np->dir->var = np->dir->ownvar;
+	n = 0;
+	sum = sumsq = sumbytes = 0;
+	for (cp = np->child; cp != NODE_NULL; cp = cp->peer) {
+		if (cp->dir->est & EST_UNREAD)
+			continue;
+		guesstree(cp, &ckb, &cbytes);
+		kb += ckb;
+		bytes += cbytes;
+		np->dir->var += cp->dir->var;
+		sum += ckb;
+		sumsq += ckb * ckb;
+		sumbytes += cbytes;
+		n++;
+	}
+
+	/*
+	 * Like the ones next to them, or else like any directory.  Guesses
+	 * made alike are likely to be wrong alike, so the error in all u of
+	 * them together is taken to be as big as their total.
+	 */
+	u = 0;
+	for (cp = np->child; cp != NODE_NULL; cp = cp->peer) {
+		if (cp->dir->est & EST_UNREAD)
+			u++;
+	}
+	if (n > 0) {
+		mean = sum / n;
+		var = mean * mean * u
+			+ (n > 1 ? (sumsq - sum * sum / n) / (n - 1) : 0);
+	} else {
+		mean = dirkb;
+		var = mean * mean * u;
+	}
+	for (cp = np->child; cp != NODE_NULL; cp = cp->peer) {
+		if ((cp->dir->est & EST_UNREAD) == 0)
+			continue;
+		cp->dir->own = mean;
+		cp->dir->bytes = (n > 0) ? sumbytes / n : dirbytes;
+		cp->dir->ownvar = cp->dir->var = var;
+		np->dir->var += var;
+		kb += cp->dir->own;
+		bytes += cp->dir->bytes;
+	}
+
+	*kbp = kb;
+	*bytesp = bytes;
+}
+
+/*
+ * Take a first look at each of the directories in names[0..n-1], and
+ * put the estimated trees at the top
+ */
+void
+estimateall(names, n)
+char **names;
+int n;
+{
+	char	buf[MAXPATH];
+	struct	stat	st;
+	struct	node	**queue, *np, *cp;
+	double	start, kb, bytes;
+	int	i, len, head, tail, maxqueue, nsub, k;
+
+	start = stattime();
+	maxqueue = 1024;
+	queue = (struct node **)malloc(maxqueue * sizeof(struct node *));
+	head = tail = 0;
+	for (i = 0; i < n; i++) {
+		if ((len = strlen(names[i])) >= MAXPATH) {
+			fprintf(stderr, "xdu: \"%s\" is too long\n", names[i]);
+			exit(1);
+		}
+		strcpy(buf, names[i]);
+		while (len > 1 && buf[len-1] == '/')
+			buf[--len] = '\0';
+		if (lstat(buf, &st) < 0 || !S_ISDIR(st.st_mode)) {
+			fprintf(stderr, "xdu: can't scan \"%s\"\n", names[i]);
+			exit(1);
+		}
+		np = newdir((struct worker *)NULL, buf, &st);
+		np->dir->est = EST_UNREAD;
+		queue[tail++] = np;
+		insertchild(&top, np, ORD_FIRST);
+	}
+
+	/* breadth first, but only down through some of the subdirectories */
+	ratestart(1);
+	while (head < tail && (head < n || stattime() - start < ESTTIME)) {
+		np = queue[head++];
+		readest(np, 1);
+		nsub = 0;
+		for (cp = np->child; cp != NODE_NULL; cp = cp->peer)
+			nsub++;
+		k = 0;
+		for (cp = np->child, i = 0; cp != NODE_NULL; cp = cp->peer, i++) {
+			/* an even spread of ESTFAN of them */
+			if (nsub > ESTFAN && (long)k * nsub / ESTFAN != i)
+				continue;
+			k++;
+			cp->dir->est = 0;	/* read, or to be */
+			if (tail >= maxqueue) {
+				maxqueue *= 2;
+				queue = (struct node **)realloc((char *)queue,
+					maxqueue * sizeof(struct node *));
+			}
+			queue[tail++] = cp;
+		}
+	}
+	/* the ones that didn't get read in time */
+	while (head < tail)
+		queue[head++]->dir->est = EST_UNREAD;
+	free((char *)queue);
+
+	for (np = top.child; np != NODE_NULL; np = np->peer)
+		guesstree(np, &kb, &bytes);
+	measuretree();
+
+	/* any time left goes on making the worst of it exact */
+	estimating = 1;
+	while (estimating && stattime() - start < ESTTIME)
+		estimateupdate();
+	stats.estimatetime = stattime() - start;
+}
+
+/*
+ * Find the directory whose own estimate adds the most uncertainty,
+ * going down into whichever subtree is least certain.  Returns
+ * NODE_NULL if everything is exact.
+ */
+static struct node *
+worst()
+{
+	struct	node	*np, *cp, *best;
+
+	best = NODE_NULL;
+	for (cp = top.child; cp != NODE_NULL; cp = cp->peer) {
+		if (cp->dir != NULL && cp->dir->var > 0
+		 && (best == NODE_NULL || cp->dir->var > best->dir->var))
+			best = cp;
+	}
+	while ((np = best) != NODE_NULL) {
+		best = NODE_NULL;
+		for (cp = np->child; cp != NODE_NULL; cp = cp->peer) {
+			if (cp->dir->var > 0
+			 && (best == NODE_NULL || cp->dir->var > best->dir->var))
+				best = cp;
+		}
+		if (best == NODE_NULL
+		 || (np->dir->est && np->dir->ownvar >= best->dir->var))
+			break;
+	}
+	return	np;
+}
+
+/*
+ * Share the estimate a directory had before it was read among its
+ * subdirectories (or, if it turned out to have more than that in
+ * files, guess them to be like any directory)
+ */
+static void
+share(np, oldkb, oldbytes)
+struct node *np;
+double oldkb, oldbytes;
+{
+	struct	node	*cp;
+	double	kb, bytes;
+	int	n;
+
+	n = 0;
+	for (cp = np->child; cp != NODE_NULL; cp = cp->peer) {
+		if (cp->dir->est & EST_UNREAD)
+			n++;
+	}
+	if (n == 0)
+		return;
+	kb = (oldkb > np->dir->own) ? (oldkb - np->dir->own) / n : dirkb;
+	bytes = (oldbytes > np->dir->bytes) ?
+		(oldbytes - np->dir->bytes) / n : dirbytes;
+	for (cp = np->child; cp != NODE_NULL; cp = cp->peer) {
+		if ((cp->dir->est & EST_UNREAD) == 0)
+			continue;
+		cp->dir->own = kb;
+		cp->dir->bytes = bytes;
+		/* wrong alike, as in guesstree() */
+		cp->dir->ownvar = cp->dir->var = kb * kb * n;
+		np->dir->var += kb * kb * n;
+	}
+}
+
+/*
+ * Make the least certain estimates exact, for up to ESTBUDGET msec
+ * or until the scan rate says to wait.  Returns how many directories
+ * were done, so the caller knows whether to repaint; estimating is
+ * cleared when there are none left.
+ */
+int
+estimateupdate()
+{
+	struct	node	*np;
+	double	start, oldkb, oldbytes, oldvar;
+	long	oldsize, newsize;
+	int	n;
+
+	n = 0;
+	start = stattime();
+	while (estimating && ratewait() == 0) {
+		if ((np = worst()) == NODE_NULL) {
+			estimating = 0;
+			break;
+		}
+		if (np->dir->est == 0) {
+			/* rounding left over, nothing to do */
+			addvar(np, -np->dir->var);
+			continue;
+		}
+		if (np->dir->est & EST_UNREAD) {
+			oldkb = np->dir->own;
+			oldbytes = np->dir->bytes;
+			oldvar = np->dir->var;
+			oldsize = np->size;
+			readest(np, 0);
+			np->dir->var = np->dir->ownvar;
+			share(np, oldkb, oldbytes);
+			addvar(np->parent, np->dir->var - oldvar);
+			newsize = sizetree(np);
+			if (order != ORD_DEFAULT)
+				sorttree(np, order);
+			np->size = oldsize;
+			resizenode(np, newsize - oldsize);
+			totalstale = 1;	/* sizes below it changed too */
+		} else {
+			rescandir(np);	/* calls unestimate() */
+		}
+		stats.refined++;
+		n++;
+		if ((stattime() - start) * 1000 >= ESTBUDGET)
+			break;
+	}
+	return	n;
+}
@@ -0,0 +1,818 @@
+/*
+ * XDU - A history of the same tree, day by day.
+ *
+ * "xdu -record dir" adds the tree it loads (from du output, or a scan)
+ * to a history kept in the directory dir, as the next day.  The days
+ * share one set of paths, each numbered the first day it was seen,
+ * with its parent's number and its name, and one set of names.  Each
+ * day then only adds the paths and names new that day, and a column
+ * of every path's size that day, kept as the change from the day
+ * before so that it packs down to little more than what changed.
+ * The newest day's sizes are kept whole as well, so adding a day
+ * costs about one column, and looking back over w days costs reading
+ * w columns.
+ *
+ * "xdu -history dir" loads the newest day and the one some days
+ * before it (-window) and shows the difference, as -diff does, with
+ * the growth a day alongside.
+ *
+ * The directory holds:
+ *	index		"xdu-history 1", then a line for each day:
+ *			label names paths
+ *			(how many of each there were that day)
+ *	day.N		the names and paths new on day N (from 0) and
+ *			its column
+ *	last.N		the sizes on day N, the newest
+ * The day files are numbers packed 7 bits to the byte, compressed
+ * if we have zlib.  A size is stored as one more than the size, so
+ * 0 means the path wasn't there that day.  A day's line goes in the
+ * index only once its files are all written, so a day cut short by
+ * a crash is as if it had never been recorded.
+ *
+ * Copyright (c)	Phillip C. Dykstra	1991, 1993, 1994
+ * The X Consortium, and any party obtaining a copy of these files from
+ * the X Consortium, directly or indirectly, is granted, free of charge, a
+ * full and unrestricted irrevocable, world-wide, paid up, royalty-free,
+ * nonexclusive right and license to deal in this software and
+ * documentation files (the "Software"), including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons who receive
+ * copies from any such party to do so.  This license includes without
+ * limitation a license to do the foregoing actions under any patents of
+ * the party supplying this software to the X Consortium.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#include "xdu.h"
+#include "stats.h"
+
+#define	HISTMAGIC	"xdu-history"
+#define	HISTVERSION	1
+#define	WINDOW		30	/* days to look back over, by default */
+#define	BUFSIZE		65536	/* bytes read or written at a time */
+
+#ifdef HAVE_ZLIB
+#define	HFILE		gzFile
+#define	HNULL		((gzFile)NULL)
+#define	hopen(p,m)	gzopen(p, m)
+#define	hread(f,b,n)	gzread(f, b, n)
+#define	hwrite(f,b,n)	gzwrite(f, b, n)
+#define	hclose(f)	gzclose(f)
+#else
+#define	HFILE		FILE *
+#define	HNULL		((FILE *)NULL)
+#define	hopen(p,m)	fopen(p, m)
+#define	hread(f,b,n)	fread(b, 1, n, f)
+#define	hwrite(f,b,n)	fwrite(b, 1, n, f)
+#define	hclose(f)	fclose(f)
+#endif
+
+/* EXPORTS: routines that this module exports outside */
+extern int recordmain();
+extern void loadhistory();
+int histdays = 0;		/* days the history shown goes back */
+
+/* internal routines */
+static struct stream *sopen();
+static int sclose();
+static void putbyte();
+static int getbyte();
+static void putnum();
+static unsigned long getnum();
+static void putstr();
+static char *getstr();
+static void readindex();
+static void growpaths();
+static void readday();
+static void readlast();
+static void addpath();
+static long lookup();
+static void rehash();
+static void recordtree();
+static void buildtree();
+
+/*
+ * Stream Structure
+ * One of the files of the history being read or written
+ */
+struct stream {
+	HFILE	f;
+	int	writing;
+	int	err;		/* ran short, or couldn't write */
+	int	len, pos;
+	unsigned char buf[BUFSIZE];
+};
+
+/*
+ * Day Structure
+ * A line of the index
+ */
+struct day {
+	char	label[64];
+	long	nnames;		/* names there were that day */
+	long	npaths;		/* and paths */
+};
+
+static char *histdir;
+static struct day *days;
+static int ndays;
+
+/* the names, by their numbers in the history */
+static unsigned int *hnames;	/* in the dictionary */
+static long nhnames, maxhnames;
+
+/* the paths, by their numbers in the history */
+static unsigned int *parents;	/* one more than the parent's, 0 for the top */
+static unsigned int *pathnames;	/* number of its name */
+static long npaths, maxpaths;
+
+/* paths by parent and name, when recording */
+static long *table;		/* path numbers, -1 for none */
+static long tablesize;
+static long *nameof;		/* the history's number of a dictionary id */
+static long *sizes;		/* one more than each path's size, today */
+
+#define	PATHHASH(p,id)	(((unsigned long)(p) * 2654435761UL) \
+			^ ((unsigned long)(id) * 40503UL))
+
+/*  Streams  */
+
+static struct stream *
+sopen(name, writing)
+char *name;
+int writing;
+{
+	struct	stream	*sp;
+	HFILE	f;
+
+	if ((f = hopen(name, writing ? "wb" : "rb")) == HNULL)
+		return	NULL;
+	if ((sp = (struct stream *)malloc(sizeof(struct stream))) == NULL) {
+		fprintf(stderr, "xdu: out of memory\n");
+		exit(1);
+	}
+	sp->f = f;
+	sp->writing = writing;
+	sp->err = 0;
+	sp->len = sp->pos = 0;
+	return	sp;
+}
+
+/*
+ * Close a stream, returning 0 if everything went in or came out
+ */
+static int
+sclose(sp)
+struct stream *sp;
+{
+	int	err;
+
+	if (sp->writing && sp->len > 0
+	 && hwrite(sp->f, (char *)sp->buf, sp->len) != sp->len)
+		sp->err = 1;
+	if (hclose(sp->f) != 0 && sp->writing)
+		sp->err = 1;
+	err = sp->err;
+	free((char *)sp);
+	return	err;
+}
+
+static void
+putbyte(sp, c)
+struct stream *sp;
+int c;
+{
+	if (sp->len >= BUFSIZE) {
+		if (hwrite(sp->f, (char *)sp->buf, sp->len) != sp->len)
+			sp->err = 1;
+		sp->len = 0;
+	}
+	sp->buf[sp->len++] = c;
+}
+
+static int
+getbyte(sp)
+struct stream *sp;
+{
+	if (sp->pos >= sp->len) {
+		sp->len = hread(sp->f, (char *)sp->buf, BUFSIZE);
+		sp->pos = 0;
+		if (sp->len <= 0) {
+			sp->len = 0;
+			sp->err = 1;
+			return	0;
+		}
+	}
+	return	sp->buf[sp->pos++];
+}
+
+/*
+ * Write a number, 7 bits to the byte, the low ones first
+ */
+static void
+putnum(sp, v)
+struct stream *sp;
+unsigned long v;
+{
+	do {
+		putbyte(sp, (int)(v & 0x7f) | (v > 0x7f ? 0x80 : 0));
+		v >>= 7;
+	} while (v != 0);
+}
+
+static unsigned long
+getnum(sp)
+struct stream *sp;
+{
+	unsigned long	v;
+	int	shift, c;
+
+	v = 0;
+	for (shift = 0; shift < 64; shift += 7) {
+		c = getbyte(sp);
+		v |= (unsigned long)(c & 0x7f) << shift;
+		if (!(c & 0x80))
+			break;
+	}
+	return	v;
+}
+
+/*
+ * Write a string, its length first
+ */
+static void
+putstr(sp, s)
+struct stream *sp;
+char *s;
+{
+	putnum(sp, (unsigned long)strlen(s));
+	for (; *s != '\0'; s++)
+		putbyte(sp, *s);
+}
+
+/*
+ * Read a string into buf, which holds MAXPATH
+ */
+static char *
+getstr(sp, buf)
+struct stream *sp;
+char *buf;
+{
+	unsigned long	len, i;
+
+	if ((len = getnum(sp)) >= MAXPATH)
+		sp->err = 1;
+	for (i = 0; i < len && !sp->err; i++)
+		buf[i] = getbyte(sp);
+	buf[i] = '\0';
+	return	buf;
+}
+
+/* a change in size, which may be negative, as a number and back */
+#define	ZIGZAG(d)	(((unsigned long)(d) << 1) \
+			^ (unsigned long)((d) < 0 ? -1L : 0L))
+#define	UNZIGZAG(v)	((long)((v) >> 1) ^ -(long)((v) & 1))
+
+/*  Reading  */
+
+/*
+ * Read the index of the history in dir.  A history that isn't there
+ * yet has no days.
+ */
+static void
+readindex(dir)
+char *dir;
+{
+	char	path[MAXPATH], buf[256], magic[32];
+	FILE	*fp;
+	int	version, maxdays;
+
+	histdir = dir;
+	ndays = 0;
+	maxdays = 64;
+	days = (struct day *)malloc(maxdays * sizeof(struct day));
+	if (days == NULL) {
+		fprintf(stderr, "xdu: out of memory\n");
+		exit(1);
+	}
+	if (strlen(dir) + 32 > MAXPATH) {
+		fprintf(stderr, "xdu: \"%s\" is too long\n", dir);
+		exit(1);
+	}
+	sprintf(path, "%s/index", dir);
+	if ((fp = fopen(path, "r")) == NULL)
+		return;
+	if (fgets(buf, sizeof(buf), fp) == NULL
+	 || sscanf(buf, "%31s %d", magic, &version) != 2
+	 || strcmp(magic, HISTMAGIC) != 0 || version != HISTVERSION) {
+		fprintf(stderr, "xdu: \"%s\" isn't a history\n", dir);
+		exit(1);
+	}
+	while (fgets(buf, sizeof(buf), fp) != NULL) {
+		if (ndays >= maxdays) {
+			maxdays *= 2;
+			days = (struct day *)realloc((char *)days,
+				maxdays * sizeof(struct day));
+			if (days == NULL) {
+				fprintf(stderr, "xdu: out of memory\n");
+				exit(1);
+			}
+		}
+		if (sscanf(buf, "%63s %ld %ld", days[ndays].label,
+		    &days[ndays].nnames, &days[ndays].npaths) != 3)
+			break;		/* cut short: the days before are good */
+		ndays++;
+	}
+	fclose(fp);
+}
+
+/*
+ * Make room for n names and paths
+ */
+static void
+growpaths(n, m)
+long n;		/* names */
+long m;		/* paths */
+{
+	if (n > maxhnames) {
+		maxhnames = (2 * maxhnames > n) ? 2 * maxhnames : n;
+		hnames = (unsigned int *)realloc((char *)hnames,
+			maxhnames * sizeof(unsigned int));
+	}
+	if (m > maxpaths) {
+		maxpaths = (2 * maxpaths > m) ? 2 * maxpaths : m;
+		parents = (unsigned int *)realloc((char *)parents,
+			maxpaths * sizeof(unsigned int));
+		pathnames = (unsigned int *)realloc((char *)pathnames,
+			maxpaths * sizeof(unsigned int));
+	}
+	if ((maxhnames > 0 && hnames == NULL)
+	 || (maxpaths > 0 && (parents == NULL || pathnames == NULL))) {
+		fprintf(stderr, "xdu: out of memory\n");
+		exit(1);
+	}
+}
+
+/*
+ * Read day d's new names and paths, and if sizes isn't NULL, take its
+ * changes out of them: sizes goes from day d to the day before.
+ */
+static void
+readday(d, sizes)
+int d;
+long *sizes;
+{
+	char	path[MAXPATH], s[MAXPATH];
+	struct	stream	*sp;
+	unsigned long	n, i, v;
+
+	sprintf(path, "%s/day.%d", histdir, d);
+	if ((sp = sopen(path, 0)) == NULL) {
+		fprintf(stderr, "xdu: can't read \"%s\"\n", path);
+		exit(1);
+	}
+
+	n = getnum(sp);
+	growpaths(nhnames + (long)n, npaths);
+	for (i = 0; i < n && !sp->err; i++)
+		hnames[nhnames++] = intern(getstr(sp, s));
+
+	n = getnum(sp);
+	growpaths(nhnames, npaths + (long)n);
+	for (i = 0; i < n && !sp->err; i++) {
+		parents[npaths] = getnum(sp);
+		pathnames[npaths] = getnum(sp);
+		if (parents[npaths] > npaths || pathnames[npaths] >= nhnames)
+			sp->err = 1;
+		npaths++;
+	}
+
+	if (sizes != NULL) {
+		n = getnum(sp);
+		for (i = 0; i < n && !sp->err; i++) {
+			v = getnum(sp);
+			sizes[i] -= UNZIGZAG(v);
+		}
+		stats.histcolumns++;
+	}
+	if (sclose(sp) != 0 || nhnames != days[d].nnames
+	 || npaths != days[d].npaths) {
+		fprintf(stderr, "xdu: \"%s\" is damaged\n", path);
+		exit(1);
+	}
+}
+
+/*
+ * Read the sizes on the newest day, d, into sizes
+ */
+static void
+readlast(d, sizes)
+int d;
+long *sizes;
+{
+	char	path[MAXPATH];
+	struct	stream	*sp;
+	unsigned long	n, i;
+
+	sprintf(path, "%s/last.%d", histdir, d);
+	if ((sp = sopen(path, 0)) == NULL) {
+		fprintf(stderr, "xdu: can't read \"%s\"\n", path);
+		exit(1);
+	}
+	n = getnum(sp);
+	for (i = 0; i < n && i < (unsigned long)days[d].npaths && !sp->err; i++)
+		sizes[i] = getnum(sp);
+	if (sclose(sp) != 0 || n != (unsigned long)days[d].npaths) {
+		fprintf(stderr, "xdu: \"%s\" is damaged\n", path);
+		exit(1);
+	}
+}
+
+/*
+ * Hang the paths there were (sizes not 0) on the day of sizes
+ * under np
+ */
+static void
+buildtree(np, sizes)
+struct node *np;
+long *sizes;
+{
+	struct	node	**nodes, *cp, *pp;
+	long	i;
+
+	nodes = (struct node **)malloc((npaths + 1) * sizeof(struct node *));
+	if (nodes == NULL) {
+		fprintf(stderr, "xdu: out of memory\n");
+		exit(1);
+	}
+	for (i = 0; i < npaths; i++) {
+		nodes[i] = NODE_NULL;
+		if (sizes[i] > 0)
+			nodes[i] = makenode(namestr(hnames[pathnames[i]]),
+				sizes[i] - 1, (struct input *)NULL);
+	}
+	/* backwards, so each list of children comes out in order */
+	for (i = npaths - 1; i >= 0; i--) {
+		if ((cp = nodes[i]) == NODE_NULL)
+			continue;
+		pp = parents[i] ? nodes[parents[i] - 1] : np;
+		if (pp == NODE_NULL) {
+			free((char *)cp);	/* its parent wasn't there */
+			continue;
+		}
+		cp->parent = pp;
+		cp->peer = pp->child;
+		pp->child = cp;
+	}
+	free((char *)nodes);
+}
+
+/*
+ * Load the newest day in the history in dir under newp, and the day
+ * window days before it (or the first) under oldp, for difftree()
+ */
+void
+loadhistory(dir, window, oldp, newp)
+char *dir;
+int window;
+struct node *oldp, *newp;
+{
+	long	*newsizes, *oldsizes, i;
+	double	t;
+	int	d, last;
+
+	t = stattime();
+	readindex(dir);
+	if (ndays < 2) {
+		fprintf(stderr, "xdu: \"%s\" needs two days recorded\n", dir);
+		exit(1);
+	}
+	last = ndays - 1;
+	if (window <= 0)
+		window = WINDOW;
+	if (window > last)
+		window = last;
+	histdays = window;
+
+	newsizes = (long *)malloc((days[last].npaths + 1) * sizeof(long));
+	oldsizes = (long *)malloc((days[last].npaths + 1) * sizeof(long));
+	if (newsizes == NULL || oldsizes == NULL) {
+		fprintf(stderr, "xdu: out of memory\n");
+		exit(1);
+	}
+	readlast(last, newsizes);
+	for (i = 0; i < days[last].npaths; i++)
+		oldsizes[i] = newsizes[i];
+	for (d = 0; d <= last; d++)
+		readday(d, d > last - window ? oldsizes : (long *)NULL);
+
+	buildtree(newp, newsizes);
+	buildtree(oldp, oldsizes);
+	free((char *)newsizes);
+	free((char *)oldsizes);
+	stats.histtime += stattime() - t;
+}
+
+/*  Recording  */
+
+/*
+ * The number of the path under parent p (one more than its number,
+ * 0 for the top) with dictionary name id, or -1
+ */
+static long
+lookup(p, id)
+unsigned long p;
+unsigned int id;
+{
+	long	i, j;
+
+	for (i = PATHHASH(p, id) & (tablesize - 1); (j = table[i]) >= 0;
+	    i = (i + 1) & (tablesize - 1)) {
+		if (parents[j] == p && hnames[pathnames[j]] == id)
+			return	j;
+	}
+	return	-1;
+}
+
+/*
+ * Put path j in the table, making it bigger if need be
+ */
+static void
+addpath(j)
+long j;
+{
+	long	i;
+
+	if (2 * (j + 1) > tablesize) {
+		free((char *)table);
+		tablesize = tablesize ? 2 * tablesize : 1024;
+		while (2 * (j + 1) > tablesize)
+			tablesize *= 2;
+		rehash(j);
+		return;
+	}
+	for (i = PATHHASH(parents[j], hnames[pathnames[j]]) & (tablesize - 1);
+	    table[i] >= 0; i = (i + 1) & (tablesize - 1))
+		;
+	table[i] = j;
+}
+
+/*
+ * Put paths 0 to n in a table of tablesize
+ */
+static void
+rehash(n)
+long n;
+{
+	long	i, j;
+
+	if ((table = (long *)malloc(tablesize * sizeof(long))) == NULL) {
+		fprintf(stderr, "xdu: out of memory\n");
+		exit(1);
+	}
+	for (i = 0; i < tablesize; i++)
+		table[i] = -1;
+	for (j = 0; j <= n; j++) {
+		for (i = PATHHASH(parents[j], hnames[pathnames[j]])
+		    & (tablesize - 1); table[i] >= 0; i = (i + 1) & (tablesize - 1))
+			;
+		table[i] = j;
+	}
+}
+
+/*
+ * Note today's sizes of the children of np, whose number is p - 1
+ * (0 for the top), numbering the ones that are new
+ */
+static void
+recordtree(np, p)
+struct node *np;
+unsigned long p;
+{
+	struct	node	*cp;
+	long	j, old;
+
+	for (cp = np->child; cp != NODE_NULL; cp = cp->peer) {
+		if ((j = lookup(p, cp->nameid)) < 0) {
+			if (nameof[cp->nameid] < 0) {
+				growpaths(nhnames + 1, npaths);
+				nameof[cp->nameid] = nhnames;
+				hnames[nhnames++] = cp->nameid;
+			}
+			old = maxpaths;
+			growpaths(nhnames, npaths + 1);
+			if (maxpaths > old) {
+				sizes = (long *)realloc((char *)sizes,
+					maxpaths * sizeof(long));
+				if (sizes == NULL) {
+					fprintf(stderr, "xdu: out of memory\n");
+					exit(1);
+				}
+			}
+			j = npaths++;
+			parents[j] = p;
+			pathnames[j] = nameof[cp->nameid];
+			sizes[j] = 0;
+			addpath(j);
+		}
+		sizes[j] = (cp->size > 0 ? cp->size : 0) + 1;
+		recordtree(cp, (unsigned long)j + 1);
+	}
+}
+
+static char recusage[] = "\
+Usage: xdu -record dir [-day label] [-options ...] filename ...\n\
+   or  xdu -record dir [-day label] [-options ...] < du.out\n\
+\n\
+Adds the output of du (or a scan) to the history in dir, as the next day\n\
+  options include:\n\
+  -day label     What to call the day (today's date)\n\
+  -j num         Read inputs on num threads (one per cpu)\n\
+  -scan dir ...  Read the directories instead of du output\n\
+  -checkpoint file  Log the scan in file as it goes, and carry on from it\n\
+  -apparent      Record the apparent sizes of scanned files\n\
+  -rate num      Scan at most num files a second\n\
+  -stats         Dump profiling stats to standard error on exit\n\
+";
+
+recordmain(argc, argv)
+int argc;
+char **argv;
+{
+	char	path[MAXPATH], tmpname[MAXPATH], label[64], *dir;
+	struct	stream	*sp;
+	long	*before, oldhnames, oldpaths, i;
+	double	t;
+	time_t	now;
+	FILE	*fp;
+	int	n, k, d, err;
+
+	/* take out the options we know, leaving the rest for load() */
+	dir = NULL;
+	label[0] = '\0';
+	n = 1;
+	for (i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-record") == 0 && i+1 < argc) {
+			dir = argv[++i];
+		} else if (strcmp(argv[i], "-day") == 0 && i+1 < argc) {
+			if (strlen(argv[++i]) >= sizeof(label)
+			 || strpbrk(argv[i], " \t\n") != NULL) {
+				fprintf(stderr, "xdu: bad day \"%s\"\n", argv[i]);
+				return	1;
+			}
+			strcpy(label, argv[i]);
+		} else if (strcmp(argv[i], "-apparent") == 0) {
+			setmeasure("apparent");
+		} else if (strcmp(argv[i], "-stats") == 0) {
+			statsflag = 1;
+		} else if (strcmp(argv[i], "-estimate") == 0
+			|| strcmp(argv[i], "-diff") == 0
+			|| strcmp(argv[i], "-history") == 0
+			|| strcmp(argv[i], "-window") == 0
+			|| strcmp(argv[i], "-attach") == 0
+			|| strcmp(argv[i], "-snapshot") == 0
+			|| strcmp(argv[i], "-maxnodes") == 0) {
+			/* a day is every path's exact size, as it is now */
+			fprintf(stderr, "xdu: %s doesn't go with -record\n",
+				argv[i]);
+			return	1;
+		} else if ((k = loadoption(argv[i])) > 0 && i+k <= argc) {
+			argv[n++] = argv[i];	/* for load() */
+			if (k > 1)
+				argv[n++] = argv[++i];
+		} else if (argv[i][0] == '-' && argv[i][1] != '\0') {
+			fprintf(stderr, recusage);
+			return	1;
+		} else {
+			argv[n++] = argv[i];
+		}
+	}
+	argv[n] = NULL;
+	argc = n;
+	if (dir == NULL) {
+		fprintf(stderr, recusage);
+		return	1;
+	}
+	if (label[0] == '\0') {
+		now = time((time_t *)NULL);
+		strftime(label, sizeof(label), "%Y-%m-%d", localtime(&now));
+	}
+	if (statsflag)
+		atexit(statsdump);
+
+	/* what we have so far */
+	t = stattime();
+	readindex(dir);
+	if (ndays == 0 && mkdir(dir, 0777) < 0 && access(dir, W_OK) < 0) {
+		fprintf(stderr, "xdu: can't make \"%s\"\n", dir);
+		return	1;
+	}
+	for (d = 0; d < ndays; d++)
+		readday(d, (long *)NULL);
+	oldhnames = nhnames;
+	oldpaths = npaths;
+	before = (long *)malloc((oldpaths + 1) * sizeof(long));
+	sizes = (long *)malloc((maxpaths + 1) * sizeof(long));
+	if (before == NULL || sizes == NULL) {
+		fprintf(stderr, "xdu: out of memory\n");
+		return	1;
+	}
+	if (ndays > 0)
+		readlast(ndays - 1, before);
+	stats.histtime += stattime() - t;
+
+	/* today */
+	load(argc, argv);
+
+	t = stattime();
+	tablesize = 1024;
+	while (2 * (npaths + 1) > tablesize)
+		tablesize *= 2;
+	rehash(npaths - 1);
+	nameof = (long *)malloc(nnames * sizeof(long));
+	if (nameof == NULL) {
+		fprintf(stderr, "xdu: out of memory\n");
+		return	1;
+	}
+	for (i = 0; i < nnames; i++)
+		nameof[i] = -1;
+	for (i = 0; i < nhnames; i++)
+		nameof[hnames[i]] = i;
+	for (i = 0; i < npaths; i++)
+		sizes[i] = 0;
+	recordtree(&top, 0UL);
+
+	/* the day's names, paths and changes */
+	d = ndays;
+	sprintf(path, "%s/day.%d", dir, d);
+	if ((sp = sopen(path, 1)) == NULL) {
+		fprintf(stderr, "xdu: can't create \"%s\"\n", path);
+		return	1;
+	}
+	putnum(sp, (unsigned long)(nhnames - oldhnames));
+	for (i = oldhnames; i < nhnames; i++)
+		putstr(sp, namestr(hnames[i]));
+	putnum(sp, (unsigned long)(npaths - oldpaths));
+	for (i = oldpaths; i < npaths; i++) {
+		putnum(sp, (unsigned long)parents[i]);
+		putnum(sp, (unsigned long)pathnames[i]);
+	}
+	putnum(sp, (unsigned long)npaths);
+	for (i = 0; i < npaths; i++)
+		putnum(sp, ZIGZAG(sizes[i] - (i < oldpaths ? before[i] : 0)));
+	err = sclose(sp);
+
+	/* the whole of the day */
+	sprintf(path, "%s/last.%d", dir, d);
+	if (!err && (sp = sopen(path, 1)) != NULL) {
+		putnum(sp, (unsigned long)npaths);
+		for (i = 0; i < npaths; i++)
+			putnum(sp, (unsigned long)sizes[i]);
+		err = sclose(sp);
+	} else {
+		err = 1;
+	}
+	if (err) {
+		fprintf(stderr, "xdu: can't write \"%s\"\n", path);
+		return	1;
+	}
+
+	/* and only then the index, which makes it count */
+	sprintf(path, "%s/index", dir);
+	if (d == 0) {
+		sprintf(tmpname, "%s/index.new", dir);
+		if ((fp = fopen(tmpname, "w")) == NULL) {
+			fprintf(stderr, "xdu: can't create \"%s\"\n", tmpname);
+			return	1;
+		}
+		fprintf(fp, "%s %d\n", HISTMAGIC, HISTVERSION);
+	} else if ((fp = fopen(path, "a")) == NULL) {
+		fprintf(stderr, "xdu: can't write \"%s\"\n", path);
+		return	1;
+	}
+	fprintf(fp, "%s %ld %ld\n", label, nhnames, npaths);
+	if (fflush(fp) != 0 || ferror(fp) || fsync(fileno(fp)) < 0) {
+		fprintf(stderr, "xdu: can't write \"%s\"\n", path);
+		fclose(fp);
+		return	1;
+	}
+	fclose(fp);
+	if (d == 0 && rename(tmpname, path) < 0) {
+		fprintf(stderr, "xdu: can't rename \"%s\"\n", tmpname);
+		return	1;
+	}
+	if (d > 0) {
+		sprintf(path, "%s/last.%d", dir, d - 1);
+		unlink(path);		/* only the newest is kept whole */
+	}
+	stats.histtime += stattime() - t;
+	return	0;
+}
@@ -0,0 +1,287 @@
+/*
+ * XDU - Reading many inputs at once.
+ *
+ * Each du output named on the command line (or found in a directory
+ * named there) is an input.  Inputs are parsed on a pool of threads,
+ * biggest first, each into a tree of its own, so no locking is needed
+ * while parsing.  When there is more than one input, each tree is
+ * hung under a node named for the host it came from (the file name,
+ * less any ".du"); attaching those is a few pointer assignments once
+ * every thread is done.
+ *
+ * Copyright (c)	Phillip C. Dykstra	1991, 1993, 1994
+ * The X Consortium, and any party obtaining a copy of these files from
+ * the X Consortium, directly or indirectly, is granted, free of charge, a
+ * full and unrestricted irrevocable, world-wide, paid up, royalty-free,
+ * nonexclusive right and license to deal in this software and
+ * documentation files (the "Software"), including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons who receive
+ * copies from any such party to do so.  This license includes without
+ * limitation a license to do the foregoing actions under any patents of
+ * the party supplying this software to the X Consortium.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "xdu.h"
+#include "stats.h"
+
+/* EXPORTS: routines that this module exports outside */
+extern void addinputs();
+extern void readinputs();
+int nthreads = 0;		/* parsing threads, 0 for one per cpu */
+
+/* IMPORTS: routines that this module uses from xdu.c */
+extern struct node *makenode();
+
+/* internal routines */
+static void addinput();
+static int bigger();
+static int filecmp();
+static void *worker();
+
+static struct input **inputs = NULL;	/* waiting to be read */
+static struct input **queue = NULL;	/* the same, biggest first */
+static int ninputs = 0;
+static int maxinputs = 0;
+static int nextinput;			/* next one for a worker to take */
+static pthread_mutex_t nextlock = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * Add one input to the list, to be read into the tree at destp.
+ * A host name means hang it under a node of that name.
+ */
+static void
+addinput(filename, host, destp)
+char *filename;
+char *host;
+struct node *destp;
+{
+	struct	input	*ip;
+	struct	stat	st;
+	char	name[MAXPATH];
+	char	*cp;
+
+	if (ninputs >= maxinputs) {
+		maxinputs = maxinputs ? 2 * maxinputs : 64;
+		inputs = (struct input **)realloc((char *)inputs,
+			maxinputs * sizeof(struct input *));
+		queue = (struct input **)realloc((char *)queue,
+			maxinputs * sizeof(struct input *));
+	}
+	ip = (struct input *)calloc(1, sizeof(struct input));
+	ip->filename = filename;
+	ip->destp = destp;
+
+	if (strcmp(filename, "-") == 0)
+		ip->bytes = -1;		/* can't tell, so take it first */
+	else if (stat(filename, &st) == 0)
+		ip->bytes = st.st_size;
+
+	if (host == NULL) {
+		ip->rootp = destp;
+	} else {
+		if ((cp = strrchr(host, '/')) != NULL)
+			host = cp + 1;
+		strncpy(name, host, sizeof(name)-1);
+		name[sizeof(name)-1] = '\0';
+		if ((cp = strrchr(name, '.')) != NULL
+		 && (strcmp(cp, ".gz") == 0 || strcmp(cp, ".zst") == 0))
+			*cp = '\0';
+		if ((cp = strrchr(name, '.')) != NULL && strcmp(cp, ".du") == 0)
+			*cp = '\0';
+		ip->rootp = makenode(name, -1L, (struct input *)NULL);
+	}
+	inputs[ninputs++] = ip;
+}
+
+static int
+filecmp(p1, p2)
+char **p1, **p2;
+{
+	return	strcmp(*p1, *p2);
+}
+
+/*
+ * Add the inputs named by names[0..n-1] to the list, to be read into
+ * the tree at destp.  A directory stands for the files in it.  A
+ * single file is read straight into destp, anything more gets a
+ * node per host.
+ */
+void
+addinputs(names, n, destp)
+char **names;
+int n;
+struct node *destp;
+{
+	struct	stat	st;
+	struct	dirent	*dp;
+	DIR	*dirp;
+	char	**files;
+	char	*path;
+	int	i, j, nfiles, maxfiles;
+
+	if (n == 1 && (stat(names[0], &st) < 0 || !S_ISDIR(st.st_mode))) {
+		addinput(names[0], (char *)NULL, destp);
+		return;
+	}
+
+	for (i = 0; i < n; i++) {
+		if (stat(names[i], &st) < 0 || !S_ISDIR(st.st_mode)) {
+			addinput(names[i], names[i], destp);
+			continue;
+		}
+		if ((dirp = opendir(names[i])) == NULL) {
+			fprintf(stderr, "xdu: can't read directory \"%s\"\n",
+				names[i]);
+			exit(1);
+		}
+		/* in name order, so the hosts always come out the same */
+		nfiles = 0;
+		maxfiles = 64;
+		files = (char **)malloc(maxfiles * sizeof(char *));
+		while ((dp = readdir(dirp)) != NULL) {
+			if (dp->d_name[0] == '.')
+				continue;
+			path = malloc(strlen(names[i]) + strlen(dp->d_name) + 2);
+			sprintf(path, "%s/%s", names[i], dp->d_name);
+			if (stat(path, &st) < 0 || !S_ISREG(st.st_mode)) {
+				free(path);
+				continue;
+			}
+			if (nfiles >= maxfiles) {
+				maxfiles *= 2;
+				files = (char **)realloc((char *)files,
+					maxfiles * sizeof(char *));
+			}
+			files[nfiles++] = path;
+		}
+		closedir(dirp);
+		qsort((char *)files, nfiles, sizeof(char *), filecmp);
+		for (j = 0; j < nfiles; j++)
+			addinput(files[j], files[j], destp);
+		free((char *)files);
+	}
+}
+
+/*
+ * qsort() comparison putting the biggest inputs first, so that the
+ * one that takes longest is never started last
+ */
+static int
+bigger(p1, p2)
+struct input **p1, **p2;
+{
+	if ((*p1)->bytes == (*p2)->bytes)
+		return	0;
+	if ((*p1)->bytes < 0)
+		return	-1;
+	if ((*p2)->bytes < 0)
+		return	1;
+	return	((*p1)->bytes > (*p2)->bytes) ? -1 : 1;
+}
+
+/*
+ * parsing thread: take inputs off the list until there are none left
+ */
+static void *
+worker(arg)
+void *arg;
+{
+	struct	input	*ip;
+
+	for (;;) {
+		pthread_mutex_lock(&nextlock);
+		ip = (nextinput < ninputs) ? queue[nextinput++] : NULL;
+		pthread_mutex_unlock(&nextlock);
+		if (ip == NULL)
+			break;
+		parse_file(ip);
+	}
+	return	arg;
+}
+
+/*
+ * Read all of the inputs on the list, then attach the trees
+ * and add up their counts.  The list is emptied.
+ */
+void
+readinputs()
+{
+	pthread_t	*tids;
+	struct	input	*ip;
+	struct	node	*np, **npp, *lastdest;
+	int	i, n;
+
+	n = nthreads;
+	if (n <= 0)
+		n = sysconf(_SC_NPROCESSORS_ONLN);
+	if (n > ninputs)
+		n = ninputs;
+
+	for (i = 0; i < ninputs; i++) {
+		queue[i] = inputs[i];
+		if (nodebudget > 0)	/* shared out evenly */
+			inputs[i]->budget = (nodebudget + ninputs - 1) / ninputs;
+	}
+	qsort((char *)queue, ninputs, sizeof(struct input *), bigger);
+	nextinput = 0;
+	if (n <= 1) {
+		n = 1;
+		worker((void *)NULL);
+	} else {
+		tids = (pthread_t *)malloc(n * sizeof(pthread_t));
+		for (i = 0; i < n; i++) {
+			if (pthread_create(&tids[i], NULL, worker, NULL) != 0) {
+				fprintf(stderr, "xdu: can't start thread\n");
+				exit(1);
+			}
+		}
+		for (i = 0; i < n; i++)
+			pthread_join(tids[i], NULL);
+		free((char *)tids);
+	}
+
+	/*
+	 * Hang each host's tree on the end of its destination's children,
+	 * in command line order.  Inputs for the same destination were
+	 * added together, so it only has to be looked for once.
+	 */
+	lastdest = NODE_NULL;
+	npp = NULL;
+	for (i = 0; i < ninputs; i++) {
+		ip = inputs[i];
+		if (ip->rootp != ip->destp) {
+			if (ip->destp != lastdest) {
+				lastdest = ip->destp;
+				for (npp = &lastdest->child; *npp != NODE_NULL;
+				    npp = &(*npp)->peer)
+					;
+			}
+			np = ip->rootp;
+			np->parent = lastdest;
+			*npp = np;
+			npp = &np->peer;
+		}
+		stats.readbytes += ip->readbytes;
+		stats.lines += ip->lines;
+		stats.nodes += ip->nodes - ip->freed;
+		stats.collapses += ip->collapsed;
+		stats.dropped += ip->freed;
+		stats.strcmps += ip->strcmps;
+		stats.unpacked += ip->unpacked;
+		stats.unpacktime += ip->unpacktime;
+		stats.unpackwait += ip->unpackwait;
+		free((char *)ip);
+	}
+	stats.inputs += ninputs;
+	if (n > stats.threads)
+		stats.threads = n;
+	ninputs = 0;
+}
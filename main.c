@@ -0,0 +1,97 @@
+/*
+ *			M A I N . C
+ *
+ * Display the output of "du" in an X window,
+ * or draw it into an image file.
+ *
+ * Phillip C. Dykstra
+ * <phil@arl.mil>
+ * 4 Sep 1991.
+ * 
+ * Copyright (c)	Phillip C. Dykstra	1991, 1993, 1994
+ * The X Consortium, and any party obtaining a copy of these files from
+ * the X Consortium, directly or indirectly, is granted, free of charge, a
+ * full and unrestricted irrevocable, world-wide, paid up, royalty-free,
+ * nonexclusive right and license to deal in this software and
+ * documentation files (the "Software"), including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons who receive
+ * copies from any such party to do so.  This license includes without
+ * limitation a license to do the foregoing actions under any patents of
+ * the party supplying this software to the X Consortium.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "xdu.h"
+#include "stats.h"
+
+/* What we IMPORT from xwin.c */
+extern int xsetup(), xmainloop(), xoption();
+extern struct display xdisplay;
+
+/* What we IMPORT from render.c */
+extern int rendermain();
+
+/* What we IMPORT from query.c */
+extern int querymain();
+
+/* What we IMPORT from history.c */
+extern int recordmain();
+
+/* What we IMPORT from serve.c */
+extern int servemain();
+
+main(argc,argv)
+int argc;
+char **argv;
+{
+	char	**largv;
+	int	i, n, largc;
+
+	stats.start = stattime();
+
+	/* drawing into a file, or printing, mustn't need an X server */
+	for (i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-render") == 0)
+			exit(rendermain(argc, argv));
+		if (strcmp(argv[i], "-query") == 0)
+			exit(querymain(argc, argv));
+		if (strcmp(argv[i], "-record") == 0)
+			exit(recordmain(argc, argv));
+		if (strcmp(argv[i], "-serve") == 0)
+			exit(servemain(argc, argv));
+	}
+
+	/*
+	 * Read the inputs while the window is set up, which can take a
+	 * while with a distant X server.  The loader gets our options and
+	 * the inputs, the toolkit all of them, and takes out its own.
+	 */
+	largv = (char **)malloc((argc + 1) * sizeof(char *));
+	largc = 0;
+	largv[largc++] = argv[0];
+	for (i = 1; i < argc; i++) {
+		if ((n = loadoption(argv[i])) > 0) {
+			largv[largc++] = argv[i];
+			if (n > 1 && i+1 < argc)
+				largv[largc++] = argv[++i];
+		} else if ((n = xoption(argv[i])) > 0) {
+			if (n > 1 && i+1 < argc)
+				i++;
+		} else if (argv[i][0] != '-' || argv[i][1] == '\0') {
+			largv[largc++] = argv[i];
+		}
+	}
+	largv[largc] = NULL;
+
+	display = &xdisplay;
+	loadstart(largc, largv);
+	xsetup(&argc,argv);
+	if (statsflag)
+		atexit(statsdump);
+	loadfinish(argc, argv);
+
+	xmainloop();
+	exit(0);
+}
@@ -0,0 +1,304 @@
+/*
+ * XDU - The dictionary of names.
+ *
+ * The same few names (src, .git, node_modules, objects...) turn up
+ * over and over in a big tree, so each one is kept here just once, and
+ * nodes hold the number of theirs.  Numbers are handed out in the
+ * order names are first seen, and the strings go one after another, in
+ * that order, in big blocks that never move; so NAME() is two array
+ * lookups and needs no locking, and names made together stay close.
+ *
+ * Names can be added by any number of threads at once.  The hash
+ * table is split into stripes, each with a lock of its own, by the
+ * low bits of the hash; only handing out a new number takes the one
+ * lock that they all share.
+ *
+ * For the alphabetical orders each name also gets its rank among all
+ * the names, so that compare() can compare two numbers rather than
+ * two strings.  Ranking sorts all the names, so it is only done again
+ * when enough new ones have turned up; names newer than that are
+ * compared as strings.
+ *
+ * Copyright (c)	Phillip C. Dykstra	1991, 1993, 1994
+ * The X Consortium, and any party obtaining a copy of these files from
+ * the X Consortium, directly or indirectly, is granted, free of charge, a
+ * full and unrestricted irrevocable, world-wide, paid up, royalty-free,
+ * nonexclusive right and license to deal in this software and
+ * documentation files (the "Software"), including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons who receive
+ * copies from any such party to do so.  This license includes without
+ * limitation a license to do the foregoing actions under any patents of
+ * the party supplying this software to the X Consortium.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "xdu.h"
+#include "stats.h"
+
+#define	NSTRIPES	64	/* separately locked parts of the table */
+#define	NBUCKETS	1024	/* to start with, in each stripe */
+#define	ARENA		65536	/* bytes of strings allocated at a time */
+
+/* EXPORTS: routines that this module exports outside */
+extern unsigned int intern();
+extern int namecmp();
+extern void nameranks();
+extern int utf8len();
+char **namestrs[NAMECHUNKS];	/* the strings, see namestr() */
+unsigned int nnames;		/* names there are, numbered from 0 */
+
+/* internal routines */
+static unsigned int newname();
+static int rankcmp();
+
+/*
+ * Stripe Structure
+ * One part of the hash table: the names whose hashes end in its
+ * number, chained through nexts[].
+ */
+struct stripe {
+	pthread_mutex_t lock;
+	unsigned int	*buckets;	/* first name in each, or NONAME */
+	unsigned int	nbuckets;
+	unsigned int	n;		/* names in it */
+};
+
+#define	NONAME		0xffffffffU
+
+static struct stripe stripes[NSTRIPES];
+static pthread_once_t once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t newlock = PTHREAD_MUTEX_INITIALIZER;
+
+/* per name, alongside namestrs[] */
+static unsigned int *nexts[NAMECHUNKS];	/* next in its bucket */
+static unsigned int *hashes[NAMECHUNKS];	/* hash of the name */
+static unsigned int *ranks[NAMECHUNKS];	/* place in alphabetical order */
+#define	NEXT(id)	nexts[(id) >> NAMESHIFT][(id) & NAMEMASK]
+#define	HASH(id)	hashes[(id) >> NAMESHIFT][(id) & NAMEMASK]
+#define	RANK(id)	ranks[(id) >> NAMESHIFT][(id) & NAMEMASK]
+
+static char *arena;		/* where the next string goes */
+static int left;		/* bytes free there */
+static unsigned int nranked;	/* names below this have a rank */
+
+static void
+init()
+{
+	struct	stripe	*sp;
+	int	i;
+
+	for (sp = stripes; sp < &stripes[NSTRIPES]; sp++) {
+		pthread_mutex_init(&sp->lock, NULL);
+		sp->nbuckets = NBUCKETS;
+		sp->buckets = (unsigned int *)malloc(NBUCKETS * sizeof(unsigned int));
+		if (sp->buckets == NULL) {
+			fprintf(stderr, "xdu: out of memory\n");
+			exit(1);
+		}
+		for (i = 0; i < NBUCKETS; i++)
+			sp->buckets[i] = NONAME;
+	}
+}
+
+/*
+ * Return the number of a name, adding it if it is new
+ */
+unsigned int
+intern(name)
+char *name;
+{
+	struct	stripe	*sp;
+	unsigned char	*cp;
+	unsigned int	hash, h, id, *bp, *old;
+	unsigned int	i, j, n;
+	int	len;
+
+	pthread_once(&once, init);
+
+	/* FNV-1a */
+	h = 2166136261U;
+	for (cp = (unsigned char *)name; *cp != '\0'; cp++)
+		h = (h ^ *cp) * 16777619U;
+	len = cp - (unsigned char *)name;
+	hash = h;
+	sp = &stripes[h % NSTRIPES];
+	h /= NSTRIPES;
+
+	pthread_mutex_lock(&sp->lock);
+	bp = &sp->buckets[h & (sp->nbuckets - 1)];
+	for (id = *bp; id != NONAME; id = NEXT(id)) {
+		if (HASH(id) == hash && strcmp(namestr(id), name) == 0) {
+			pthread_mutex_unlock(&sp->lock);
+			return	id;
+		}
+	}
+
+	id = newname(name, len + 1);
+	HASH(id) = hash;
+	NEXT(id) = *bp;
+	*bp = id;
+
+	/* keep the chains short */
+	if (++sp->n > 2 * sp->nbuckets) {
+		old = sp->buckets;
+		n = sp->nbuckets;
+		sp->nbuckets *= 2;
+		sp->buckets = (unsigned int *)malloc(sp->nbuckets
+			* sizeof(unsigned int));
+		if (sp->buckets == NULL) {
+			fprintf(stderr, "xdu: out of memory\n");
+			exit(1);
+		}
+		for (i = 0; i < sp->nbuckets; i++)
+			sp->buckets[i] = NONAME;
+		for (i = 0; i < n; i++) {
+			while ((j = old[i]) != NONAME) {
+				old[i] = NEXT(j);
+				h = HASH(j) / NSTRIPES;
+				bp = &sp->buckets[h & (sp->nbuckets - 1)];
+				NEXT(j) = *bp;
+				*bp = j;
+			}
+		}
+		free((char *)old);
+	}
+	pthread_mutex_unlock(&sp->lock);
+	return	id;
+}
+
+/*
+ * Hand out the next number, for a copy of the string s (len bytes
+ * with its '\0'), making room for them if need be
+ */
+static unsigned int
+newname(s, len)
+char *s;
+int len;
+{
+	unsigned int	id, c;
+
+	pthread_mutex_lock(&newlock);
+	id = nnames;
+	c = id >> NAMESHIFT;
+	if ((id & NAMEMASK) == 0) {
+		if (c >= NAMECHUNKS) {
+			fprintf(stderr, "xdu: too many names\n");
+			exit(1);
+		}
+		namestrs[c] = (char **)malloc(NAMECHUNK * sizeof(char *));
+		nexts[c] = (unsigned int *)malloc(NAMECHUNK * sizeof(unsigned int));
+		hashes[c] = (unsigned int *)malloc(NAMECHUNK * sizeof(unsigned int));
+		ranks[c] = (unsigned int *)malloc(NAMECHUNK * sizeof(unsigned int));
+		if (namestrs[c] == NULL || nexts[c] == NULL || hashes[c] == NULL
+		 || ranks[c] == NULL) {
+			fprintf(stderr, "xdu: out of memory\n");
+			exit(1);
+		}
+	}
+	if (len > left) {
+		if ((arena = malloc(ARENA)) == NULL) {
+			fprintf(stderr, "xdu: out of memory\n");
+			exit(1);
+		}
+		left = ARENA;	/* the rest of the old one is lost */
+	}
+	memcpy(arena, s, len);
+	namestrs[c][id & NAMEMASK] = arena;
+	arena += len;
+	left -= len;
+	nnames++;
+	stats.names++;
+	stats.namebytes += len;
+	pthread_mutex_unlock(&newlock);
+	return	id;
+}
+
+/*
+ * Compare two names as strcmp() would, by rank if they have one
+ */
+int
+namecmp(a, b)
+unsigned int a, b;
+{
+	if (a == b)
+		return	0;
+	if (a < nranked && b < nranked)
+		return	(RANK(a) < RANK(b)) ? -1 : 1;
+	return	strcmp(namestr(a), namestr(b));
+}
+
+static int
+rankcmp(p1, p2)
+unsigned int *p1, *p2;
+{
+	return	strcmp(namestr(*p1), namestr(*p2));
+}
+
+/*
+ * Rank the names, before sorting the tree by them, if enough are new
+ * since the last time to be worth it.  Not to be called while the
+ * tree is being read.
+ */
+void
+nameranks()
+{
+	unsigned int	*ids, i, n;
+	double	t;
+
+	pthread_mutex_lock(&newlock);
+	n = nnames;
+	pthread_mutex_unlock(&newlock);
+	if (n - nranked <= nranked / 8)
+		return;
+
+	t = stattime();
+	if ((ids = (unsigned int *)malloc(n * sizeof(unsigned int))) == NULL) {
+		fprintf(stderr, "xdu: out of memory\n");
+		exit(1);
+	}
+	for (i = 0; i < n; i++)
+		ids[i] = i;
+	qsort((char *)ids, n, sizeof(unsigned int), rankcmp);
+	for (i = 0; i < n; i++)
+		RANK(ids[i]) = i;
+	free((char *)ids);
+	nranked = n;
+	stats.nameranks++;
+	stats.ranktime += stattime() - t;
+}
+
+/*
+ * How many bytes the character at s takes if it is UTF-8, or 0 if it
+ * isn't (old names are often Latin-1), so that names can be written
+ * where only UTF-8 will do
+ */
+int
+utf8len(s)
+char *s;
+{
+	unsigned char	*u;
+	int	n, i;
+
+	u = (unsigned char *)s;
+	if (u[0] < 0x80)
+		n = 1;
+	else if (u[0] >= 0xc2 && u[0] <= 0xdf)
+		n = 2;
+	else if (u[0] >= 0xe0 && u[0] <= 0xef)
+		n = 3;
+	else if (u[0] >= 0xf0 && u[0] <= 0xf4)
+		n = 4;
+	else
+		return	0;
+	for (i = 1; i < n; i++)
+		if ((u[i] & 0xc0) != 0x80)
+			return	0;	/* including the '\0' at the end */
+	/* not the long way round, surrogates, or past U+10FFFF */
+	if ((u[0] == 0xe0 && u[1] < 0xa0) || (u[0] == 0xed && u[1] >= 0xa0)
+	 || (u[0] == 0xf0 && u[1] < 0x90) || (u[0] == 0xf4 && u[1] >= 0x90))
+		return	0;
+	return	n;
+}
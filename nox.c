@@ -0,0 +1,59 @@
+/*
+ * XDU - Standing in for the window, in an xdu built without X.
+ *
+ * xdurender is main.c and everything but xwin.c, so that -render,
+ * -query, -record and -serve work on machines without the X
+ * libraries.  Asked for a window, it says it can't make one.
+ *
+ * Copyright (c)	Phillip C. Dykstra	1991, 1993, 1994
+ * The X Consortium, and any party obtaining a copy of these files from
+ * the X Consortium, directly or indirectly, is granted, free of charge, a
+ * full and unrestricted irrevocable, world-wide, paid up, royalty-free,
+ * nonexclusive right and license to deal in this software and
+ * documentation files (the "Software"), including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons who receive
+ * copies from any such party to do so.  This license includes without
+ * limitation a license to do the foregoing actions under any patents of
+ * the party supplying this software to the X Consortium.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "xdu.h"
+
+/* EXPORTS: what main.c takes from xwin.c */
+extern int xsetup();
+extern int xoption();
+extern int xmainloop();
+extern struct display xdisplay;
+
+/* internal routines */
+static int nodraw();
+
+struct display xdisplay = { nodraw, nodraw, nodraw };
+
+static int
+nodraw()
+{
+	return	0;
+}
+
+xsetup(argcp, argv)
+int *argcp;
+char **argv;
+{
+	fprintf(stderr,
+	    "xdu: built without X, only -render, -query, -record and -serve work\n");
+	exit(1);
+}
+
+xoption(arg)
+char *arg;
+{
+	return	0;
+}
+
+xmainloop()
+{
+	return	0;
+}
@@ -0,0 +1,522 @@
+/*
+ * XDU - Printing the tree for scripts.
+ *
+ * "xdu -query" loads the tree as usual, then instead of displaying
+ * it, prints the size and path of the directories asked for, as text
+ * like du's or as JSON.  A query picks directories by a pattern for
+ * their paths, and goes some number of levels below each, listing
+ * children in any of the sort orders, at most so many of them, and
+ * none smaller than a given size.
+ *
+ * There may be millions of lines, so the paths are built up as the
+ * tree is walked rather than for each line, the numbers are converted
+ * by hand, and everything goes through a buffer of our own.
+ *
+ * Copyright (c)	Phillip C. Dykstra	1991, 1993, 1994
+ * The X Consortium, and any party obtaining a copy of these files from
+ * the X Consortium, directly or indirectly, is granted, free of charge, a
+ * full and unrestricted irrevocable, world-wide, paid up, royalty-free,
+ * nonexclusive right and license to deal in this software and
+ * documentation files (the "Software"), including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons who receive
+ * copies from any such party to do so.  This license includes without
+ * limitation a license to do the foregoing actions under any patents of
+ * the party supplying this software to the X Consortium.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fnmatch.h>
+#include "xdu.h"
+#include "stats.h"
+
+/* EXPORTS: routines that this module exports outside */
+extern int querymain();
+
+/* internal routines */
+static int qrepaint();
+static int qdrawrect();
+static int qtextheight();
+static void select_();
+static int emit();
+static void row();
+static void breakrows();
+static void oflush();
+static void oputn();
+static void oputs();
+static void oputlong();
+static void oputjson();
+
+static struct display qdisplay = { qdrawrect, qtextheight, qrepaint };
+
+#define	FMT_TEXT	1
+#define	FMT_JSON	2
+
+#define	OBUFSIZE	65536	/* bytes written at a time */
+
+static char *pattern;		/* paths to pick, NULL for the top */
+static int patslashes;		/* number of '/' in it */
+static int maxdepth = 0;	/* levels to go below each picked */
+static long maxkids = 0;	/* children listed of each, 0 for all */
+static long minsize = 0;	/* smallest size listed */
+static int format = FMT_TEXT;
+static int by = -1;		/* what to break each down by, or -1 */
+static long nrows;
+
+static char path[MAXPATH];	/* of the node being looked at */
+static char obuf[OBUFSIZE];
+static int olen;
+static int oerror;
+
+static char usage[] = "\
+Usage: xdu -query [-options ...] filename ...\n\
+   or  xdu -query [-options ...] < du.out\n\
+\n\
+Prints the sizes of directories from the output of du (or a scan)\n\
+  options include:\n\
+  -path pattern  Directories to list, e.g. /var/* (the top by default)\n\
+  -depth num     Also list num levels below each (0)\n\
+  -sort order    Order to list children in: first, last, alpha,\n\
+                 ralpha, size, rsize, growth, rgrowth, own, files,\n\
+                 dirs, depth, or those with r in front (first)\n\
+  -label what    Print own size, files, dirs or depth, not size\n\
+  -by what       Print the space in each by ext (extension) or owner\n\
+  -top num       List at most the first num children of each\n\
+  -min size      Leave out anything smaller than size\n\
+  -json          Print JSON instead of du-like lines\n\
+  -diff old new  Print what changed from old to new\n\
+  -history dir   Print what changed over the last days recorded in dir\n\
+  -window days   How many days back -history looks (30)\n\
+  -attach sock   Print the tree served on the socket sock (xdu -serve)\n\
+  -j num         Read inputs on num threads (one per cpu)\n\
+  -maxnodes num  Keep no more than num nodes, collapsing small directories\n\
+  -scan dir ...  Read the directories instead of du output\n\
+  -estimate      Print an estimate of the scan, from a sample of it\n\
+  -snapshot file Print the scan saved in file (or save it, with -scan)\n\
+  -checkpoint file  Log the scan in file as it goes, and carry on from it\n\
+  -apparent      Print the apparent sizes of scanned files\n\
+  -rate num      Scan at most num files a second\n\
+  -stats         Dump profiling stats to standard error on exit\n\
+";
+
+querymain(argc, argv)
+int argc;
+char **argv;
+{
+	double	t;
+	char	*cp;
+	int	i, n, k;
+
+	/* take out the options we know, leaving the rest for load() */
+	n = 1;
+	for (i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-query") == 0) {
+			;
+		} else if (strcmp(argv[i], "-path") == 0 && i+1 < argc) {
+			pattern = argv[++i];
+		} else if (strcmp(argv[i], "-depth") == 0 && i+1 < argc) {
+			maxdepth = atoi(argv[++i]);
+			if (maxdepth < 0) {
+				fprintf(stderr, "xdu: bad depth\n");
+				return	1;
+			}
+		} else if (strcmp(argv[i], "-sort") == 0 && i+1 < argc) {
+			order = 0;	/* left alone if the name is bad */
+			setorder(argv[++i]);
+			if (order == 0)
+				return	1;
+		} else if (strcmp(argv[i], "-top") == 0 && i+1 < argc) {
+			maxkids = atol(argv[++i]);
+			if (maxkids < 1) {
+				fprintf(stderr, "xdu: bad number for -top\n");
+				return	1;
+			}
+		} else if (strcmp(argv[i], "-min") == 0 && i+1 < argc) {
+			minsize = atol(argv[++i]);
+		} else if (strcmp(argv[i], "-label") == 0 && i+1 < argc) {
+			label = 0;	/* left alone if the name is bad */
+			setlabel(argv[++i]);
+			if (label == 0)
+				return	1;
+		} else if (strcmp(argv[i], "-by") == 0 && i+1 < argc) {
+			i++;
+			if (strcmp(argv[i], "ext") == 0) {
+				by = BY_EXT;
+			} else if (strcmp(argv[i], "owner") == 0) {
+				by = BY_OWNER;
+			} else {
+				fprintf(stderr, "xdu: bad breakdown \"%s\"\n", argv[i]);
+				return	1;
+			}
+		} else if (strcmp(argv[i], "-json") == 0) {
+			format = FMT_JSON;
+		} else if (strcmp(argv[i], "-apparent") == 0) {
+			setmeasure("apparent");
+		} else if (strcmp(argv[i], "-stats") == 0) {
+			statsflag = 1;
+		} else if ((k = loadoption(argv[i])) > 0 && i+k <= argc) {
+			argv[n++] = argv[i];	/* for load() */
+			if (k > 1)
+				argv[n++] = argv[++i];
+		} else if (argv[i][0] == '-' && argv[i][1] != '\0') {
+			fprintf(stderr, usage);
+			return	1;
+		} else {
+			argv[n++] = argv[i];
+		}
+	}
+	argv[n] = NULL;
+	argc = n;
+
+	/* a leading / or ./ makes no difference, as for the paths */
+	if (pattern != NULL) {
+		while (*pattern == '/' || (pattern[0] == '.' && pattern[1] == '/'))
+			pattern += (*pattern == '/') ? 1 : 2;
+		if (*pattern == '\0' || strcmp(pattern, ".") == 0)
+			pattern = NULL;		/* just the top */
+	}
+	if (pattern != NULL) {
+		for (cp = pattern; *cp != '\0'; cp++)
+			if (*cp == '/')
+				patslashes++;
+	}
+
+	display = &qdisplay;
+	if (statsflag)
+		atexit(statsdump);
+
+	load(argc, argv);
+
+	t = stattime();
+	if (format == FMT_JSON)
+		oputs("[");
+	if (pattern != NULL || topp == &top)
+		select_(&top, 0);
+	else
+		emit(topp, strlen(searchpath(topp, path)), 0);
+	if (format == FMT_JSON)
+		oputs(nrows > 0 ? "\n]\n" : "]\n");
+	oflush();
+	stats.queryrows += nrows;
+	stats.querytime += stattime() - t;
+
+	if (oerror) {
+		fprintf(stderr, "xdu: error writing the query results\n");
+		return	1;
+	}
+	return	0;
+}
+
+/*
+ * Add a node's name to the path of its parent, which is len long.
+ * Returns the new length.
+ */
+static int
+addpath(np, len)
+struct node *np;
+int len;
+{
+	int	n;
+
+	n = strlen(NAME(np));
+	if (len + 1 + n >= MAXPATH)
+		return	len;	/* too deep: shown as its parent */
+	if (len > 0 && path[len-1] != '/')
+		path[len++] = '/';
+	memcpy(&path[len], NAME(np), n + 1);
+	return	len + n;
+}
+
+/*
+ * Look below np, whose path is len long, for directories whose paths
+ * match the pattern (all of them with no pattern), and emit them.
+ * A path with as many '/' as the pattern that doesn't match has
+ * nothing below it that could.
+ */
+static void
+select_(np, len)
+struct node *np;
+int len;
+{
+	struct	node *cp;
+	char	*p, *q;
+	long	kids;
+	int	n, s;
+
+	kids = 0;
+	for (cp = np->child; cp != NODE_NULL; cp = cp->peer) {
+		if (maxkids > 0 && kids >= maxkids)
+			break;
+		n = addpath(cp, len);
+		if (pattern == NULL) {
+			kids += emit(cp, n, 0);
+			continue;
+		}
+		/* the path less any leading / or ./, as the pattern */
+		for (p = path; *p == '/' || (p[0] == '.' && p[1] == '/'); )
+			p += (*p == '/') ? 1 : 2;
+		if (strcmp(p, ".") == 0) {
+			select_(cp, n);		/* du . */
+			continue;
+		}
+		for (s = 0, q = p; *q != '\0'; q++)
+			if (*q == '/')
+				s++;
+		if (s == patslashes && fnmatch(pattern, p, FNM_PATHNAME) == 0)
+			kids += emit(cp, n, 0);
+		else if (s < patslashes)
+			select_(cp, n);
+	}
+	path[len] = '\0';
+}
+
+/*
+ * Print np, whose path is len long, and its children depth levels
+ * down.  Returns 1 if it was printed, 0 if it was too small.
+ */
+static int
+emit(np, len, depth)
+struct node *np;
+int len;
+int depth;
+{
+	struct	node *cp;
+	long	kids;
+	int	n;
+
+	if (np->size < minsize)
+		return	0;
+	row(np, depth);
+	if (depth < maxdepth) {
+		kids = 0;
+		for (cp = np->child; cp != NODE_NULL; cp = cp->peer) {
+			if (maxkids > 0 && kids >= maxkids)
+				break;
+			n = addpath(cp, len);
+			kids += emit(cp, n, depth + 1);
+			path[len] = '\0';
+		}
+	}
+	return	1;
+}
+
+/*
+ * Print one line of the results, for np, whose path is in path[]
+ */
+static void
+row(np, depth)
+struct node *np;
+int depth;
+{
+	if (by >= 0) {
+		breakrows(np, depth);
+		return;
+	}
+	if (format == FMT_TEXT) {
+		switch (label) {
+		case LABEL_OWN:
+			oputlong(np->own);
+			break;
+		case LABEL_FILES:
+			oputlong(np->files);
+			break;
+		case LABEL_DIRS:
+			oputlong(np->dirs);
+			break;
+		case LABEL_DEPTH:
+			oputlong((long)np->depth);
+			break;
+		default:
+			oputlong(diffmode ? np->delta : np->size);
+			break;
+		}
+		oputs("\t");
+		oputs(path);
+		oputs("\n");
+	} else {
+		oputs(nrows > 0 ? ",\n{\"path\":" : "\n{\"path\":");
+		oputjson(path);
+		oputs(",\"size\":");
+		oputlong(np->size);
+		if (diffmode) {
+			oputs(",\"change\":");
+			oputlong(np->delta);
+		}
+		oputs(",\"own\":");
+		oputlong(np->own);
+		oputs(",\"files\":");
+		oputlong(np->files);
+		oputs(",\"dirs\":");
+		oputlong(np->dirs);
+		oputs(",\"levels\":");
+		oputlong((long)np->depth);
+		oputs(",\"depth\":");
+		oputlong((long)depth);
+		if (np->hidden > 0) {
+			oputs(",\"collapsed\":");
+			oputlong(np->hidden);
+		}
+		oputs("}");
+	}
+	nrows++;
+}
+
+/*
+ * Print the space in np, whose path is in path[], by extension or by
+ * owner: a line for each, biggest first, leaving out the small ones
+ */
+static void
+breakrows(np, depth)
+struct node *np;
+int depth;
+{
+	struct	share	*sp;
+	char	buf[32], *name;
+	int	i, n;
+
+	sp = breakdown(np, by, &n);
+	for (i = 0; i < n && sp->own >= minsize; i++, sp++) {
+		name = keyname(by, sp->key, buf);
+		if (format == FMT_TEXT) {
+			oputlong(sp->own);
+			oputs("\t");
+			oputs(name);
+			oputs("\t");
+			oputs(path);
+			oputs("\n");
+		} else {
+			oputs(nrows > 0 ? ",\n{\"path\":" : "\n{\"path\":");
+			oputjson(path);
+			oputs(by == BY_EXT ? ",\"ext\":" : ",\"owner\":");
+			oputjson(name);
+			oputs(",\"size\":");
+			oputlong(sp->own);
+			oputs(",\"depth\":");
+			oputlong((long)depth);
+			oputs("}");
+		}
+		nrows++;
+	}
+}
+
+/*  Buffered Output  */
+
+static void
+oflush()
+{
+	int	n, off;
+
+	for (off = 0; off < olen; off += n) {
+		if ((n = write(1, &obuf[off], olen - off)) <= 0) {
+			oerror = 1;
+			break;
+		}
+	}
+	olen = 0;
+}
+
+static void
+oputs(s)
+char *s;
+{
+	oputn(s, strlen(s));
+}
+
+static void
+oputn(s, n)
+char *s;
+int n;
+{
+	while (olen + n > OBUFSIZE) {
+		memcpy(&obuf[olen], s, OBUFSIZE - olen);
+		s += OBUFSIZE - olen;
+		n -= OBUFSIZE - olen;
+		olen = OBUFSIZE;
+		oflush();
+	}
+	memcpy(&obuf[olen], s, n);
+	olen += n;
+}
+
+static void
+oputlong(v)
+long v;
+{
+	char	buf[24], *cp;
+	unsigned long	u;
+
+	cp = &buf[sizeof(buf)];
+	*--cp = '\0';
+	u = (v < 0) ? -(unsigned long)v : v;
+	do {
+		*--cp = '0' + u % 10;
+		u /= 10;
+	} while (u != 0);
+	if (v < 0)
+		*--cp = '-';
+	oputs(cp);
+}
+
+/*
+ * A JSON string, with quotes and escapes.  Bytes that aren't UTF-8
+ * are taken to be Latin-1.
+ */
+static void
+oputjson(s)
+char *s;
+{
+	static	char	hex[] = "0123456789abcdef";
+	char	buf[8];
+	char	*start;
+	int	n;
+
+	oputs("\"");
+	for (start = s; *s != '\0'; s += n) {
+		n = utf8len(s);
+		if (n > 1 || (n == 1 && *s != '"' && *s != '\\'
+		 && (unsigned char)*s >= ' '))
+			continue;
+		/* the plain run before it, then it escaped */
+		oputn(start, s - start);
+		n = 1;
+		start = s + 1;
+		if (*s == '"' || *s == '\\') {
+			buf[0] = '\\';
+			buf[1] = *s;
+			buf[2] = '\0';
+		} else {
+			strcpy(buf, "\\u00");
+			buf[4] = hex[(*s >> 4) & 0xf];
+			buf[5] = hex[*s & 0xf];
+			buf[6] = '\0';
+		}
+		oputs(buf);
+	}
+	oputs(start);
+	oputs("\"");
+}
+
+/*  Display Routines: there is no display  */
+
+static int
+qrepaint()
+{
+	return	0;
+}
+
+static int
+qdrawrect(name, size, x, y, width, height)
+char *name;
+char *size;
+int x, y, width, height;
+{
+	return	0;
+}
+
+static int
+qtextheight()
+{
+	return	1;
+}
@@ -0,0 +1,174 @@
+/*
+ * XDU - Keeping a scan from swamping the file system.
+ *
+ * Every directory read by the scanner (scan.c) is charged here with
+ * the number of operations it took (a getdents for the directory and
+ * an lstat for each entry) and how long they took.  While they stay
+ * quick, the scan runs flat out, on as many threads as it has.  When
+ * the average time per operation climbs well above the quickest seen
+ * (and above SLOWOP, so that a cache miss on a local disk doesn't
+ * count), the file system is taken to be busy: both the rate allowed
+ * and the number of threads reading at once are halved.  They come
+ * back up a step each RATEPERIOD that the file system stays quick,
+ * until there is no limit again.  With -rate, the operations a second
+ * never go over the number given, however quick they are.
+ *
+ * Copyright (c)	Phillip C. Dykstra	1991, 1993, 1994
+ * The X Consortium, and any party obtaining a copy of these files from
+ * the X Consortium, directly or indirectly, is granted, free of charge, a
+ * full and unrestricted irrevocable, world-wide, paid up, royalty-free,
+ * nonexclusive right and license to deal in this software and
+ * documentation files (the "Software"), including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons who receive
+ * copies from any such party to do so.  This license includes without
+ * limitation a license to do the foregoing actions under any patents of
+ * the party supplying this software to the X Consortium.
+ */
+#include <stdio.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "xdu.h"
+#include "stats.h"
+
+#define	RATEPERIOD	0.25	/* seconds between adjustments */
+#define	SLOWOP		0.002	/* seconds an operation may take anyway */
+#define	SLOWFACTOR	4	/* times the quickest, to count as slow */
+#define	RATEMIN		20	/* fewest operations a second allowed */
+
+/* EXPORTS: routines that this module exports outside */
+extern void ratestart();
+extern double ratepace();
+extern double ratewait();
+extern int ratethreads();
+long ratelimit = 0;		/* most operations a second, 0 for no limit */
+
+static pthread_mutex_t ratelock = PTHREAD_MUTEX_INITIALIZER;
+static int started = 0;
+static int maxthreads;		/* threads the scan has */
+static int active;		/* of those, how many may read at once */
+static double allowed;		/* operations a second, 0 for no limit */
+static double peak;		/* best rate seen with no limit */
+static double latency;		/* average seconds an operation takes */
+static double quickest;		/* lowest that average has been */
+static double next;		/* when the next operation may start */
+static double periodstart;
+static long periodops;
+
+/*
+ * Get ready for a scan on nthreads threads
+ */
+void
+ratestart(nthreads)
+int nthreads;
+{
+	pthread_mutex_lock(&ratelock);
+	if (!started) {
+		/* the rest is kept from one scan to the next */
+		allowed = ratelimit;
+		active = nthreads;
+		periodstart = next = stattime();
+		started = 1;
+	}
+	maxthreads = nthreads;
+	if (active > maxthreads)
+		active = maxthreads;
+	stats.scanlimit = allowed;
+	pthread_mutex_unlock(&ratelock);
+}
+
+/*
+ * Charge ops operations, which took secs seconds between them, and
+ * adjust the rate allowed if it is time.  Returns how long to wait
+ * before the next operation to keep to the rate; if hold is set,
+ * that wait is done here.
+ */
+double
+ratepace(ops, secs, hold)
+long ops;
+double secs;
+int hold;
+{
+	double	now, wait;
+
+	if (ops <= 0)
+		return	0;
+	pthread_mutex_lock(&ratelock);
+	stats.scanops += ops;
+	latency = (latency == 0) ? secs / ops : 0.8 * latency + 0.2 * secs / ops;
+	if (quickest == 0 || latency < quickest)
+		quickest = latency;
+
+	now = stattime();
+	periodops += ops;
+	if (now - periodstart >= RATEPERIOD) {
+		stats.scanrate = periodops / (now - periodstart);
+		if (latency > SLOWFACTOR * quickest && latency > SLOWOP) {
+			/* busy: back off */
+			if (peak == 0)
+				peak = stats.scanrate;
+			if (allowed == 0 || allowed > stats.scanrate)
+				allowed = stats.scanrate;
+			allowed /= 2;
+			if (allowed < RATEMIN)
+				allowed = RATEMIN;
+			active = (active + 1) / 2;
+			stats.backoffs++;
+		} else {
+			if (active < maxthreads)
+				active++;
+			if (allowed == 0 && stats.scanrate > peak)
+				peak = stats.scanrate;
+			if (allowed != 0 && allowed != ratelimit) {
+				allowed *= 1.25;
+				if (ratelimit == 0 && allowed >= peak)
+					allowed = 0;	/* back to flat out */
+			}
+		}
+		if (ratelimit > 0 && (allowed == 0 || allowed > ratelimit))
+			allowed = ratelimit;
+		stats.scanlimit = allowed;
+		periodstart = now;
+		periodops = 0;
+	}
+
+	wait = 0;
+	if (allowed > 0) {
+		/* time not used while idle isn't saved up for a burst */
+		if (next < now)
+			next = now;
+		next += ops / allowed;
+		wait = next - now;
+		if (hold && wait > 0)
+			stats.throttletime += wait;
+	}
+	pthread_mutex_unlock(&ratelock);
+
+	if (hold && wait > 0)
+		usleep((unsigned long)(wait * 1000000));
+	return	wait;
+}
+
+/*
+ * How many seconds until another operation may start
+ */
+double
+ratewait()
+{
+	double	wait;
+
+	pthread_mutex_lock(&ratelock);
+	wait = (allowed > 0) ? next - stattime() : 0;
+	pthread_mutex_unlock(&ratelock);
+
+	return	(wait > 0) ? wait : 0;
+}
+
+/*
+ * How many threads may be reading directories at once
+ */
+int
+ratethreads()
+{
+	return	active;
+}
@@ -0,0 +1,607 @@
+/*
+ * XDU - Image File Interface.
+ *
+ * Draws the display into a PNG or SVG file instead of a window, so
+ * that reports can be made on machines without an X server.  Nothing
+ * in here uses X: the PNG is drawn with a built in bitmap font into a
+ * one bit deep image, and written out with stored (uncompressed)
+ * deflate blocks, so no other libraries are needed either.
+ *
+ * Copyright (c)	Phillip C. Dykstra	1991, 1993, 1994
+ * The X Consortium, and any party obtaining a copy of these files from
+ * the X Consortium, directly or indirectly, is granted, free of charge, a
+ * full and unrestricted irrevocable, world-wide, paid up, royalty-free,
+ * nonexclusive right and license to deal in this software and
+ * documentation files (the "Software"), including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons who receive
+ * copies from any such party to do so.  This license includes without
+ * limitation a license to do the foregoing actions under any patents of
+ * the party supplying this software to the X Consortium.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "xdu.h"
+#include "stats.h"
+
+/* EXPORTS: routines that this module exports outside */
+extern int rendermain();
+
+/* internal routines */
+static int rrepaint();
+static int rdrawrect();
+static int rtextheight();
+static void pngline();
+static void pngtext();
+static void pngwrite();
+static void svgtext();
+static struct display rdisplay = { rdrawrect, rtextheight, rrepaint };
+
+#define	FMT_PNG		1
+#define	FMT_SVG		2
+
+static char *outname;		/* file to write */
+static FILE *outfp;
+static int format = FMT_PNG;
+static int width = 600;		/* same as the window default */
+static int height = 480;
+static int showsize = 1;
+static int reverse = 0;		/* white on black */
+
+/* PNG image, one bit per pixel, 1 for ink, rows padded to a byte */
+static unsigned char *bits;
+static int rowbytes;
+
+/* SVG font metrics, guessed for a 12 point monospaced font */
+#define	SVG_FONTSIZE	12
+#define	SVG_CHARWIDTH	7.2
+#define	SVG_ASCENT	10
+#define	SVG_DESCENT	3
+
+/* PNG font metrics */
+#define	FONT_WIDTH	5	/* of a glyph */
+#define	FONT_ADVANCE	6	/* from one glyph to the next */
+#define	FONT_ASCENT	7
+#define	FONT_DESCENT	1
+
+/*
+ * 5x7 font for the printable ASCII characters, starting with space.
+ * Each glyph is five columns, left to right, with the top row in the
+ * low order bit of each.
+ */
+static unsigned char font[95][5] = {
+	{0x00,0x00,0x00,0x00,0x00}, {0x00,0x00,0x5F,0x00,0x00},
+	{0x00,0x07,0x00,0x07,0x00}, {0x14,0x7F,0x14,0x7F,0x14},
+	{0x24,0x2A,0x7F,0x2A,0x12}, {0x23,0x13,0x08,0x64,0x62},
+	{0x36,0x49,0x55,0x22,0x50}, {0x00,0x05,0x03,0x00,0x00},
+	{0x00,0x1C,0x22,0x41,0x00}, {0x00,0x41,0x22,0x1C,0x00},
+	{0x08,0x2A,0x1C,0x2A,0x08}, {0x08,0x08,0x3E,0x08,0x08},
+	{0x00,0x50,0x30,0x00,0x00}, {0x08,0x08,0x08,0x08,0x08},
+	{0x00,0x60,0x60,0x00,0x00}, {0x20,0x10,0x08,0x04,0x02},
+	{0x3E,0x51,0x49,0x45,0x3E}, {0x00,0x42,0x7F,0x40,0x00},
+	{0x42,0x61,0x51,0x49,0x46}, {0x21,0x41,0x45,0x4B,0x31},
+	{0x18,0x14,0x12,0x7F,0x10}, {0x27,0x45,0x45,0x45,0x39},
+	{0x3C,0x4A,0x49,0x49,0x30}, {0x01,0x71,0x09,0x05,0x03},
+	{0x36,0x49,0x49,0x49,0x36}, {0x06,0x49,0x49,0x29,0x1E},
+	{0x00,0x36,0x36,0x00,0x00}, {0x00,0x56,0x36,0x00,0x00},
+	{0x08,0x14,0x22,0x41,0x00}, {0x14,0x14,0x14,0x14,0x14},
+	{0x00,0x41,0x22,0x14,0x08}, {0x02,0x01,0x51,0x09,0x06},
+	{0x32,0x49,0x79,0x41,0x3E}, {0x7E,0x11,0x11,0x11,0x7E},
+	{0x7F,0x49,0x49,0x49,0x36}, {0x3E,0x41,0x41,0x41,0x22},
+	{0x7F,0x41,0x41,0x22,0x1C}, {0x7F,0x49,0x49,0x49,0x41},
+	{0x7F,0x09,0x09,0x09,0x01}, {0x3E,0x41,0x49,0x49,0x7A},
+	{0x7F,0x08,0x08,0x08,0x7F}, {0x00,0x41,0x7F,0x41,0x00},
+	{0x20,0x40,0x41,0x3F,0x01}, {0x7F,0x08,0x14,0x22,0x41},
+	{0x7F,0x40,0x40,0x40,0x40}, {0x7F,0x02,0x0C,0x02,0x7F},
+	{0x7F,0x04,0x08,0x10,0x7F}, {0x3E,0x41,0x41,0x41,0x3E},
+	{0x7F,0x09,0x09,0x09,0x06}, {0x3E,0x41,0x51,0x21,0x5E},
+	{0x7F,0x09,0x19,0x29,0x46}, {0x46,0x49,0x49,0x49,0x31},
+	{0x01,0x01,0x7F,0x01,0x01}, {0x3F,0x40,0x40,0x40,0x3F},
+	{0x1F,0x20,0x40,0x20,0x1F}, {0x3F,0x40,0x38,0x40,0x3F},
+	{0x63,0x14,0x08,0x14,0x63}, {0x07,0x08,0x70,0x08,0x07},
+	{0x61,0x51,0x49,0x45,0x43}, {0x00,0x7F,0x41,0x41,0x00},
+	{0x02,0x04,0x08,0x10,0x20}, {0x00,0x41,0x41,0x7F,0x00},
+	{0x04,0x02,0x01,0x02,0x04}, {0x40,0x40,0x40,0x40,0x40},
+	{0x00,0x01,0x02,0x04,0x00}, {0x20,0x54,0x54,0x54,0x78},
+	{0x7F,0x48,0x44,0x44,0x38}, {0x38,0x44,0x44,0x44,0x20},
+	{0x38,0x44,0x44,0x48,0x7F}, {0x38,0x54,0x54,0x54,0x18},
+	{0x08,0x7E,0x09,0x01,0x02}, {0x0C,0x52,0x52,0x52,0x3E},
+	{0x7F,0x08,0x04,0x04,0x78}, {0x00,0x44,0x7D,0x40,0x00},
+	{0x20,0x40,0x44,0x3D,0x00}, {0x7F,0x10,0x28,0x44,0x00},
+	{0x00,0x41,0x7F,0x40,0x00}, {0x7C,0x04,0x18,0x04,0x78},
+	{0x7C,0x08,0x04,0x04,0x78}, {0x38,0x44,0x44,0x44,0x38},
+	{0x7C,0x14,0x14,0x14,0x08}, {0x08,0x14,0x14,0x18,0x7C},
+	{0x7C,0x08,0x04,0x04,0x08}, {0x48,0x54,0x54,0x54,0x20},
+	{0x04,0x3F,0x44,0x40,0x20}, {0x3C,0x40,0x40,0x20,0x7C},
+	{0x1C,0x20,0x40,0x20,0x1C}, {0x3C,0x40,0x30,0x40,0x3C},
+	{0x44,0x28,0x10,0x28,0x44}, {0x0C,0x50,0x50,0x50,0x3C},
+	{0x44,0x64,0x54,0x4C,0x44}, {0x00,0x08,0x36,0x41,0x00},
+	{0x00,0x00,0x7F,0x00,0x00}, {0x00,0x41,0x36,0x08,0x00},
+	{0x08,0x04,0x08,0x10,0x08}
+};
+
+static char usage[] = "\
+Usage: xdu -render file [-options ...] filename ...\n\
+   or  xdu -render file [-options ...] < du.out\n\
+\n\
+Draws the output of du into a PNG file, or an SVG file if\n\
+file ends in .svg, without using an X server\n\
+  options include:\n\
+  -geometry WxH  Size of the image (600x480)\n\
+  -s          Don't display size information\n\
+  +s          Display size information (default)\n\
+  -n          Sort in numerical order (largest first)\n\
+  -rn         Sort in reverse numerical order\n\
+  -a          Sort in alphabetical order\n\
+  -ra         Sort in reverse alphabetical order\n\
+  -c num      Set number of columns to num\n\
+  -t          Use a treemap layout instead of columns\n\
+  -label what Show each box's own size, files, dirs or depth, not its size\n\
+  -rv         Reverse video\n\
+  -stats      Dump profiling stats to standard error on exit\n\
+  -diff old new  Draw what changed from old to new\n\
+  -history dir   Draw what changed over the last days recorded in dir\n\
+  -window days   How many days back -history looks (30)\n\
+  -attach sock   Draw the tree served on the socket sock (xdu -serve)\n\
+  -j num      Read inputs on num threads\n\
+  -maxnodes num  Keep no more than num nodes, collapsing small directories\n\
+  -scan dir ...  Read the directories instead of du output\n\
+  -snapshot file  Reuse and update a saved scan\n\
+  -checkpoint file  Log the scan in file as it goes, and carry on from it\n\
+  -apparent   Show the apparent sizes of scanned files\n\
+  -rate num   Scan at most num files a second\n\
+  -estimate   Draw an estimate of the scan\n\
+";
+
+/*  External Functions  */
+
+/*
+ * Load the input and draw it into the file given with -render.
+ * Returns the exit status.
+ */
+int
+rendermain(argc, argv)
+int argc;
+char **argv;
+{
+	int	i, n, k;
+	char	*cp;
+
+	/* take out the options we know, leaving the rest for load() */
+	n = 1;
+	for (i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-render") == 0 && i+1 < argc) {
+			outname = argv[++i];
+		} else if (strcmp(argv[i], "-geometry") == 0 && i+1 < argc) {
+			if (sscanf(argv[++i], "%dx%d", &width, &height) != 2
+			 || width < 1 || height < 1) {
+				fprintf(stderr, "xdu: bad geometry \"%s\"\n", argv[i]);
+				return	1;
+			}
+		} else if (strcmp(argv[i], "-c") == 0 && i+1 < argc) {
+			ncols = atoi(argv[++i]);
+			if (ncols < 1 || ncols > 1000) {
+				fprintf(stderr, "xdu: bad number of columns\n");
+				return	1;
+			}
+		} else if (strcmp(argv[i], "-s") == 0) {
+			showsize = 0;
+		} else if (strcmp(argv[i], "+s") == 0) {
+			showsize = 1;
+		} else if (strcmp(argv[i], "-n") == 0) {
+			setorder("size");
+		} else if (strcmp(argv[i], "-rn") == 0) {
+			setorder("rsize");
+		} else if (strcmp(argv[i], "-a") == 0) {
+			setorder("alpha");
+		} else if (strcmp(argv[i], "-ra") == 0) {
+			setorder("ralpha");
+		} else if (strcmp(argv[i], "-t") == 0) {
+			setlayout("treemap");
+		} else if (strcmp(argv[i], "+t") == 0) {
+			setlayout("columns");
+		} else if (strcmp(argv[i], "-apparent") == 0) {
+			setmeasure("apparent");
+		} else if (strcmp(argv[i], "-label") == 0 && i+1 < argc) {
+			setlabel(argv[++i]);
+		} else if (strcmp(argv[i], "-rv") == 0) {
+			reverse = 1;
+		} else if (strcmp(argv[i], "-stats") == 0) {
+			statsflag = 1;
+		} else if ((k = loadoption(argv[i])) > 0 && i+k <= argc) {
+			argv[n++] = argv[i];	/* for load() */
+			if (k > 1)
+				argv[n++] = argv[++i];
+		} else if (argv[i][0] == '-' && argv[i][1] != '\0') {
+			fprintf(stderr, usage);
+			return	1;
+		} else {
+			argv[n++] = argv[i];
+		}
+	}
+	argv[n] = NULL;
+	argc = n;
+	if (outname == NULL) {
+		fprintf(stderr, usage);
+		return	1;
+	}
+	if ((cp = strrchr(outname, '.')) != NULL && strcmp(cp, ".svg") == 0)
+		format = FMT_SVG;
+
+	display = &rdisplay;
+	budget = 0;		/* draw it all at once */
+	if (statsflag)
+		atexit(statsdump);
+
+	load(argc, argv);
+
+	if (strcmp(outname, "-") == 0) {
+		outfp = stdout;
+	} else if ((outfp = fopen(outname, "w")) == NULL) {
+		fprintf(stderr, "xdu: can't create \"%s\"\n", outname);
+		return	1;
+	}
+	rrepaint();
+	if (format == FMT_PNG)
+		pngwrite();
+	else
+		fprintf(outfp, "</svg>\n");
+	if (fflush(outfp) == EOF || ferror(outfp)) {
+		fprintf(stderr, "xdu: error writing \"%s\"\n", outname);
+		return	1;
+	}
+	if (outfp != stdout)
+		fclose(outfp);
+
+	return	0;
+}
+
+/*  Display Routines  */
+
+/*
+ * Start a new picture and draw everything into it
+ */
+static int
+rrepaint()
+{
+	if (format == FMT_PNG) {
+		rowbytes = (width + 7) / 8;
+		if (bits == NULL)
+			bits = (unsigned char *)malloc(rowbytes * height);
+		if (bits == NULL) {
+			fprintf(stderr, "xdu: out of memory\n");
+			exit(1);
+		}
+		memset(bits, 0, rowbytes * height);
+	} else {
+		fprintf(outfp, "<?xml version=\"1.0\"?>\n");
+		fprintf(outfp, "<svg xmlns=\"http://www.w3.org/2000/svg\" ");
+		fprintf(outfp, "width=\"%d\" height=\"%d\" ", width, height);
+		fprintf(outfp, "font-family=\"monospace\" font-size=\"%d\">\n",
+			SVG_FONTSIZE);
+		fprintf(outfp, "<rect width=\"100%%\" height=\"100%%\" fill=\"%s\"/>\n",
+			reverse ? "black" : "white");
+		fprintf(outfp, "<g fill=\"none\" stroke=\"%s\">\n",
+			reverse ? "white" : "black");
+	}
+
+	if (repaint(width, height))
+		while (drawmore())
+			;
+
+	if (format == FMT_SVG)
+		fprintf(outfp, "</g>\n");
+}
+
+/*
+ * Height of a line of label text
+ */
+static int
+rtextheight()
+{
+	if (format == FMT_PNG)
+		return	FONT_ASCENT + FONT_DESCENT;
+	return	SVG_ASCENT + SVG_DESCENT;
+}
+
+/*
+ * Draw a box with its label, placed the same way xwin.c does
+ */
+static int
+rdrawrect(name, size, x, y, width, height)
+char *name;
+char *size;	/* as it should be shown */
+int x, y, width, height;
+{
+	char	label[1024];
+	int	textwidth, ascent, descent;
+	int	textx, texty;
+
+	if (format == FMT_PNG) {
+		/* as XDrawRectangle(), the outline covers width+1 pixels */
+		pngline(x, y, x+width, y);
+		pngline(x, y+height, x+width, y+height);
+		pngline(x, y, x, y+height);
+		pngline(x+width, y, x+width, y+height);
+	} else {
+		fprintf(outfp, "<rect x=\"%d\" y=\"%d\" width=\"%d\" height=\"%d\"/>\n",
+			x, y, width, height);
+	}
+
+	if (showsize) {
+		sprintf(label,"%.900s (%s)", name, size);
+		name = label;
+	}
+	if (format == FMT_PNG) {
+		textwidth = strlen(name) * FONT_ADVANCE;
+		ascent = FONT_ASCENT;
+		descent = FONT_DESCENT;
+	} else {
+		textwidth = strlen(name) * SVG_CHARWIDTH + 0.5;
+		ascent = SVG_ASCENT;
+		descent = SVG_DESCENT;
+	}
+	if (height < (ascent + descent + 2))
+		return;
+
+	/* print label */
+	textx = x + 4;
+	if (layout == LAYOUT_TREEMAP) {
+		/* along the top, children fill the rest of the box */
+		if (textwidth + 6 > width)
+			return;
+		texty = y + ascent + 2;
+	} else {
+		texty = y + height/2.0 + (ascent - descent)/2.0 + 1.5;
+	}
+	if (format == FMT_PNG)
+		pngtext(textx, texty, name);
+	else
+		svgtext(textx, texty, name);
+}
+
+/*  PNG Routines  */
+
+#define	INK(x,y)	(bits[(y)*rowbytes + ((x)>>3)] |= 0x80 >> ((x)&7))
+
+/*
+ * Draw a horizontal or vertical line, clipped to the image
+ */
+static void
+pngline(x0, y0, x1, y1)
+int x0, y0, x1, y1;
+{
+	int	i;
+
+	if (y0 == y1) {
+		if (y0 < 0 || y0 >= height)
+			return;
+		if (x0 < 0)
+			x0 = 0;
+		if (x1 >= width)
+			x1 = width-1;
+		for (i = x0; i <= x1; i++)
+			INK(i, y0);
+	} else {
+		if (x0 < 0 || x0 >= width)
+			return;
+		if (y0 < 0)
+			y0 = 0;
+		if (y1 >= height)
+			y1 = height-1;
+		for (i = y0; i <= y1; i++)
+			INK(x0, i);
+	}
+}
+
+/*
+ * Draw a string with its baseline at y, clipped to the image
+ */
+static void
+pngtext(x, y, s)
+int x, y;
+char *s;
+{
+	unsigned char	*glyph;
+	int	c, col, row, px, py;
+
+	for (; *s != '\0'; s++, x += FONT_ADVANCE) {
+		c = *s & 0xff;
+		if (c < ' ' || c > '~')
+			c = '?';
+		glyph = font[c - ' '];
+		for (col = 0; col < FONT_WIDTH; col++) {
+			px = x + col;
+			if (px < 0 || px >= width)
+				continue;
+			for (row = 0; row < 7; row++) {
+				if ((glyph[col] & (1 << row)) == 0)
+					continue;
+				py = y - FONT_ASCENT + row;
+				if (py >= 0 && py < height)
+					INK(px, py);
+			}
+		}
+	}
+}
+
+static unsigned long crctab[256];
+
+/*
+ * write a 32 bit number, most significant byte first
+ */
+static void
+put32(n, fp)
+unsigned long n;
+FILE *fp;
+{
+	putc((n >> 24) & 0xff, fp);
+	putc((n >> 16) & 0xff, fp);
+	putc((n >> 8) & 0xff, fp);
+	putc(n & 0xff, fp);
+}
+
+/*
+ * continue a PNG (ISO 3309) CRC over the given bytes
+ */
+static unsigned long
+crc(c, buf, len)
+unsigned long c;
+unsigned char *buf;
+long len;
+{
+	unsigned long	k;
+	int	i, j;
+
+	if (crctab[1] == 0) {
+		for (i = 0; i < 256; i++) {
+			k = i;
+			for (j = 0; j < 8; j++)
+				k = (k & 1) ? 0xedb88320UL ^ (k >> 1) : k >> 1;
+			crctab[i] = k;
+		}
+	}
+	while (len-- > 0)
+		c = crctab[(c ^ *buf++) & 0xff] ^ (c >> 8);
+	return	c;
+}
+
+/*
+ * write a PNG chunk
+ */
+static void
+chunk(type, data, len)
+char *type;
+unsigned char *data;
+long len;
+{
+	unsigned long	c;
+
+	put32((unsigned long)len, outfp);
+	fwrite(type, 1, 4, outfp);
+	fwrite((char *)data, 1, len, outfp);
+	c = crc(0xffffffffUL, (unsigned char *)type, 4L);
+	c = crc(c, data, len);
+	put32(c ^ 0xffffffffUL, outfp);
+}
+
+/*
+ * Write the image as a two color PNG.  The image data is a zlib stream
+ * made of stored blocks, each holding as many whole rows (with their
+ * filter byte) as fit in the 65535 byte limit on a stored block.
+ */
+static void
+pngwrite()
+{
+	static	unsigned char sig[8] = { 137, 'P', 'N', 'G', '\r', '\n', 26, '\n' };
+	unsigned char	hdr[13], pal[6];
+	unsigned char	*buf, *bp;
+	unsigned long	s1, s2;
+	long	len, blocklen;
+	int	rows, perblock, y, y2, i;
+
+	fwrite((char *)sig, 1, 8, outfp);
+
+	/* header: width, height, bit depth 1, palette, no interlace */
+	for (i = 0; i < 4; i++) {
+		hdr[i] = (width >> (24 - 8*i)) & 0xff;
+		hdr[4+i] = (height >> (24 - 8*i)) & 0xff;
+	}
+	hdr[8] = 1;
+	hdr[9] = 3;
+	hdr[10] = hdr[11] = hdr[12] = 0;
+	chunk("IHDR", hdr, 13L);
+
+	/* index 0 is the background, 1 is ink */
+	for (i = 0; i < 3; i++) {
+		pal[i] = reverse ? 0 : 255;
+		pal[3+i] = reverse ? 255 : 0;
+	}
+	chunk("PLTE", pal, 6L);
+
+	perblock = 65535 / (rowbytes + 1);
+	len = 2 + (long)height * (rowbytes + 1)
+		+ 5 * ((height + perblock - 1) / perblock) + 4;
+	if ((buf = (unsigned char *)malloc(len)) == NULL) {
+		fprintf(stderr, "xdu: out of memory\n");
+		exit(1);
+	}
+	bp = buf;
+	*bp++ = 0x78;		/* deflate, 32K window */
+	*bp++ = 0x01;		/* no preset dictionary, fastest */
+	s1 = 1;
+	s2 = 0;
+	for (y = 0; y < height; y += rows) {
+		rows = (height - y < perblock) ? height - y : perblock;
+		blocklen = (long)rows * (rowbytes + 1);
+		*bp++ = (y + rows >= height);	/* final block? */
+		*bp++ = blocklen & 0xff;
+		*bp++ = (blocklen >> 8) & 0xff;
+		*bp++ = ~blocklen & 0xff;
+		*bp++ = (~blocklen >> 8) & 0xff;
+		for (i = 0; i < rows; i++) {
+			*bp++ = 0;		/* no filter */
+			memcpy(bp, bits + (long)(y+i) * rowbytes, rowbytes);
+			bp += rowbytes;
+		}
+		/* Adler-32 of the uncompressed data, which can go
+		   5552 bytes before the sums need reducing */
+		for (bp -= blocklen; blocklen > 0; blocklen -= i) {
+			i = (blocklen < 5552) ? blocklen : 5552;
+			for (y2 = 0; y2 < i; y2++) {
+				s1 += *bp++;
+				s2 += s1;
+			}
+			s1 %= 65521;
+			s2 %= 65521;
+		}
+	}
+	*bp++ = (s2 >> 8) & 0xff;
+	*bp++ = s2 & 0xff;
+	*bp++ = (s1 >> 8) & 0xff;
+	*bp++ = s1 & 0xff;
+	chunk("IDAT", buf, (long)(bp - buf));
+	chunk("IEND", (unsigned char *)0, 0L);
+	free((char *)buf);
+}
+
+/*  SVG Routines  */
+
+/*
+ * Draw a string with its baseline at y.  Bytes that aren't UTF-8 are
+ * taken to be Latin-1.
+ */
+static void
+svgtext(x, y, s)
+int x, y;
+char *s;
+{
+	int	n;
+
+	fprintf(outfp, "<text x=\"%d\" y=\"%d\" fill=\"%s\" stroke=\"none\">",
+		x, y, reverse ? "white" : "black");
+	for (; *s != '\0'; s++) {
+		switch (*s) {
+		case '<':
+			fputs("&lt;", outfp);
+			break;
+		case '>':
+			fputs("&gt;", outfp);
+			break;
+		case '&':
+			fputs("&amp;", outfp);
+			break;
+		default:
+			/* XML can't have control characters, even as &#x1; */
+			if ((*s & 0xff) < ' ')
+				putc('?', outfp);
+			else if ((n = utf8len(s)) > 0) {
+				fwrite(s, 1, n, outfp);
+				s += n - 1;
+			} else
+				fprintf(outfp, "&#x%02x;", *s & 0xff);
+		}
+	}
+	fprintf(outfp, "</text>\n");
+}
@@ -0,0 +1,1260 @@
+/*
+ * XDU - Scanning directories ourselves.
+ *
+ * Instead of reading the output of du, xdu can walk a directory tree
+ * itself (-scan).  The tree comes out the same as du -k would give,
+ * sizes in kilobytes allocated, but each directory's node remembers
+ * how much of that is its own, so that when one directory changes it
+ * can be read again by itself and just the difference passed up.
+ * The apparent size of the files (as du --apparent-size gives) is kept
+ * too, so either one can be shown without scanning again.
+ *
+ * Directories are read on a pool of threads sharing a stack of the
+ * ones still to be read.  The thread that reads a directory makes the
+ * nodes for its subdirectories and puts them on the stack, so nobody
+ * else ever touches that directory's children.  Sizes are added up
+ * once every directory has been read.  How fast the directories are
+ * read, and on how many threads at once, is up to rate.c.
+ *
+ * A file with several hard links is counted once, in the first
+ * directory to claim it in a set of (device, inode) pairs.  Which
+ * directory that is depends on which thread gets there first, as with
+ * du it depends on the order the directories are read in.  The set is
+ * split into shards, each with its own lock, so the threads seldom
+ * wait on each other, and only files with more than one link go in it.
+ *
+ * The scanned tree can be saved in a snapshot file (-snapshot).  When
+ * the same directories are scanned again, a directory whose inode,
+ * mtime and ctime haven't changed since has the same entries as it did
+ * then, so it isn't read again: the files' sizes are taken from the
+ * snapshot and only its subdirectories are looked at.  A rescan then
+ * costs a stat of each directory, plus reading the ones that changed.
+ * A scan can also be checkpointed as it goes (-checkpoint), so that
+ * if it is stopped it can carry on where it left off (checkpoint.c).
+ *
+ * Copyright (c)	Phillip C. Dykstra	1991, 1993, 1994
+ * The X Consortium, and any party obtaining a copy of these files from
+ * the X Consortium, directly or indirectly, is granted, free of charge, a
+ * full and unrestricted irrevocable, world-wide, paid up, royalty-free,
+ * nonexclusive right and license to deal in this software and
+ * documentation files (the "Software"), including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons who receive
+ * copies from any such party to do so.  This license includes without
+ * limitation a license to do the foregoing actions under any patents of
+ * the party supplying this software to the X Consortium.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "xdu.h"
+#include "stats.h"
+
+#define	SNAPMAGIC	"xdu-snapshot"
+#define	SNAPVERSION	4
+
+#define	NSHARDS		64	/* separately locked parts of the link set */
+
+/* kilobytes allocated to a file, as du -k counts them */
+#define	KBYTES(st)	(((long)(st).st_blocks + 1) / 2)
+
+/* kilobytes of a directory's own, in the measure being shown */
+#define	OWNSIZE(dp)	(measure == MEASURE_APPARENT ? \
+			((dp)->bytes + 1023) / 1024 : (dp)->own)
+
+/* hash of a file, picking its shard and then its bucket */
+#define	LINKHASH(dev,ino)	((unsigned long)(ino) * 2654435761UL \
+				^ (unsigned long)(dev))
+
+/* EXPORTS: routines that this module exports outside */
+extern void scanall();
+extern struct node *scantree();
+extern struct node *newdir();
+extern long sizetree();
+extern void rescandir();
+extern void releasetree();
+extern void addlink();
+extern void loadsnap();
+extern int measuretree();
+extern char *nodepath();
+int measure = MEASURE_ALLOCATED;	/* sizes shown for scanned trees */
+
+/* IMPORTS: routines that this module uses from xdu.c */
+extern void freetree();
+
+/* internal routines */
+static void initshards();
+static int claimlink();
+static void droplink();
+static void countfile();
+static void readone();
+static void pushjob();
+static void pushjobs();
+static void pushunread();
+static void claimtree();
+static void *worker();
+static void runjobs();
+static int unchanged();
+static int subcmp();
+static int nodecmp();
+static struct node *readsnap();
+static void writesnap();
+static void putsnap();
+
+static long snaptime;	/* when the snapshot being reused was started */
+
+/*
+ * The set of files with more than one link, and the
+ * directory each one was counted in
+ */
+struct link {
+	unsigned long dev;
+	unsigned long ino;
+	struct	node *owner;
+	struct	link *next;	/* in the same bucket */
+};
+static struct shard {
+	pthread_mutex_t lock;
+	struct	link **buckets;
+	int	nbuckets;
+	int	nlinks;
+} shards[NSHARDS];
+static pthread_once_t shardsonce = PTHREAD_ONCE_INIT;
+
+/*
+ * A directory waiting to be read, with the same directory
+ * in the snapshot, if there is one
+ */
+struct job {
+	struct	node *np;
+	struct	node *oldnp;
+};
+static struct job *jobs = NULL;		/* shared by all of the threads */
+static int njobs = 0;
+static int maxjobs = 0;
+static int busy;			/* threads reading a directory */
+static pthread_mutex_t joblock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t jobwait = PTHREAD_COND_INITIALIZER;
+
+/*
+ * What one scanning thread keeps to itself
+ */
+struct worker {
+	struct	input counts;	/* node numbers, for makenode() */
+	long	dirs;		/* counts, added to the stats after */
+	long	files;
+	long	reused;
+	long	links;
+	struct	job *jobs;	/* found, not yet shared */
+	int	njobs;
+	int	maxjobs;
+	struct	checkbuf *check;	/* what it read, for the checkpoint */
+};
+
+/*
+ * A subdirectory seen while reading a directory again
+ */
+struct sub {
+	char	*name;
+	int	found;		/* already in the tree */
+};
+
+/*
+ * Make a node for a directory that lstat() said st about.  wp is the
+ * thread making it, or NULL for one that isn't a scanning thread.
+ */
+struct node *
+newdir(wp, name, st)
+struct worker *wp;
+char *name;
+struct stat *st;
+{
+	struct	node	*np;
+
+	np = makenode(name, 0L, wp ? &wp->counts : (struct input *)NULL);
+	np->dir = (struct dir *)calloc(1, sizeof(struct dir));
+	np->dir->own = KBYTES(*st);
+	np->dir->bytes = st->st_size;
+	np->dir->ino = st->st_ino;
+	np->dir->mtime = st->st_mtime;
+	np->dir->ctime = st->st_ctime;
+	np->dir->wd = -1;
+	np->dir->checkid = checkid(wp ? wp->check : (struct checkbuf *)NULL);
+
+	return	np;
+}
+
+/*
+ * Note in a directory that it counted a file with more than one link
+ */
+void
+addlink(dp, dev, ino, own, bytes, ext, uid)
+struct dir *dp;
+unsigned long dev, ino;
+long own, bytes;
+unsigned int ext, uid;
+{
+	/* grown each time the count reaches a power of two */
+	if ((dp->nlinks & (dp->nlinks - 1)) == 0)
+		dp->links = (struct dirlink *)realloc((char *)dp->links,
+			(dp->nlinks ? 2 * dp->nlinks : 1) * sizeof(struct dirlink));
+	dp->links[dp->nlinks].dev = dev;
+	dp->links[dp->nlinks].ino = ino;
+	dp->links[dp->nlinks].own = own;
+	dp->links[dp->nlinks].bytes = bytes;
+	dp->links[dp->nlinks].ext = ext;
+	dp->links[dp->nlinks].uid = uid;
+	dp->nlinks++;
+}
+
+/*
+ * Set up the link set, the first time it is used
+ */
+static void
+initshards()
+{
+	int	i;
+
+	for (i = 0; i < NSHARDS; i++) {
+		pthread_mutex_init(&shards[i].lock, NULL);
+		shards[i].nbuckets = 64;
+		shards[i].buckets = (struct link **)calloc(
+			shards[i].nbuckets, sizeof(struct link *));
+	}
+}
+
+/*
+ * Claim a file with more than one link for the directory owner.
+ * Returns non-zero if it is to be counted there, because nobody
+ * (owner included, through another of its links) had it yet.
+ */
+static int
+claimlink(dev, ino, owner)
+unsigned long dev, ino;
+struct node *owner;
+{
+	struct	shard	*sp;
+	struct	link	*lp, *next, **buckets;
+	unsigned long	h;
+	int	i, n, ok;
+
+	pthread_once(&shardsonce, initshards);
+	h = LINKHASH(dev, ino);
+	sp = &shards[h % NSHARDS];
+
+	pthread_mutex_lock(&sp->lock);
+	for (lp = sp->buckets[h / NSHARDS % sp->nbuckets]; lp != NULL;
+	    lp = lp->next) {
+		if (lp->ino == ino && lp->dev == dev)
+			break;
+	}
+	if (lp != NULL) {
+		ok = 0;
+	} else {
+		if (sp->nlinks >= 2 * sp->nbuckets) {
+			/* getting crowded: twice the buckets */
+			n = 2 * sp->nbuckets;
+			buckets = (struct link **)calloc(n, sizeof(struct link *));
+			for (i = 0; i < sp->nbuckets; i++) {
+				for (lp = sp->buckets[i]; lp != NULL; lp = next) {
+					next = lp->next;
+					h = LINKHASH(lp->dev, lp->ino) / NSHARDS % n;
+					lp->next = buckets[h];
+					buckets[h] = lp;
+				}
+			}
+			free((char *)sp->buckets);
+			sp->buckets = buckets;
+			sp->nbuckets = n;
+		}
+		h = LINKHASH(dev, ino) / NSHARDS % sp->nbuckets;
+		lp = (struct link *)malloc(sizeof(struct link));
+		lp->dev = dev;
+		lp->ino = ino;
+		lp->owner = owner;
+		lp->next = sp->buckets[h];
+		sp->buckets[h] = lp;
+		sp->nlinks++;
+		ok = 1;
+	}
+	pthread_mutex_unlock(&sp->lock);
+
+	return	ok;
+}
+
+/*
+ * Let go of owner's claim on a file, so that whichever
+ * directory sees it next gets to count it
+ */
+static void
+droplink(dev, ino, owner)
+unsigned long dev, ino;
+struct node *owner;
+{
+	struct	shard	*sp;
+	struct	link	*lp, **lpp;
+	unsigned long	h;
+
+	pthread_once(&shardsonce, initshards);
+	h = LINKHASH(dev, ino);
+	sp = &shards[h % NSHARDS];
+
+	pthread_mutex_lock(&sp->lock);
+	for (lpp = &sp->buckets[h / NSHARDS % sp->nbuckets]; (lp = *lpp) != NULL;
+	    lpp = &lp->next) {
+		if (lp->ino == ino && lp->dev == dev) {
+			if (lp->owner == owner) {
+				*lpp = lp->next;
+				free((char *)lp);
+				sp->nlinks--;
+			}
+			break;
+		}
+	}
+	pthread_mutex_unlock(&sp->lock);
+}
+
+/*
+ * Let go of the files claimed by a directory and everything
+ * below it, which is about to be taken out of the tree
+ */
+void
+releasetree(np)
+struct node *np;
+{
+	struct	node	*cp;
+	int	i;
+
+	if (np->dir == NULL)
+		return;
+	for (i = 0; i < np->dir->nlinks; i++)
+		droplink(np->dir->links[i].dev, np->dir->links[i].ino, np);
+	np->dir->nlinks = 0;
+
+	for (cp = np->child; cp != NODE_NULL; cp = cp->peer)
+		releasetree(cp);
+}
+
+/*
+ * Claim the files counted in a tree that was read before, in the
+ * directories that counted them, as if they had just been read
+ */
+static void
+claimtree(np)
+struct node *np;
+{
+	struct	node	*cp;
+	int	i;
+
+	for (i = 0; i < np->dir->nlinks; i++)
+		claimlink(np->dir->links[i].dev, np->dir->links[i].ino, np);
+	for (cp = np->child; cp != NODE_NULL; cp = cp->peer)
+		claimtree(cp);
+}
+
+/*
+ * Count a file (anything but a directory) called name, that lstat()
+ * said st about, into the directory np, unless it was counted elsewhere
+ */
+static void
+countfile(wp, np, name, st)
+struct worker *wp;
+struct node *np;
+char *name;
+struct stat *st;
+{
+	unsigned int	ext;
+
+	ext = extkey(name);
+	if (st->st_nlink > 1) {
+		if (!claimlink((unsigned long)st->st_dev,
+		    (unsigned long)st->st_ino, np)) {
+			wp->links++;
+			return;
+		}
+		addlink(np->dir, (unsigned long)st->st_dev,
+			(unsigned long)st->st_ino, KBYTES(*st), (long)st->st_size,
+			ext, (unsigned int)st->st_uid);
+	}
+	np->dir->own += KBYTES(*st);
+	np->dir->bytes += st->st_size;
+	np->dir->files++;
+	addshare(np->dir, BY_EXT, ext, KBYTES(*st), (long)st->st_size);
+	addshare(np->dir, BY_OWNER, (unsigned int)st->st_uid, KBYTES(*st),
+		(long)st->st_size);
+	wp->files++;
+}
+
+/*
+ * Whether a directory still has the entries it had when it was read
+ * for the snapshot.  Anything changed in the second that scan started
+ * in might not show in the times, so isn't trusted.
+ */
+static int
+unchanged(olddp, dp)
+struct dir *olddp;	/* from the snapshot */
+struct dir *dp;		/* as it is now */
+{
+	return	dp->ino == olddp->ino
+	     && dp->mtime == olddp->mtime
+	     && dp->ctime == olddp->ctime
+	     && dp->mtime < snaptime
+	     && dp->ctime < snaptime;
+}
+
+static int
+nodecmp(p1, p2)
+struct node **p1, **p2;
+{
+	return	namecmp((*p1)->nameid, (*p2)->nameid);
+}
+
+/*
+ * Read the one directory np, already made by newdir().  Its files are
+ * counted, and its subdirectories get nodes and are put on the list
+ * of ones to read.  oldnp, if not NODE_NULL, is the same directory in
+ * a snapshot.
+ */
+static void
+readone(wp, np, oldnp)
+struct worker *wp;
+struct node *np;
+struct node *oldnp;
+{
+	char	path[MAXPATH];
+	struct	stat	st;
+	struct	dirent	*dp;
+	struct	node	*cp, *op, **npp, **npp2, **olds, key, *keyp;
+	struct	dirlink	*lp;
+	struct	share	*sp;
+	DIR	*dirp;
+	double	start;
+	long	ops;
+	int	len, n, nolds, i, by;
+
+	wp->dirs++;
+	start = stattime();
+	ops = 0;
+	nodepath(np, path);
+	len = strlen(path);
+	npp = &np->child;
+
+	if (oldnp != NODE_NULL && unchanged(oldnp->dir, np->dir)) {
+		/* same entries as before, so only the subdirectories can differ */
+		wp->reused++;
+		np->dir->own = oldnp->dir->own;
+		np->dir->bytes = oldnp->dir->bytes;
+		np->dir->files = oldnp->dir->files;
+		for (by = 0; by < NBY; by++) {
+			sp = oldnp->dir->shares[by];
+			for (i = 0; i < oldnp->dir->nshares[by]; i++, sp++)
+				addshare(np->dir, by, sp->key, sp->own, sp->bytes);
+		}
+		for (i = 0; i < oldnp->dir->nlinks; i++) {
+			lp = &oldnp->dir->links[i];
+			if (claimlink(lp->dev, lp->ino, np)) {
+				addlink(np->dir, lp->dev, lp->ino, lp->own, lp->bytes,
+					lp->ext, lp->uid);
+			} else {
+				/* a directory that changed got to it first */
+				np->dir->own -= lp->own;
+				np->dir->bytes -= lp->bytes;
+				np->dir->files--;
+				addshare(np->dir, BY_EXT, lp->ext, -lp->own, -lp->bytes);
+				addshare(np->dir, BY_OWNER, lp->uid, -lp->own,
+					-lp->bytes);
+				wp->links++;
+			}
+		}
+		for (op = oldnp->child; op != NODE_NULL; op = op->peer) {
+			n = strlen(NAME(op));
+			if (len + 1 + n >= MAXPATH)
+				continue;
+			path[len] = '/';
+			strcpy(&path[len+1], NAME(op));
+			ops++;
+			if (lstat(path, &st) < 0 || !S_ISDIR(st.st_mode))
+				continue;
+			cp = newdir(wp, NAME(op), &st);
+			cp->parent = np;
+			*npp = cp;
+			npp = &cp->peer;
+			pushjob(wp, cp, op);
+		}
+		ratepace(ops, stattime() - start, 1);
+		return;
+	}
+
+	ops++;
+	if ((dirp = opendir(path)) == NULL) {
+		fprintf(stderr, "xdu: can't read \"%s\"\n", path);
+		return;
+	}
+
+	/* the old subdirectories in name order, to look the new ones up in */
+	nolds = 0;
+	olds = NULL;
+	if (oldnp != NODE_NULL && oldnp->child != NODE_NULL) {
+		for (op = oldnp->child; op != NODE_NULL; op = op->peer)
+			nolds++;
+		olds = (struct node **)malloc(nolds * sizeof(struct node *));
+		nolds = 0;
+		for (op = oldnp->child; op != NODE_NULL; op = op->peer)
+			olds[nolds++] = op;
+		qsort((char *)olds, nolds, sizeof(struct node *), nodecmp);
+	}
+
+	while ((dp = readdir(dirp)) != NULL) {
+		if (strcmp(dp->d_name, ".") == 0 || strcmp(dp->d_name, "..") == 0)
+			continue;
+		n = strlen(dp->d_name);
+		if (len + 1 + n >= MAXPATH)
+			continue;
+		path[len] = '/';
+		strcpy(&path[len+1], dp->d_name);
+		ops++;
+		if (lstat(path, &st) < 0)
+			continue;
+		if (S_ISDIR(st.st_mode)) {
+			op = NODE_NULL;
+			if (nolds > 0) {
+				key.nameid = intern(dp->d_name);
+				keyp = &key;
+				npp2 = (struct node **)bsearch((char *)&keyp,
+					(char *)olds, nolds, sizeof(struct node *),
+					nodecmp);
+				if (npp2 != NULL)
+					op = *npp2;
+			}
+			cp = newdir(wp, dp->d_name, &st);
+			cp->parent = np;
+			*npp = cp;
+			npp = &cp->peer;
+			pushjob(wp, cp, op);
+		} else {
+			countfile(wp, np, dp->d_name, &st);
+		}
+	}
+	closedir(dirp);
+	if (olds != NULL)
+		free((char *)olds);
+	ratepace(ops, stattime() - start, 1);
+}
+
+/*
+ * Put a directory on the thread's own list of ones to read
+ */
+static void
+pushjob(wp, np, oldnp)
+struct worker *wp;
+struct node *np;
+struct node *oldnp;
+{
+	if (wp->njobs >= wp->maxjobs) {
+		wp->maxjobs = wp->maxjobs ? 2 * wp->maxjobs : 64;
+		wp->jobs = (struct job *)realloc((char *)wp->jobs,
+			wp->maxjobs * sizeof(struct job));
+	}
+	wp->jobs[wp->njobs].np = np;
+	wp->jobs[wp->njobs].oldnp = oldnp;
+	wp->njobs++;
+}
+
+/*
+ * Put the directories in a tree read back from a checkpoint that
+ * haven't been read yet on the thread's own list
+ */
+static void
+pushunread(wp, np)
+struct worker *wp;
+struct node *np;
+{
+	struct	node	*cp;
+
+	if (np->dir->unread) {
+		np->dir->unread = 0;
+		pushjob(wp, np, NODE_NULL);
+	}
+	for (cp = np->child; cp != NODE_NULL; cp = cp->peer)
+		pushunread(wp, cp);
+}
+
+/*
+ * Move the thread's own list onto the shared stack, taking the lock
+ * once for each directory read rather than for each one found.  They
+ * go on backwards so they come off in the order they were found.
+ */
+static void
+pushjobs(wp)
+struct worker *wp;
+{
+	int	i;
+
+	if (wp->njobs == 0)
+		return;
+	pthread_mutex_lock(&joblock);
+	if (njobs + wp->njobs > maxjobs) {
+		while (njobs + wp->njobs > maxjobs)
+			maxjobs = maxjobs ? 2 * maxjobs : 1024;
+		jobs = (struct job *)realloc((char *)jobs,
+			maxjobs * sizeof(struct job));
+	}
+	for (i = wp->njobs - 1; i >= 0; i--)
+		jobs[njobs++] = wp->jobs[i];
+	wp->njobs = 0;
+	pthread_cond_broadcast(&jobwait);
+	pthread_mutex_unlock(&joblock);
+}
+
+/*
+ * scanning thread: read directories off the stack until it is empty
+ * and no other thread is reading one (and might find more).  No more
+ * than ratethreads() read at once.
+ */
+static void *
+worker(arg)
+void *arg;
+{
+	struct	worker	*wp = (struct worker *)arg;
+	struct	job	j;
+
+	pthread_mutex_lock(&joblock);
+	for (;;) {
+		while ((njobs == 0 && busy > 0)
+		    || (njobs > 0 && busy >= ratethreads()))
+			pthread_cond_wait(&jobwait, &joblock);
+		if (njobs == 0)
+			break;		/* all done */
+		j = jobs[--njobs];
+		busy++;
+		pthread_mutex_unlock(&joblock);
+
+		readone(wp, j.np, j.oldnp);
+		if (wp->check != NULL)
+			checkdir(wp->check, j.np);
+		pushjobs(wp);
+
+		pthread_mutex_lock(&joblock);
+		if (--busy == 0 || njobs > 0)
+			pthread_cond_broadcast(&jobwait);
+	}
+	pthread_mutex_unlock(&joblock);
+
+	return	arg;
+}
+
+/*
+ * Read the directories on the stack, and everything below them,
+ * on nthreads threads (one per cpu if it is 0), then add up what
+ * the threads did into the stats
+ */
+static void
+runjobs()
+{
+	pthread_t	*tids;
+	struct	worker	*workers;
+	int	i, n;
+
+	n = nthreads;
+	if (n <= 0)
+		n = sysconf(_SC_NPROCESSORS_ONLN);
+	if (n < 1)
+		n = 1;
+	workers = (struct worker *)calloc(n, sizeof(struct worker));
+	for (i = 0; i < n; i++)
+		workers[i].check = checkbuf(i, n);
+
+	ratestart(n);
+	busy = 0;
+	if (n == 1) {
+		worker((void *)&workers[0]);
+	} else {
+		tids = (pthread_t *)malloc(n * sizeof(pthread_t));
+		for (i = 0; i < n; i++) {
+			if (pthread_create(&tids[i], NULL, worker,
+			    (void *)&workers[i]) != 0) {
+				fprintf(stderr, "xdu: can't start thread\n");
+				exit(1);
+			}
+		}
+		for (i = 0; i < n; i++)
+			pthread_join(tids[i], NULL);
+		free((char *)tids);
+	}
+
+	for (i = 0; i < n; i++) {
+		stats.nodes += workers[i].counts.nodes;
+		stats.scandirs += workers[i].dirs;
+		stats.scanfiles += workers[i].files;
+		stats.scanreused += workers[i].reused;
+		stats.scanlinks += workers[i].links;
+		if (workers[i].jobs != NULL)
+			free((char *)workers[i].jobs);
+		checkfree(workers[i].check);
+	}
+	if (n > stats.threads)
+		stats.threads = n;
+	free((char *)workers);
+}
+
+/*
+ * Add up the sizes of a scanned tree, in the measure being shown
+ */
+long
+sizetree(np)
+struct node *np;
+{
+	struct	node	*cp;
+
+	np->size = OWNSIZE(np->dir);
+	for (cp = np->child; cp != NODE_NULL; cp = cp->peer)
+		np->size += sizetree(cp);
+	return	np->size;
+}
+
+/*
+ * Add up the sizes of the scanned trees at the top again, after the
+ * measure changed.  Returns how many there were.
+ */
+int
+measuretree()
+{
+	struct	node	*np;
+	int	n;
+
+	n = 0;
+	top.size = 0;
+	for (np = top.child; np != NODE_NULL; np = np->peer) {
+		if (np->dir != NULL) {
+			sizetree(np);
+			n++;
+		}
+		top.size += np->size;
+	}
+	return	n;
+}
+
+/*
+ * Scan the directory tree at path into a new node named for it,
+ * not yet linked into any tree.  oldtop, if not NODE_NULL, holds
+ * the trees from a snapshot, one of which may be this one.  If a
+ * checkpoint has part of the tree, only the rest of it is read.
+ * Returns NODE_NULL if path isn't a directory.
+ */
+struct node *
+scantree(path, oldtop)
+char *path;
+struct node *oldtop;
+{
+	char	buf[MAXPATH];
+	struct	stat	st;
+	struct	worker	w;
+	struct	node	*np, *op;
+	int	len;
+
+	if ((len = strlen(path)) >= MAXPATH) {
+		fprintf(stderr, "xdu: \"%s\" is too long\n", path);
+		return	NODE_NULL;
+	}
+	strcpy(buf, path);
+	while (len > 1 && buf[len-1] == '/')
+		buf[--len] = '\0';
+	if (lstat(buf, &st) < 0 || !S_ISDIR(st.st_mode))
+		return	NODE_NULL;
+
+	op = NODE_NULL;
+	if (oldtop != NODE_NULL) {
+		for (op = oldtop->child; op != NODE_NULL; op = op->peer) {
+			if (strcmp(NAME(op), buf) == 0)
+				break;
+		}
+	}
+
+	bzero((char *)&w, sizeof(w));
+	if ((np = checkresume(buf)) != NODE_NULL) {
+		/* what is left of it; the snapshot isn't used for that */
+		claimtree(np);
+		pushunread(&w, np);
+	} else {
+		np = newdir((struct worker *)NULL, buf, &st);
+		checktop(np);
+		pushjob(&w, np, op);
+	}
+	pushjobs(&w);
+	free((char *)w.jobs);
+	runjobs();
+	sizetree(np);
+
+	return	np;
+}
+
+/*
+ * Scan each of the directories in names[0..n-1] into the top of the
+ * tree.  If snapname is not NULL, the snapshot in it (if any) is used
+ * to skip directories that haven't changed, and a new snapshot is
+ * written there afterwards.  With checkname, the scan is checkpointed
+ * as it goes, and carries on from the checkpoint if there is one.
+ */
+void
+scanall(names, n, snapname)
+char **names;
+int n;
+char *snapname;
+{
+	struct	node	*np, *oldtop;
+	long	start;
+	int	i;
+
+	oldtop = NODE_NULL;
+	if (estimating) {
+		estimateall(names, n);
+		return;
+	}
+	if (snapname != NULL)
+		oldtop = readsnap(snapname);
+
+	if (checkname != NULL)
+		start = checkopen();	/* when the first part started */
+	else
+		start = time((time_t *)0);
+	for (i = 0; i < n; i++) {
+		if ((np = scantree(names[i], oldtop)) == NODE_NULL) {
+			fprintf(stderr, "xdu: can't scan \"%s\"\n", names[i]);
+			exit(1);
+		}
+		insertchild(&top, np, ORD_FIRST);
+	}
+	if (checkname != NULL)
+		checkdone();
+
+	if (oldtop != NODE_NULL)
+		freetree(oldtop);
+	if (snapname != NULL)
+		writesnap(snapname, start);
+}
+
+/*
+ * Number a snapshot's nodes in the order they were read, as
+ * makenode() would have
+ */
+static void
+numbertree(np)
+struct node *np;
+{
+	struct	node *cp;
+
+	np->num = stats.nodes++;
+	for (cp = np->child; cp != NODE_NULL; cp = cp->peer)
+		numbertree(cp);
+}
+
+/*
+ * Use a snapshot as the tree, without scanning anything: to look
+ * at a scan saved before
+ */
+void
+loadsnap(snapname)
+char *snapname;
+{
+	struct	node	*oldtop, *np, *next;
+
+	if ((oldtop = readsnap(snapname)) == NODE_NULL) {
+		fprintf(stderr, "xdu: can't read snapshot \"%s\"\n", snapname);
+		exit(1);
+	}
+	for (np = oldtop->child; np != NODE_NULL; np = next) {
+		next = np->peer;
+		np->peer = NODE_NULL;
+		numbertree(np);
+		sizetree(np);
+		insertchild(&top, np, ORD_FIRST);
+	}
+	free((char *)oldtop);
+}
+
+/*
+ * Put the pathname of a scanned node into buf (MAXPATH long).
+ * The node at the top of the scan is named with the path it was
+ * scanned from.
+ */
+char *
+nodepath(np, buf)
+struct node *np;
+char *buf;
+{
+	if (np->parent == NODE_NULL || np->parent->dir == NULL) {
+		strcpy(buf, NAME(np));
+	} else {
+		nodepath(np->parent, buf);
+		if (strlen(buf) + 1 + strlen(NAME(np)) < MAXPATH) {
+			strcat(buf, "/");
+			strcat(buf, NAME(np));
+		}
+	}
+	return	buf;
+}
+
+static int
+subcmp(s1, s2)
+struct sub *s1, *s2;
+{
+	return	strcmp(s1->name, s2->name);
+}
+
+/*
+ * Read one directory of a scanned tree again, after it changed.  Its
+ * own size is worked out afresh, subdirectories that went away are
+ * taken out, and new ones (or ones that were replaced) are scanned
+ * and put in.  Existing subdirectories aren't looked into: if they
+ * changed, they get read again themselves.  Only the difference goes
+ * up the tree, so this costs the size of the directory, not the tree.
+ */
+void
+rescandir(np)
+struct node *np;
+{
+	char	path[MAXPATH];
+	struct	stat	st;
+	struct	dirent	*dp;
+	struct	sub	*subs, *sp, key;
+	struct	node	*cp, *next;
+	struct	worker	w;
+	DIR	*dirp;
+	double	start;
+	long	oldsize, oldfiles, ops;
+	int	len, n, nsubs, maxsubs, i, moved;
+
+	start = stattime();
+	ops = 1;
+	moved = 0;
+	nodepath(np, path);
+	len = strlen(path);
+	if (lstat(path, &st) < 0 || !S_ISDIR(st.st_mode)
+	 || (dirp = opendir(path)) == NULL)
+		return;		/* it went away: up to our parent */
+
+	/* count it from scratch, letting go of the files it had claimed */
+	oldsize = OWNSIZE(np->dir);
+	oldfiles = np->dir->files;
+	unestimate(np);
+	for (i = 0; i < np->dir->nlinks; i++)
+		droplink(np->dir->links[i].dev, np->dir->links[i].ino, np);
+	np->dir->nlinks = 0;
+	np->dir->own = KBYTES(st);
+	np->dir->bytes = st.st_size;
+	np->dir->files = 0;
+	clearshares(np->dir);
+	bzero((char *)&w, sizeof(w));
+
+	nsubs = 0;
+	maxsubs = 64;
+	subs = (struct sub *)malloc(maxsubs * sizeof(struct sub));
+	while ((dp = readdir(dirp)) != NULL) {
+		if (strcmp(dp->d_name, ".") == 0 || strcmp(dp->d_name, "..") == 0)
+			continue;
+		n = strlen(dp->d_name);
+		if (len + 1 + n >= MAXPATH)
+			continue;
+		path[len] = '/';
+		strcpy(&path[len+1], dp->d_name);
+		ops++;
+		if (lstat(path, &st) < 0)
+			continue;
+		if (S_ISDIR(st.st_mode)) {
+			if (nsubs >= maxsubs) {
+				maxsubs *= 2;
+				subs = (struct sub *)realloc((char *)subs,
+					maxsubs * sizeof(struct sub));
+			}
+			subs[nsubs].name = strdup(dp->d_name);
+			subs[nsubs].found = 0;
+			nsubs++;
+		} else {
+			countfile(&w, np, dp->d_name, &st);
+		}
+	}
+	path[len] = '\0';
+	closedir(dirp);
+	stats.scanfiles += w.files;
+	stats.scanlinks += w.links;
+	/* the caller waits, so as not to hold up the display */
+	ratepace(ops, stattime() - start, 0);
+	qsort((char *)subs, nsubs, sizeof(struct sub), subcmp);
+
+	/* take out the ones that are gone */
+	for (cp = np->child; cp != NODE_NULL; cp = next) {
+		next = cp->peer;
+		key.name = NAME(cp);
+		sp = (struct sub *)bsearch((char *)&key, (char *)subs, nsubs,
+			sizeof(struct sub), subcmp);
+		if (sp != NULL && !cp->dir->gone) {
+			sp->found = 1;
+			continue;
+		}
+		unwatchtree(cp);
+		releasetree(cp);
+		dropestimate(cp);
+		removenode(cp);
+		moved = 1;
+	}
+
+	/* put in the new ones */
+	for (i = 0; i < nsubs; i++) {
+		if (!subs[i].found && len + 1 + strlen(subs[i].name) < MAXPATH) {
+			path[len] = '/';
+			strcpy(&path[len+1], subs[i].name);
+			cp = scantree(path, NODE_NULL);
+			path[len] = '\0';
+			if (cp != NODE_NULL) {
+				/* named for its path, as the top of a scan is */
+				cp->nameid = intern(subs[i].name);
+				insertchild(np, cp, order);
+				resizenode(np, cp->size);
+				watchtree(cp);
+				moved = 1;
+			}
+		}
+		free(subs[i].name);
+	}
+	free((char *)subs);
+
+	resizenode(np, OWNSIZE(np->dir) - oldsize);
+	if (moved) {
+		totalstale = 1;	/* what is below it has to be added up */
+		if (searchbuilt)
+			searchstale = 1;	/* and indexed */
+	} else {
+		/* only its own files changed, so only the counts above do */
+		np->own += OWNSIZE(np->dir) - oldsize;
+		for (cp = np; cp != NODE_NULL; cp = cp->parent)
+			cp->files += np->dir->files - oldfiles;
+		totalgen++;	/* what it holds may differ, if not its size */
+	}
+}
+
+/*
+ * Snapshot Files
+ * A header line, then a line for each scanned directory, parents
+ * before children:
+ *	depth own bytes files inode mtime ctime name
+ * tab separated, depth 0 being a directory that was named to -scan.
+ * Backslashes and newlines in names are written as \\ and \n.
+ * After each directory, a line for each extension and for each owner
+ * of the files in it, with the space they take ("-" for none):
+ *	e own bytes .extension
+ *	u own bytes uid
+ * and one for each file with more than one link that it counted:
+ *	= device inode own bytes uid extension
+ */
+
+/*
+ * write a scanned tree, depth first, to a snapshot
+ */
+static void
+putsnap(fp, np, depth)
+FILE *fp;
+struct node *np;
+int depth;
+{
+	struct	node	*cp;
+	struct	dirlink	*lp;
+	struct	share	*sp;
+	char	*s;
+	int	i;
+
+	fprintf(fp, "%d\t%ld\t%ld\t%ld\t%lu\t%ld\t%ld\t", depth, np->dir->own,
+		np->dir->bytes, np->dir->files, np->dir->ino, np->dir->mtime,
+		np->dir->ctime);
+	for (s = NAME(np); *s != '\0'; s++) {
+		if (*s == '\\')
+			fputs("\\\\", fp);
+		else if (*s == '\n')
+			fputs("\\n", fp);
+		else
+			putc(*s, fp);
+	}
+	putc('\n', fp);
+	sp = np->dir->shares[BY_EXT];
+	for (i = 0; i < np->dir->nshares[BY_EXT]; i++, sp++)
+		fprintf(fp, "e\t%ld\t%ld\t%s\n", sp->own, sp->bytes,
+			sp->key == KEY_NONE ? "-" : namestr(sp->key));
+	sp = np->dir->shares[BY_OWNER];
+	for (i = 0; i < np->dir->nshares[BY_OWNER]; i++, sp++)
+		fprintf(fp, "u\t%ld\t%ld\t%u\n", sp->own, sp->bytes, sp->key);
+	for (i = 0; i < np->dir->nlinks; i++) {
+		lp = &np->dir->links[i];
+		fprintf(fp, "=\t%lu\t%lu\t%ld\t%ld\t%u\t%s\n", lp->dev, lp->ino,
+			lp->own, lp->bytes, lp->uid,
+			lp->ext == KEY_NONE ? "-" : namestr(lp->ext));
+	}
+
+	for (cp = np->child; cp != NODE_NULL; cp = cp->peer)
+		putsnap(fp, cp, depth+1);
+}
+
+/*
+ * Write the scanned trees at the top to a snapshot file.  It goes to
+ * a temporary file first, so a crash never leaves half a snapshot.
+ */
+static void
+writesnap(snapname, start)
+char *snapname;
+long start;
+{
+	char	tmpname[MAXPATH];
+	struct	node	*np;
+	FILE	*fp;
+
+	if (strlen(snapname) + 5 > MAXPATH) {
+		fprintf(stderr, "xdu: \"%s\" is too long\n", snapname);
+		return;
+	}
+	sprintf(tmpname, "%s.new", snapname);
+	if ((fp = fopen(tmpname, "w")) == NULL) {
+		fprintf(stderr, "xdu: can't create \"%s\"\n", tmpname);
+		return;
+	}
+	fprintf(fp, "%s %d %ld\n", SNAPMAGIC, SNAPVERSION, start);
+	for (np = top.child; np != NODE_NULL; np = np->peer) {
+		if (np->dir != NULL)
+			putsnap(fp, np, 0);
+	}
+	if (fflush(fp) != 0 || ferror(fp)) {
+		fprintf(stderr, "xdu: can't write \"%s\"\n", tmpname);
+		fclose(fp);
+		unlink(tmpname);
+		return;
+	}
+	fclose(fp);
+	if (rename(tmpname, snapname) < 0) {
+		fprintf(stderr, "xdu: can't rename \"%s\"\n", tmpname);
+		unlink(tmpname);
+	}
+}
+
+/*
+ * Read a snapshot file into a tree of its own, whose children are the
+ * directories that were named to -scan.  Only the names and the dir
+ * structures are filled in.  Returns NODE_NULL if there is no usable
+ * snapshot, in which case everything is read afresh.
+ */
+static struct node *
+readsnap(snapname)
+char *snapname;
+{
+	char	buf[MAXPATH + 128];
+	char	magic[32];
+	struct	node	*oldtop, *np, **stack, ***tails;
+	char	*s, *d;
+	FILE	*fp;
+	char	ext[32];
+	int	version, depth, maxdepth, off;
+	long	own, bytes, files, mtime, ctime;
+	unsigned long dev, ino;
+	unsigned int uid;
+
+	if ((fp = fopen(snapname, "r")) == NULL)
+		return	NODE_NULL;	/* first time */
+	if (fgets(buf, sizeof(buf), fp) == NULL
+	 || sscanf(buf, "%31s %d %ld", magic, &version, &snaptime) != 3
+	 || strcmp(magic, SNAPMAGIC) != 0 || version != SNAPVERSION) {
+		fprintf(stderr, "xdu: \"%s\" isn't a snapshot, ignoring it\n",
+			snapname);
+		fclose(fp);
+		return	NODE_NULL;
+	}
+
+	oldtop = (struct node *)calloc(1, sizeof(struct node));
+	oldtop->nameid = intern("[snapshot]");
+	/* the last directory read at each depth, and where its next child goes */
+	maxdepth = 64;
+	stack = (struct node **)malloc(maxdepth * sizeof(struct node *));
+	tails = (struct node ***)malloc(maxdepth * sizeof(struct node **));
+	stack[0] = oldtop;	/* parent of depth 0 */
+	tails[0] = &oldtop->child;
+	stack[1] = NODE_NULL;
+
+	np = NODE_NULL;
+	while (fgets(buf, sizeof(buf), fp) != NULL) {
+		if (buf[0] == 'e' || buf[0] == 'u') {
+			/* the files of a kind in the last directory */
+			if (np == NODE_NULL || sscanf(&buf[1], "%ld %ld %31s",
+			    &own, &bytes, ext) != 3)
+				break;
+			if (buf[0] == 'u')
+				addshare(np->dir, BY_OWNER,
+					(unsigned int)strtoul(ext, (char **)NULL, 10),
+					own, bytes);
+			else
+				addshare(np->dir, BY_EXT, strcmp(ext, "-") == 0
+					? KEY_NONE : intern(ext), own, bytes);
+			continue;
+		}
+		if (buf[0] == '=') {
+			/* a file counted in the last directory */
+			if (np == NODE_NULL || sscanf(&buf[1], "%lu %lu %ld %ld %u %31s",
+			    &dev, &ino, &own, &bytes, &uid, ext) != 6)
+				break;
+			addlink(np->dir, dev, ino, own, bytes, strcmp(ext, "-") == 0
+				? KEY_NONE : intern(ext), uid);
+			continue;
+		}
+		if (sscanf(buf, "%d %ld %ld %ld %lu %ld %ld%n", &depth, &own, &bytes,
+		    &files, &ino, &mtime, &ctime, &off) != 7
+		 || depth < 0 || depth >= maxdepth
+		 || stack[depth] == NODE_NULL)
+			break;		/* truncated or corrupt: use what we have */
+
+		/* the name, undoing the escapes */
+		s = d = &buf[off+1];
+		for (; *s != '\0' && *s != '\n'; s++) {
+			if (*s == '\\' && s[1] == 'n') {
+				*d++ = '\n';
+				s++;
+			} else if (*s == '\\' && s[1] == '\\') {
+				*d++ = '\\';
+				s++;
+			} else {
+				*d++ = *s;
+			}
+		}
+		*d = '\0';
+
+		np = (struct node *)calloc(1, sizeof(struct node));
+		np->nameid = intern(&buf[off+1]);
+		np->dir = (struct dir *)calloc(1, sizeof(struct dir));
+		np->dir->own = own;
+		np->dir->bytes = bytes;
+		np->dir->files = files;
+		np->dir->ino = ino;
+		np->dir->mtime = mtime;
+		np->dir->ctime = ctime;
+		np->dir->wd = -1;
+
+		np->parent = stack[depth];
+		*tails[depth] = np;
+		tails[depth] = &np->peer;
+
+		if (depth + 2 >= maxdepth) {
+			maxdepth *= 2;
+			stack = (struct node **)realloc((char *)stack,
+				maxdepth * sizeof(struct node *));
+			tails = (struct node ***)realloc((char *)tails,
+				maxdepth * sizeof(struct node **));
+		}
+		stack[depth+1] = np;
+		tails[depth+1] = &np->child;
+		stack[depth+2] = NODE_NULL;
+	}
+	free((char *)stack);
+	free((char *)tails);
+	fclose(fp);
+
+	return	oldtop;
+}
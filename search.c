@@ -0,0 +1,343 @@
+/*
+ * XDU - Finding nodes by name.
+ *
+ * Every node's name is cut into trigrams (three letters in a row,
+ * ignoring case), and each trigram hashed to a list of the nodes
+ * that have it.  A name that contains the text asked for has all of
+ * the text's trigrams, so only the nodes on the shortest of their
+ * lists can match, and only those on all of them need be looked at.
+ * Hashing lets some other nodes through, so each is checked against
+ * the name itself before it counts.  Text of less than three letters
+ * has no trigrams: every name is looked at then.
+ *
+ * The index is built a slice at a time, between other work, by
+ * searchmore().  A node made or taken away marks it stale, and it is
+ * built over.  Until it is up to date, searchfind() looks through the
+ * tree itself, which gets the same answer, only slower.
+ *
+ * Copyright (c)	Phillip C. Dykstra	1991, 1993, 1994
+ * The X Consortium, and any party obtaining a copy of these files from
+ * the X Consortium, directly or indirectly, is granted, free of charge, a
+ * full and unrestricted irrevocable, world-wide, paid up, royalty-free,
+ * nonexclusive right and license to deal in this software and
+ * documentation files (the "Software"), including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons who receive
+ * copies from any such party to do so.  This license includes without
+ * limitation a license to do the foregoing actions under any patents of
+ * the party supplying this software to the X Consortium.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "xdu.h"
+#include "stats.h"
+
+#define	TRIBITS		16	/* log2 of the number of trigram lists */
+#define	NTRI		(1 << TRIBITS)
+#define	TRIHASH(a,b,c)	((((a) * 0x9e3779b1UL) ^ ((b) * 0x85ebca6bUL) \
+			^ ((c) * 0xc2b2ae35UL)) >> (32 - TRIBITS) & (NTRI - 1))
+#define	CHUNK		1024	/* nodes indexed between looks at the clock */
+
+/* EXPORTS: routines that this module exports outside */
+extern int searchmore();
+extern int searchfind();
+extern char *searchpath();
+int searchbuilt = 0;		/* there is an index, or some of one */
+int searchstale = 0;		/* the tree changed since it was indexed */
+
+/* internal routines */
+static void collect();
+static void indexnode();
+static void findtree();
+static void found();
+static int matches();
+
+/*
+ * nodes with one trigram, by their place in nodes[], lowest first
+ */
+struct postings {
+	int	*ids;
+	long	n;
+	long	max;
+};
+
+static struct postings *lists;	/* NTRI of them */
+static struct node **nodes;	/* everything in the tree */
+static long nnodes, maxnodes;
+static long nindexed;		/* of those, how many are in the lists */
+static int indexed;		/* the lists are complete */
+static int building;		/* nodes[] is filled in, lists coming */
+
+/* being found */
+static char *want;		/* the text, in lower case */
+static struct node **best;	/* biggest matches so far */
+static int nbest, maxbest;
+static long nmatched;
+
+/*
+ * Add one node, and everything below it, to nodes[]
+ */
+static void
+collect(np)
+struct node *np;
+{
+	struct	node *cp;
+
+	if (nnodes >= maxnodes) {
+		maxnodes = maxnodes ? maxnodes * 2 : 4096;
+		nodes = (struct node **)realloc((char *)nodes,
+			maxnodes * sizeof(struct node *));
+		if (nodes == NULL) {
+			fprintf(stderr, "xdu: out of memory\n");
+			exit(1);
+		}
+	}
+	nodes[nnodes++] = np;
+	for (cp = np->child; cp != NODE_NULL; cp = cp->peer)
+		collect(cp);
+}
+
+/*
+ * Put node number id on the list for each trigram in its name
+ */
+static void
+indexnode(id)
+long id;
+{
+	struct	postings *pp;
+	unsigned char	*cp;
+
+	cp = (unsigned char *)NAME(nodes[id]);
+	if (cp == NULL)
+		return;
+	for (; cp[0] != '\0' && cp[1] != '\0' && cp[2] != '\0'; cp++) {
+		pp = &lists[TRIHASH(tolower(cp[0]), tolower(cp[1]),
+			tolower(cp[2]))];
+		if (pp->n > 0 && pp->ids[pp->n-1] == id)
+			continue;	/* the name has it twice */
+		if (pp->n >= pp->max) {
+			pp->max = pp->max ? pp->max * 2 : 8;
+			pp->ids = (int *)realloc((char *)pp->ids,
+				pp->max * sizeof(int));
+			if (pp->ids == NULL) {
+				fprintf(stderr, "xdu: out of memory\n");
+				exit(1);
+			}
+		}
+		pp->ids[pp->n++] = id;
+	}
+}
+
+/*
+ * Build some more of the index, for about msec milliseconds (0 to
+ * finish it).  Returns 1 if there is more to do.
+ */
+int
+searchmore(msec)
+int msec;
+{
+	double	t, stop;
+	long	i;
+
+	t = stattime();
+	stop = t + msec / 1000.0;
+	if (searchstale) {
+		/* start over */
+		searchstale = 0;
+		indexed = building = 0;
+		if (lists != NULL)
+			for (i = 0; i < NTRI; i++)
+				lists[i].n = 0;
+	}
+	if (indexed)
+		return	0;
+	if (!building) {
+		if (lists == NULL
+		 && (lists = (struct postings *)calloc(NTRI,
+		    sizeof(struct postings))) == NULL) {
+			fprintf(stderr, "xdu: out of memory\n");
+			exit(1);
+		}
+		nnodes = nindexed = 0;
+		collect(&top);
+		building = searchbuilt = 1;
+	}
+	while (nindexed < nnodes) {
+		for (i = 0; i < CHUNK && nindexed < nnodes; i++)
+			indexnode(nindexed++);
+		if (msec > 0 && stattime() >= stop)
+			break;
+	}
+	stats.searchtime += stattime() - t;
+	if (nindexed < nnodes)
+		return	1;
+	indexed = 1;
+	building = 0;
+	stats.searchnodes = nnodes;
+	stats.searchbuilds++;
+	return	0;
+}
+
+/*
+ * Does name have want in it, ignoring case?
+ */
+static int
+matches(name)
+char *name;
+{
+	char	*s, *w;
+
+	if (name == NULL)
+		return	0;
+	for (; *name != '\0'; name++) {
+		for (s = name, w = want; *w != '\0'; s++, w++)
+			if (tolower((unsigned char)*s) != *w)
+				break;
+		if (*w == '\0')
+			return	1;
+	}
+	return	0;
+}
+
+/*
+ * One more match: keep it if it's amongst the biggest
+ */
+static void
+found(np)
+struct node *np;
+{
+	int	i;
+
+	nmatched++;
+	if (np == &top)
+		return;
+	if (nbest == maxbest && np->size <= best[nbest-1]->size)
+		return;
+	i = (nbest < maxbest) ? nbest++ : nbest - 1;
+	for (; i > 0 && best[i-1]->size < np->size; i--)
+		best[i] = best[i-1];
+	best[i] = np;
+}
+
+/*
+ * Look through the tree itself, for when there is no index
+ */
+static void
+findtree(np)
+struct node *np;
+{
+	struct	node *cp;
+
+	if (matches(NAME(np)))
+		found(np);
+	for (cp = np->child; cp != NODE_NULL; cp = cp->peer)
+		findtree(cp);
+}
+
+/*
+ * Find the nodes whose names have text in them, ignoring case, and
+ * put the biggest max of them in list[], biggest first.  Returns how
+ * many there were in all, which may be more than max.
+ */
+int
+searchfind(text, list, max)
+char *text;
+struct node **list;
+int max;
+{
+	struct	postings *pp, *fewest;
+	unsigned char	*cp, *hit;
+	long	i, id, lo, hi, mid;
+	char	buf[MAXNAME];
+	double	t;
+	int	n, k;
+
+	t = stattime();
+	for (n = 0; text[n] != '\0' && n < MAXNAME-1; n++)
+		buf[n] = tolower((unsigned char)text[n]);
+	buf[n] = '\0';
+	want = buf;
+	best = list;
+	maxbest = max;
+	nbest = 0;
+	nmatched = 0;
+
+	if (max < 1 || n == 0) {
+		nmatched = 0;	/* nothing asked for */
+	} else if (!indexed || searchstale) {
+		findtree(&top);
+	} else if (n < 3) {
+		/* each name once, then the nodes with those that matched */
+		if ((hit = (unsigned char *)calloc((nnames + 7) / 8, 1)) == NULL) {
+			fprintf(stderr, "xdu: out of memory\n");
+			exit(1);
+		}
+		for (id = 0; id < nnames; id++)
+			if (matches(namestr(id)))
+				hit[id >> 3] |= 1 << (id & 7);
+		for (i = 0; i < nnodes; i++) {
+			id = nodes[i]->nameid;
+			if (hit[id >> 3] & (1 << (id & 7)))
+				found(nodes[i]);
+		}
+		free((char *)hit);
+	} else {
+		/* the shortest list of those for the text's trigrams */
+		cp = (unsigned char *)buf;
+		fewest = NULL;
+		for (k = 0; k+2 < n; k++) {
+			pp = &lists[TRIHASH(cp[k], cp[k+1], cp[k+2])];
+			if (fewest == NULL || pp->n < fewest->n)
+				fewest = pp;
+		}
+		for (i = 0; i < fewest->n; i++) {
+			id = fewest->ids[i];
+			/* must be on every other list too */
+			for (k = 0; k+2 < n; k++) {
+				pp = &lists[TRIHASH(cp[k], cp[k+1], cp[k+2])];
+				if (pp == fewest)
+					continue;
+				lo = 0;
+				hi = pp->n;
+				while (lo < hi) {
+					mid = (lo + hi) / 2;
+					if (pp->ids[mid] < id)
+						lo = mid + 1;
+					else
+						hi = mid;
+				}
+				if (lo >= pp->n || pp->ids[lo] != id)
+					break;
+			}
+			if (k+2 >= n && matches(NAME(nodes[id])))
+				found(nodes[id]);
+		}
+	}
+	stats.searches++;
+	stats.searchfindtime += stattime() - t;
+	return	nmatched;
+}
+
+/*
+ * Put the whole pathname of a node, from the top of the tree, into
+ * buf (MAXPATH long)
+ */
+char *
+searchpath(np, buf)
+struct node *np;
+char *buf;
+{
+	if (np->parent == NODE_NULL || np->parent == &top) {
+		strcpy(buf, NAME(np));
+	} else {
+		searchpath(np->parent, buf);
+		if (strlen(buf) + 1 + strlen(NAME(np)) < MAXPATH) {
+			if (buf[0] != '\0' && buf[strlen(buf)-1] != '/')
+				strcat(buf, "/");
+			strcat(buf, NAME(np));
+		}
+	}
+	return	buf;
+}
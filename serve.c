@@ -0,0 +1,665 @@
+/*
+ * XDU - One tree, read once, for any number of xdus.
+ *
+ * "xdu -serve socket ..." loads a tree as xdu would (usually a scan),
+ * then publishes it in a shared memory segment and waits on a Unix
+ * socket.  "xdu -attach socket" connects, is handed the segment (as a
+ * file descriptor, so only those who can get at the socket can get
+ * at the tree), maps it read only, and shows the tree in it, without
+ * scanning or reading anything itself.
+ *
+ * A segment is never changed once it is published, but for one flag.
+ * With -watch, the server keeps up with changes to the scanned trees
+ * and publishes each new version of the tree in a new segment; it
+ * then sets the flag in the old one to say there is a newer one.
+ * Those attached to the old one carry on with it, untouched, until
+ * they look at the flag and come back for the new one.  The old one
+ * goes away when the last of them lets go of it.
+ *
+ * A segment holds:
+ *	struct shmhead
+ *	struct shmnode	nnodes of them, parents before their children,
+ *			the top first
+ *	long		nnames offsets of the names, from the text
+ *	text		the names, each ending in a '\0'
+ *
+ * Copyright (c)	Phillip C. Dykstra	1991, 1993, 1994
+ * The X Consortium, and any party obtaining a copy of these files from
+ * the X Consortium, directly or indirectly, is granted, free of charge, a
+ * full and unrestricted irrevocable, world-wide, paid up, royalty-free,
+ * nonexclusive right and license to deal in this software and
+ * documentation files (the "Software"), including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons who receive
+ * copies from any such party to do so.  This license includes without
+ * limitation a license to do the foregoing actions under any patents of
+ * the party supplying this software to the X Consortium.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "xdu.h"
+#include "stats.h"
+
+#define	SHMMAGIC	"xdu-tree"
+#define	SHMVERSION	1
+#define	SERVEINTERVAL	500	/* msec between updates, with -watch */
+
+/*
+ * Segment Header
+ */
+struct shmhead {
+	char	magic[8];	/* SHMMAGIC, with no '\0' */
+	long	version;	/* of the layout, SHMVERSION */
+	long	serial;		/* trees the server published before it */
+	volatile long newer;	/* set once there is a newer one */
+	long	length;		/* of the whole segment, in bytes */
+	long	nnodes;
+	long	nnames;
+	long	nodes;		/* where each part starts */
+	long	names;
+	long	text;
+};
+
+/*
+ * A node, in a segment
+ */
+struct shmnode {
+	long	parent;		/* its index, -1 for the top */
+	long	name;		/* index of its name */
+	long	size;
+	long	own;		/* a scanned directory's, see struct dir, */
+	long	bytes;		/*   or -1 in own if it wasn't scanned */
+	long	files;
+};
+
+/* EXPORTS: routines that this module exports outside */
+extern int servemain();
+extern void attach();
+extern int attachupdate();
+int attached = 0;		/* the tree is a server's */
+
+/* IMPORTS: routines that this module uses from xdu.c */
+extern int numchildren();
+
+/* internal routines */
+static void publish();
+static void count();
+static void flatten();
+static int sendfd();
+static int getsegment();
+static struct shmhead *mapsegment();
+static void hangtree();
+static void stop();
+
+/* the newest segment, the server's or the one being shown */
+static struct shmhead *head = NULL;
+static int headfd = -1;		/* the server's, read only, to hand out */
+static volatile int stopping = 0;	/* the server was told to */
+
+/* while publishing */
+static long *nameat = NULL;	/* index of each name in the dictionary */
+static long maxnameat = 0;
+static long nflat, nflatnames, textlen;
+static struct shmnode *flat;
+static long *flatnames;
+static char *text;
+
+/* where the one being shown came from */
+static char *sockname;
+
+/*
+ * Count np and everything below it, and number the names in it
+ */
+static void
+count(np)
+struct node *np;
+{
+	struct	node	*cp;
+
+	nflat++;
+	if (nameat[np->nameid] < 0) {
+		nameat[np->nameid] = nflatnames++;
+		textlen += strlen(NAME(np)) + 1;
+	}
+	for (cp = np->child; cp != NODE_NULL; cp = cp->peer)
+		count(cp);
+}
+
+/*
+ * Lay np and everything below it out in the segment, parents first
+ */
+static void
+flatten(np, parent)
+struct node *np;
+long parent;
+{
+	struct	node	*cp;
+	long	i;
+
+	i = nflat++;
+	flat[i].parent = parent;
+	flat[i].name = nameat[np->nameid];
+	flat[i].size = np->size;
+	flat[i].own = -1;
+	if (np->dir != NULL) {
+		flat[i].own = np->dir->own;
+		flat[i].bytes = np->dir->bytes;
+		flat[i].files = np->dir->files;
+	}
+	for (cp = np->child; cp != NODE_NULL; cp = cp->peer)
+		flatten(cp, i);
+}
+
+/*
+ * Publish the tree as it is now in a new segment, and tell those using
+ * the last one that there is a newer one
+ */
+static void
+publish()
+{
+	static	long	serial = 0;
+	struct	shmhead	*hp;
+	char	name[64];
+	double	t;
+	long	i, length;
+	int	rwfd, fd;
+
+	t = stattime();
+	if (maxnameat < nnames) {
+		maxnameat = nnames + nnames / 2 + 1024;
+		if (nameat != NULL)
+			free((char *)nameat);
+		nameat = (long *)malloc(maxnameat * sizeof(long));
+		if (nameat == NULL) {
+			fprintf(stderr, "xdu: out of memory\n");
+			exit(1);
+		}
+	}
+	for (i = 0; i < nnames; i++)
+		nameat[i] = -1;
+	nflat = nflatnames = textlen = 0;
+	count(&top);
+	length = sizeof(struct shmhead) + nflat * sizeof(struct shmnode)
+		+ nflatnames * sizeof(long) + textlen;
+
+	/* opened again read only for the clients, before it loses its name */
+	sprintf(name, "/xdu.%ld.%ld", (long)getpid(), serial);
+	if ((rwfd = shm_open(name, O_RDWR|O_CREAT|O_EXCL, 0600)) < 0) {
+		perror("xdu: shm_open");
+		exit(1);
+	}
+	fd = shm_open(name, O_RDONLY, 0);
+	shm_unlink(name);
+	if (fd < 0 || ftruncate(rwfd, length) < 0) {
+		perror("xdu: can't make a shared segment");
+		exit(1);
+	}
+	hp = (struct shmhead *)mmap((void *)NULL, length,
+		PROT_READ|PROT_WRITE, MAP_SHARED, rwfd, (off_t)0);
+	close(rwfd);
+	if (hp == (struct shmhead *)MAP_FAILED) {
+		perror("xdu: mmap");
+		exit(1);
+	}
+
+	memcpy(hp->magic, SHMMAGIC, sizeof(hp->magic));
+	hp->version = SHMVERSION;
+	hp->serial = serial++;
+	hp->newer = 0;
+	hp->length = length;
+	hp->nnodes = nflat;
+	hp->nnames = nflatnames;
+	hp->nodes = sizeof(struct shmhead);
+	hp->names = hp->nodes + nflat * sizeof(struct shmnode);
+	hp->text = hp->names + nflatnames * sizeof(long);
+	flat = (struct shmnode *)((char *)hp + hp->nodes);
+	flatnames = (long *)((char *)hp + hp->names);
+	text = (char *)hp + hp->text;
+
+	nflat = 0;
+	flatten(&top, -1L);
+	length = 0;
+	for (i = 0; i < nnames; i++) {
+		if (nameat[i] >= 0) {
+			flatnames[nameat[i]] = length;
+			strcpy(&text[length], namestr(i));
+			length += strlen(namestr(i)) + 1;
+		}
+	}
+
+	/* new clients get the new one, those on the old one see it's old */
+	if (head != NULL) {
+		head->newer = 1;
+		munmap((void *)head, head->length);
+		close(headfd);
+	}
+	head = hp;
+	headfd = fd;
+	stats.publishes++;
+	stats.publishtime += stattime() - t;
+}
+
+/*
+ * Hand fd to the client on socket s
+ */
+static int
+sendfd(s, fd)
+int s, fd;
+{
+	struct	msghdr	msg;
+	struct	iovec	iov;
+	struct	cmsghdr	*cmp;
+	union	{
+		struct	cmsghdr	hdr;
+		char	buf[CMSG_SPACE(sizeof(int))];
+	} cmsg;
+	char	c = 'x';
+
+	memset((char *)&msg, 0, sizeof(msg));
+	memset((char *)&cmsg, 0, sizeof(cmsg));
+	iov.iov_base = &c;
+	iov.iov_len = 1;
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = cmsg.buf;
+	msg.msg_controllen = sizeof(cmsg.buf);
+	cmp = CMSG_FIRSTHDR(&msg);
+	cmp->cmsg_level = SOL_SOCKET;
+	cmp->cmsg_type = SCM_RIGHTS;
+	cmp->cmsg_len = CMSG_LEN(sizeof(int));
+	memcpy(CMSG_DATA(cmp), (char *)&fd, sizeof(int));
+	return	sendmsg(s, &msg, 0) == 1 ? 0 : -1;
+}
+
+static void
+stop(sig)
+int sig;
+{
+	stopping = 1;
+}
+
+static char serveusage[] = "\
+Usage: xdu -serve socket [-options ...] filename ...\n\
+   or  xdu -serve socket [-options ...] -scan dir ...\n\
+\n\
+Loads a tree once and hands it to any xdu -attach socket\n\
+  options include:\n\
+  -watch         Keep up with changes to the directories scanned\n\
+  -j num         Read inputs on num threads (one per cpu)\n\
+  -maxnodes num  Keep no more than num nodes, collapsing small directories\n\
+  -scan dir ...  Read the directories instead of du output\n\
+  -snapshot file Reuse and update a saved scan\n\
+  -checkpoint file  Log the scan in file as it goes, and carry on from it\n\
+  -apparent      Serve the apparent sizes of scanned files\n\
+  -rate num      Scan at most num files a second\n\
+  -stats         Dump profiling stats to standard error on exit\n\
+";
+
+servemain(argc, argv)
+int argc;
+char **argv;
+{
+	struct	sockaddr_un addr;
+	struct	pollfd	fds[2];
+	struct	stat	st;
+	double	last;
+	char	*sock;
+	int	i, n, k, s, c, wfd, nfds;
+
+	/* take out the options we know, leaving the rest for load() */
+	sock = NULL;
+	n = 1;
+	for (i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-serve") == 0 && i+1 < argc) {
+			sock = argv[++i];
+		} else if (strcmp(argv[i], "-watch") == 0) {
+			watchflag = 1;
+		} else if (strcmp(argv[i], "-apparent") == 0) {
+			setmeasure("apparent");
+		} else if (strcmp(argv[i], "-stats") == 0) {
+			statsflag = 1;
+		} else if (strcmp(argv[i], "-estimate") == 0
+			|| strcmp(argv[i], "-diff") == 0
+			|| strcmp(argv[i], "-history") == 0
+			|| strcmp(argv[i], "-window") == 0
+			|| strcmp(argv[i], "-attach") == 0) {
+			/* only a tree of sizes read once is served */
+			fprintf(stderr, "xdu: %s doesn't go with -serve\n",
+				argv[i]);
+			return	1;
+		} else if ((k = loadoption(argv[i])) > 0 && i+k <= argc) {
+			argv[n++] = argv[i];	/* for load() */
+			if (k > 1)
+				argv[n++] = argv[++i];
+		} else if (argv[i][0] == '-' && argv[i][1] != '\0') {
+			fprintf(stderr, serveusage);
+			return	1;
+		} else {
+			argv[n++] = argv[i];
+		}
+	}
+	argv[n] = NULL;
+	argc = n;
+	if (sock == NULL) {
+		fprintf(stderr, serveusage);
+		return	1;
+	}
+	memset((char *)&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if (strlen(sock) >= sizeof(addr.sun_path)) {
+		fprintf(stderr, "xdu: socket name \"%s\" is too long\n", sock);
+		return	1;
+	}
+	strcpy(addr.sun_path, sock);
+	if (statsflag)
+		atexit(statsdump);
+	signal(SIGPIPE, SIG_IGN);
+	signal(SIGINT, stop);
+	signal(SIGTERM, stop);
+
+	load(argc, argv);
+	publish();
+
+	/* one left by a server that's gone is taken over */
+	if (lstat(sock, &st) == 0) {
+		if (!S_ISSOCK(st.st_mode)) {
+			fprintf(stderr, "xdu: \"%s\" is there already\n", sock);
+			return	1;
+		}
+		unlink(sock);
+	}
+	if ((s = socket(AF_UNIX, SOCK_STREAM, 0)) < 0
+	 || bind(s, (struct sockaddr *)&addr, sizeof(addr)) < 0
+	 || listen(s, 16) < 0) {
+		perror(sock);
+		return	1;
+	}
+
+	wfd = watchflag ? watchstart() : -1;
+	last = stattime();
+	while (!stopping) {
+		fds[0].fd = s;
+		fds[0].events = POLLIN;
+		nfds = 1;
+		if (wfd >= 0) {
+			fds[1].fd = wfd;
+			fds[1].events = POLLIN;
+			nfds = 2;
+		}
+		if ((n = poll(fds, nfds, wfd >= 0 ? SERVEINTERVAL : -1)) < 0) {
+			if (errno == EINTR)
+				continue;
+			perror("xdu: poll");
+			break;
+		}
+		if (n > 0 && (fds[0].revents & POLLIN)
+		 && (c = accept(s, (struct sockaddr *)NULL, NULL)) >= 0) {
+			if (sendfd(c, headfd) == 0)
+				stats.clients++;
+			close(c);
+		}
+		if (nfds > 1 && (fds[1].revents & POLLIN))
+			watchread();
+		if (wfd >= 0 && (stattime() - last) * 1000 >= SERVEINTERVAL) {
+			last = stattime();
+			if (watchupdate() > 0)
+				publish();
+		}
+	}
+	close(s);
+	unlink(sock);
+	return	0;
+}
+
+/*
+ * Connect to the server on the socket name, and get the file
+ * descriptor of its newest segment from it.  Returns -1 if it
+ * can't be had.
+ */
+static int
+getsegment(name)
+char *name;
+{
+	struct	sockaddr_un addr;
+	struct	msghdr	msg;
+	struct	iovec	iov;
+	struct	cmsghdr	*cmp;
+	union	{
+		struct	cmsghdr	hdr;
+		char	buf[CMSG_SPACE(sizeof(int))];
+	} cmsg;
+	char	c;
+	int	s, fd;
+
+	memset((char *)&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if (strlen(name) >= sizeof(addr.sun_path)) {
+		fprintf(stderr, "xdu: socket name \"%s\" is too long\n", name);
+		return	-1;
+	}
+	strcpy(addr.sun_path, name);
+	if ((s = socket(AF_UNIX, SOCK_STREAM, 0)) < 0
+	 || connect(s, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		perror(name);
+		if (s >= 0)
+			close(s);
+		return	-1;
+	}
+
+	memset((char *)&msg, 0, sizeof(msg));
+	iov.iov_base = &c;
+	iov.iov_len = 1;
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = cmsg.buf;
+	msg.msg_controllen = sizeof(cmsg.buf);
+	fd = -1;
+	if (recvmsg(s, &msg, 0) == 1 && (cmp = CMSG_FIRSTHDR(&msg)) != NULL
+	 && cmp->cmsg_level == SOL_SOCKET && cmp->cmsg_type == SCM_RIGHTS)
+		memcpy((char *)&fd, CMSG_DATA(cmp), sizeof(int));
+	close(s);
+	if (fd < 0)
+		fprintf(stderr, "xdu: no tree from \"%s\"\n", name);
+	return	fd;
+}
+
+/*
+ * Map the segment on fd, read only, and make sure it is one.
+ * Returns NULL if it isn't.
+ */
+static struct shmhead *
+mapsegment(fd)
+int fd;
+{
+	struct	shmhead	*hp;
+	struct	shmnode	*sp;
+	struct	stat	st;
+	long	*op, i;
+
+	if (fstat(fd, &st) < 0 || st.st_size < sizeof(struct shmhead)) {
+		close(fd);
+		fprintf(stderr, "xdu: the tree served is damaged\n");
+		return	NULL;
+	}
+	hp = (struct shmhead *)mmap((void *)NULL, (size_t)st.st_size,
+		PROT_READ, MAP_SHARED, fd, (off_t)0);
+	close(fd);
+	if (hp == (struct shmhead *)MAP_FAILED) {
+		perror("xdu: mmap");
+		return	NULL;
+	}
+
+	/* everything in it has to point inside it */
+	if (memcmp(hp->magic, SHMMAGIC, sizeof(hp->magic)) != 0
+	 || hp->version != SHMVERSION || hp->length != st.st_size
+	 || hp->nnodes < 1 || hp->nnames < 1
+	 || hp->nodes != sizeof(struct shmhead)
+	 || hp->names != hp->nodes + hp->nnodes * sizeof(struct shmnode)
+	 || hp->text != hp->names + hp->nnames * sizeof(long)
+	 || hp->text >= hp->length
+	 || ((char *)hp)[hp->length - 1] != '\0')
+		goto bad;
+	sp = (struct shmnode *)((char *)hp + hp->nodes);
+	for (i = 0; i < hp->nnodes; i++, sp++) {
+		if (sp->parent >= i || sp->parent < (i ? 0 : -1)
+		 || sp->name < 0 || sp->name >= hp->nnames)
+			goto bad;
+	}
+	op = (long *)((char *)hp + hp->names);
+	for (i = 0; i < hp->nnames; i++, op++) {
+		if (*op < 0 || hp->text + *op >= hp->length)
+			goto bad;
+	}
+	return	hp;
+
+bad:
+	fprintf(stderr, "xdu: the tree served is damaged\n");
+	munmap((void *)hp, (size_t)st.st_size);
+	return	NULL;
+}
+
+/*
+ * Hang the tree in the segment hp below np, which stands for its top
+ */
+static void
+hangtree(hp, np)
+struct shmhead *hp;
+struct node *np;
+{
+	struct	shmnode	*sp;
+	struct	node	**nodes, *cp, *pp;
+	struct	dir	*dp;
+	long	*op;
+	char	*tp;
+	long	i;
+
+	sp = (struct shmnode *)((char *)hp + hp->nodes);
+	op = (long *)((char *)hp + hp->names);
+	tp = (char *)hp + hp->text;
+	nodes = (struct node **)malloc(hp->nnodes * sizeof(struct node *));
+	if (nodes == NULL) {
+		fprintf(stderr, "xdu: out of memory\n");
+		exit(1);
+	}
+	nodes[0] = np;
+	np->size = sp[0].size;
+	for (i = 1; i < hp->nnodes; i++) {
+		nodes[i] = makenode(tp + op[sp[i].name], sp[i].size,
+			(struct input *)NULL);
+		if (sp[i].own < 0)
+			continue;
+		/* enough of one to add it up in either measure */
+		dp = (struct dir *)calloc(1, sizeof(struct dir));
+		if (dp == NULL) {
+			fprintf(stderr, "xdu: out of memory\n");
+			exit(1);
+		}
+		dp->own = sp[i].own;
+		dp->bytes = sp[i].bytes;
+		dp->files = sp[i].files;
+		dp->wd = -1;
+		nodes[i]->dir = dp;
+	}
+	/* backwards, so each list of children comes out in order */
+	for (i = hp->nnodes - 1; i > 0; i--) {
+		cp = nodes[i];
+		pp = nodes[sp[i].parent];
+		cp->parent = pp;
+		cp->peer = pp->child;
+		pp->child = cp;
+	}
+	free((char *)nodes);
+	measuretree();		/* it may have been served in the other */
+}
+
+/*
+ * Show the tree served on the socket name, under np
+ */
+void
+attach(name, np)
+char *name;
+struct node *np;
+{
+	double	t;
+	int	fd;
+
+	t = stattime();
+	if ((fd = getsegment(name)) < 0 || (head = mapsegment(fd)) == NULL)
+		exit(1);
+	hangtree(head, np);
+	sockname = name;
+	attached = 1;
+	stats.attaches++;
+	stats.attachtime += stattime() - t;
+}
+
+/*
+ * If the server has published a newer tree, swap it in for the one
+ * being shown, staying at the same place in it if it's still there.
+ * Returns 1 if it did.
+ */
+int
+attachupdate()
+{
+	struct	shmhead	*hp;
+	struct	node	*np, *cp;
+	unsigned int	*path;
+	double	t;
+	int	fd, i, n;
+
+	if (!attached || !head->newer)
+		return	0;
+	t = stattime();
+	if ((fd = getsegment(sockname)) < 0 || (hp = mapsegment(fd)) == NULL) {
+		attached = 0;	/* the server's gone, keep the last one */
+		return	0;
+	}
+
+	/* where we were */
+	n = 0;
+	for (np = topp; np != &top && np != NODE_NULL; np = np->parent)
+		n++;
+	path = (unsigned int *)malloc((n + 1) * sizeof(unsigned int));
+	i = n;
+	for (np = topp; np != &top && np != NODE_NULL; np = np->parent)
+		path[--i] = np->nameid;
+
+	while (top.child != NODE_NULL)
+		removenode(top.child);
+	munmap((void *)head, head->length);
+	head = hp;
+	hangtree(head, &top);
+	totaltree(&top);
+	if (order != ORD_DEFAULT) {
+		nameranks();
+		sorttree(&top, order);
+	}
+
+	/* and back there, or as near as we can get */
+	topp = &top;
+	for (i = 0; i < n; i++) {
+		for (cp = topp->child; cp != NODE_NULL; cp = cp->peer)
+			if (cp->nameid == path[i])
+				break;
+		if (cp == NODE_NULL)
+			break;
+		topp = cp;
+	}
+	if (topp == &top && numchildren(topp) == 1)
+		topp = topp->child;
+	free((char *)path);
+	stats.attaches++;
+	stats.attachtime += stattime() - t;
+	return	1;
+}
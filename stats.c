@@ -0,0 +1,187 @@
+/*
+ * XDU - Profiling counters and phase timers.
+ *
+ * Collected while xdu runs, printed on request by the "p" key,
+ * and dumped as "name value" lines on exit with -stats.
+ */
+#include <stdio.h>
+#include <sys/time.h>
+#include "stats.h"
+
+struct stats stats;
+int statsflag = 0;
+
+/*
+ * return the wall clock time in seconds
+ */
+double
+stattime()
+{
+	struct	timeval	tv;
+
+	gettimeofday(&tv, (struct timezone *)0);
+	return	tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+/*
+ * print the stats in a human readable form to standard out
+ */
+void
+statsinfo()
+{
+	printf("Load:  %ld inputs on %ld threads\n",
+		stats.inputs, stats.threads);
+	printf("       %ld bytes, %ld lines, %ld nodes, %ld name compares\n",
+		stats.readbytes, stats.lines, stats.nodes, stats.strcmps);
+	printf("       parse %.3f sec, added up %ld times, %.3f sec\n",
+		stats.parsetime, stats.totals, stats.totaltime);
+	if (stats.collapses > 0)
+		printf("       %ld directories collapsed, %ld nodes let go\n",
+			stats.collapses, stats.dropped);
+	if (stats.unpacked > 0)
+		printf("       %ld bytes uncompressed, %.3f sec, waited %.3f sec\n",
+			stats.unpacked, stats.unpacktime, stats.unpackwait);
+	printf("       %ld different names, %ld bytes, ranked %ld times, %.3f sec\n",
+		stats.names, stats.namebytes, stats.nameranks, stats.ranktime);
+	printf("       %ld days of history read, %.3f sec\n",
+		stats.histcolumns, stats.histtime);
+	if (stats.publishes > 0 || stats.attaches > 0) {
+		printf("Share: %ld trees published, %.3f sec, handed out %ld times\n",
+			stats.publishes, stats.publishtime, stats.clients);
+		printf("       %ld attached, %.3f sec\n",
+			stats.attaches, stats.attachtime);
+	}
+	printf("Scan:  %ld directories, %ld files, %ld unchanged directories\n",
+		stats.scandirs, stats.scanfiles, stats.scanreused);
+	printf("       %ld hard links not counted again\n", stats.scanlinks);
+	if (stats.checkwrites > 0)
+		printf("       %ld resumed, %ld bytes checkpointed, %.3f thread sec\n",
+			stats.checkresumed, stats.checkbytes, stats.checktime);
+	printf("Rate:  %ld operations, %.0f a second lately, ",
+		stats.scanops, stats.scanrate);
+	if (stats.scanlimit > 0)
+		printf("limited to %.0f\n", stats.scanlimit);
+	else
+		printf("no limit\n");
+	printf("       %ld backoffs, held back %.3f thread sec\n",
+		stats.backoffs, stats.throttletime);
+	printf("Estimate: %ld directories, %ld of %ld files looked at, %.3f sec\n",
+		stats.estdirs, stats.estsampled, stats.estfiles,
+		stats.estimatetime);
+	printf("       %ld made exact since\n", stats.refined);
+	printf("Watch: %ld events, %ld overflows, %ld directories reread\n",
+		stats.events, stats.overflows, stats.rereads);
+	printf("Find:  %ld names indexed, built %ld times, %.3f sec\n",
+		stats.searchnodes, stats.searchbuilds, stats.searchtime);
+	printf("       %ld searches, %.3f sec\n",
+		stats.searches, stats.searchfindtime);
+	printf("Top:   %ld lists of the biggest, %ld nodes visited, %.3f sec\n",
+		stats.tops, stats.topvisits, stats.toptime);
+	printf("Kinds: %ld breakdowns (%ld more kept), %ld nodes visited, %.3f sec\n",
+		stats.breakdowns, stats.breakhits, stats.breakvisits,
+		stats.breaktime);
+	printf("Query: %ld rows, %.3f sec\n", stats.queryrows, stats.querytime);
+	printf("Sort:  %ld sorts, %ld compares, %.3f sec\n",
+		stats.sorts, stats.compares, stats.sorttime);
+	if (stats.firstpaint > 0) {
+		printf("Start: window set up %.3f sec, then waited %.3f sec for the tree\n",
+			stats.xsetuptime, stats.loadwait);
+		printf("       first paint %.3f sec after starting\n",
+			stats.firstpaint);
+	}
+	printf("Draw:  %ld repaints, %ld nodes visited, %ld boxes, %.3f sec\n",
+		stats.repaints, stats.visits, stats.boxes, stats.drawtime);
+	printf("       %ld X requests, %ld in last repaint\n",
+		stats.xrequests, stats.lastxrequests);
+	if (stats.zooms > 0)
+		printf("Zoom:  %ld zooms, %ld frames, %ld boxes, %.3f sec, slowest frame %.1f ms\n",
+			stats.zooms, stats.zoomframes, stats.zoomboxes,
+			stats.zoomtime, stats.zoomslowest * 1000);
+}
+
+/*
+ * dump the stats in a machine readable form to standard error
+ */
+void
+statsdump()
+{
+	FILE	*fp = stderr;
+
+	fprintf(fp, "inputs %ld\n", stats.inputs);
+	fprintf(fp, "parse_threads %ld\n", stats.threads);
+	fprintf(fp, "read_bytes %ld\n", stats.readbytes);
+	fprintf(fp, "lines %ld\n", stats.lines);
+	fprintf(fp, "nodes %ld\n", stats.nodes);
+	fprintf(fp, "addtree_strcmps %ld\n", stats.strcmps);
+	fprintf(fp, "collapses %ld\n", stats.collapses);
+	fprintf(fp, "collapsed_nodes %ld\n", stats.dropped);
+	fprintf(fp, "parse_sec %.6f\n", stats.parsetime);
+	fprintf(fp, "totals %ld\n", stats.totals);
+	fprintf(fp, "totals_sec %.6f\n", stats.totaltime);
+	fprintf(fp, "unpacked_bytes %ld\n", stats.unpacked);
+	fprintf(fp, "unpack_sec %.6f\n", stats.unpacktime);
+	fprintf(fp, "unpack_wait_sec %.6f\n", stats.unpackwait);
+	fprintf(fp, "names %ld\n", stats.names);
+	fprintf(fp, "name_bytes %ld\n", stats.namebytes);
+	fprintf(fp, "name_ranks %ld\n", stats.nameranks);
+	fprintf(fp, "name_rank_sec %.6f\n", stats.ranktime);
+	fprintf(fp, "history_columns %ld\n", stats.histcolumns);
+	fprintf(fp, "history_sec %.6f\n", stats.histtime);
+	fprintf(fp, "share_published %ld\n", stats.publishes);
+	fprintf(fp, "share_publish_sec %.6f\n", stats.publishtime);
+	fprintf(fp, "share_clients %ld\n", stats.clients);
+	fprintf(fp, "share_attached %ld\n", stats.attaches);
+	fprintf(fp, "share_attach_sec %.6f\n", stats.attachtime);
+	fprintf(fp, "scan_dirs %ld\n", stats.scandirs);
+	fprintf(fp, "scan_files %ld\n", stats.scanfiles);
+	fprintf(fp, "scan_reused_dirs %ld\n", stats.scanreused);
+	fprintf(fp, "scan_hard_links %ld\n", stats.scanlinks);
+	fprintf(fp, "scan_checkpoint_resumed %ld\n", stats.checkresumed);
+	fprintf(fp, "scan_checkpoint_writes %ld\n", stats.checkwrites);
+	fprintf(fp, "scan_checkpoint_bytes %ld\n", stats.checkbytes);
+	fprintf(fp, "scan_checkpoint_sec %.6f\n", stats.checktime);
+	fprintf(fp, "scan_ops %ld\n", stats.scanops);
+	fprintf(fp, "scan_ops_per_sec %.0f\n", stats.scanrate);
+	fprintf(fp, "scan_rate_limit %.0f\n", stats.scanlimit);
+	fprintf(fp, "scan_backoffs %ld\n", stats.backoffs);
+	fprintf(fp, "scan_throttle_sec %.6f\n", stats.throttletime);
+	fprintf(fp, "estimate_dirs %ld\n", stats.estdirs);
+	fprintf(fp, "estimate_files %ld\n", stats.estfiles);
+	fprintf(fp, "estimate_sampled %ld\n", stats.estsampled);
+	fprintf(fp, "estimate_sec %.6f\n", stats.estimatetime);
+	fprintf(fp, "estimate_refined %ld\n", stats.refined);
+	fprintf(fp, "watch_events %ld\n", stats.events);
+	fprintf(fp, "watch_overflows %ld\n", stats.overflows);
+	fprintf(fp, "watch_rereads %ld\n", stats.rereads);
+	fprintf(fp, "search_names %ld\n", stats.searchnodes);
+	fprintf(fp, "search_builds %ld\n", stats.searchbuilds);
+	fprintf(fp, "search_build_sec %.6f\n", stats.searchtime);
+	fprintf(fp, "searches %ld\n", stats.searches);
+	fprintf(fp, "search_sec %.6f\n", stats.searchfindtime);
+	fprintf(fp, "tops %ld\n", stats.tops);
+	fprintf(fp, "top_visits %ld\n", stats.topvisits);
+	fprintf(fp, "top_sec %.6f\n", stats.toptime);
+	fprintf(fp, "breakdowns %ld\n", stats.breakdowns);
+	fprintf(fp, "breakdown_hits %ld\n", stats.breakhits);
+	fprintf(fp, "breakdown_visits %ld\n", stats.breakvisits);
+	fprintf(fp, "breakdown_sec %.6f\n", stats.breaktime);
+	fprintf(fp, "query_rows %ld\n", stats.queryrows);
+	fprintf(fp, "query_sec %.6f\n", stats.querytime);
+	fprintf(fp, "sorts %ld\n", stats.sorts);
+	fprintf(fp, "sort_compares %ld\n", stats.compares);
+	fprintf(fp, "sort_sec %.6f\n", stats.sorttime);
+	fprintf(fp, "xsetup_sec %.6f\n", stats.xsetuptime);
+	fprintf(fp, "load_wait_sec %.6f\n", stats.loadwait);
+	fprintf(fp, "first_paint_sec %.6f\n", stats.firstpaint);
+	fprintf(fp, "repaints %ld\n", stats.repaints);
+	fprintf(fp, "layout_visits %ld\n", stats.visits);
+	fprintf(fp, "boxes %ld\n", stats.boxes);
+	fprintf(fp, "draw_sec %.6f\n", stats.drawtime);
+	fprintf(fp, "x_requests %ld\n", stats.xrequests);
+	fprintf(fp, "x_requests_last_repaint %ld\n", stats.lastxrequests);
+	fprintf(fp, "zooms %ld\n", stats.zooms);
+	fprintf(fp, "zoom_frames %ld\n", stats.zoomframes);
+	fprintf(fp, "zoom_boxes %ld\n", stats.zoomboxes);
+	fprintf(fp, "zoom_sec %.6f\n", stats.zoomtime);
+	fprintf(fp, "zoom_slowest_frame_sec %.6f\n", stats.zoomslowest);
+}
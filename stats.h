@@ -0,0 +1,105 @@
+/*
+ * XDU - Profiling counters and phase timers.
+ *
+ * The counters are always kept, at the cost of an add apiece.
+ * The clock is only read at the start and end of each phase.
+ */
+struct stats {
+	/* loading */
+	long	inputs;		/* du outputs read */
+	long	threads;	/* most threads reading them at once */
+	long	readbytes;	/* bytes of input read */
+	long	lines;		/* input lines parsed */
+	long	nodes;		/* nodes created */
+	long	collapses;	/* directories collapsed to keep to -maxnodes */
+	long	dropped;	/* nodes let go from below them */
+	long	strcmps;	/* name comparisons in addtree() */
+	double	parsetime;	/* seconds reading and parsing input */
+	long	totals;		/* times the tree was added up */
+	double	totaltime;	/* seconds doing it */
+	long	unpacked;	/* bytes uncompressed */
+	double	unpacktime;	/* thread seconds uncompressing them */
+	double	unpackwait;	/* thread seconds parsing waited for them */
+	long	names;		/* different names in the dictionary */
+	long	namebytes;	/* their length, with the '\0's */
+	long	nameranks;	/* times they were put in order */
+	double	ranktime;	/* seconds doing it */
+	long	histcolumns;	/* days of sizes read from a history */
+	double	histtime;	/* seconds reading and writing histories */
+	long	publishes;	/* trees published by -serve */
+	double	publishtime;	/* seconds publishing them */
+	long	clients;	/* xdus they were handed to */
+	long	attaches;	/* trees taken from a server by -attach */
+	double	attachtime;	/* seconds taking them */
+
+	/* scanning and watching */
+	long	scandirs;	/* directories read */
+	long	scanfiles;	/* files looked at */
+	long	scanreused;	/* directories unchanged since the snapshot */
+	long	scanlinks;	/* hard links to files counted elsewhere */
+	long	checkresumed;	/* directories taken from a checkpoint */
+	long	checkwrites;	/* writes to the checkpoint log */
+	long	checkbytes;	/* bytes in them */
+	double	checktime;	/* thread seconds writing them */
+	long	scanops;	/* getdents and lstat calls */
+	double	scanrate;	/* of those a second, lately */
+	double	scanlimit;	/* rate allowed just now, 0 for none */
+	long	backoffs;	/* times the file system was found busy */
+	double	throttletime;	/* thread seconds held back to keep to the rate */
+	long	events;		/* inotify events */
+	long	overflows;	/* times the event queue overflowed */
+	long	rereads;	/* directories read again after a change */
+	long	estdirs;	/* directories read for an estimate */
+	long	estfiles;	/* files in them */
+	long	estsampled;	/* of those, looked at */
+	long	refined;	/* estimates made exact */
+	double	estimatetime;	/* seconds to the first estimate */
+
+	/* finding */
+	long	searchnodes;	/* names in the index */
+	long	searchbuilds;	/* times it was built */
+	double	searchtime;	/* seconds building it */
+	long	searches;	/* calls to searchfind() */
+	double	searchfindtime;	/* seconds in them */
+	long	tops;		/* calls to topfind() */
+	long	topvisits;	/* nodes looked at by them */
+	double	toptime;	/* seconds in them */
+	long	breakdowns;	/* subtrees broken down by kind */
+	long	breakhits;	/* breakdowns that were already made */
+	long	breakvisits;	/* nodes looked at making them */
+	double	breaktime;	/* seconds making them */
+
+	/* querying */
+	long	queryrows;	/* lines printed by -query */
+	double	querytime;	/* seconds printing them */
+
+	/* sorting */
+	long	compares;	/* calls to compare() */
+	long	sorts;		/* calls to sorttree() from the top */
+	double	sorttime;	/* seconds in sorttree() */
+
+	/* starting up */
+	double	start;		/* when xdu started */
+	double	xsetuptime;	/* seconds setting up the window, while loading */
+	double	loadwait;	/* seconds it then waited for the tree */
+	double	firstpaint;	/* seconds from the start to the first paint */
+
+	/* drawing */
+	long	repaints;	/* calls to repaint() */
+	long	visits;		/* nodes looked at while laying out */
+	long	boxes;		/* boxes drawn */
+	double	drawtime;	/* seconds laying out and drawing */
+	long	xrequests;	/* X requests issued */
+	long	lastxrequests;	/* X requests issued by the last xrepaint() */
+	long	zooms;		/* moves from one view to the next */
+	long	zoomframes;	/* frames drawn for them */
+	long	zoomboxes;	/* boxes in those */
+	double	zoomtime;	/* seconds laying out and drawing them */
+	double	zoomslowest;	/* seconds for the slowest frame */
+};
+
+extern struct stats stats;
+extern int statsflag;		/* dump stats on exit */
+extern double stattime();
+extern void statsinfo();
+extern void statsdump();
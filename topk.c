@@ -0,0 +1,264 @@
+/*
+ * XDU - The biggest things anywhere below a node.
+ *
+ * One pass over the subtree, without recursion, keeps the k biggest
+ * leaves (nodes with nothing below them: files with du -a, otherwise
+ * the bottom directories) and the k biggest directories by their own
+ * size, less that of everything below them, each in a heap with the
+ * smallest at the top.  Anything no bigger than that is passed over
+ * at the cost of a compare.
+ *
+ * Copyright (c)	Phillip C. Dykstra	1991, 1993, 1994
+ * The X Consortium, and any party obtaining a copy of these files from
+ * the X Consortium, directly or indirectly, is granted, free of charge, a
+ * full and unrestricted irrevocable, world-wide, paid up, royalty-free,
+ * nonexclusive right and license to deal in this software and
+ * documentation files (the "Software"), including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons who receive
+ * copies from any such party to do so.  This license includes without
+ * limitation a license to do the foregoing actions under any patents of
+ * the party supplying this software to the X Consortium.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "xdu.h"
+#include "stats.h"
+
+#define	TOPK		100	/* default number of each to find */
+
+/* EXPORTS: routines that this module exports outside */
+extern int topfind();
+extern char *toptext();
+extern long ownsize();
+int topk = TOPK;
+
+/* internal routines */
+static void heapadd();
+static void heapout();
+
+/*
+ * A heap of at most max nodes, the smallest (by key) at the top
+ */
+struct heap {
+	struct	node **np;
+	long	*key;
+	int	n;
+	int	max;
+};
+
+/*
+ * The size of a node less that of its children: what is in the
+ * directory itself
+ */
+long
+ownsize(np)
+struct node *np;
+{
+	struct	node *cp;
+	long	size;
+
+	size = np->size;
+	for (cp = np->child; cp != NODE_NULL; cp = cp->peer)
+		size -= cp->size;
+	return	size;
+}
+
+/*
+ * Offer a node to a heap: it goes in if there is room, or if it is
+ * bigger than the smallest there, which then goes
+ */
+static void
+heapadd(hp, np, key)
+struct heap *hp;
+struct node *np;
+long key;
+{
+	int	i, c;
+
+	if (hp->n < hp->max) {
+		/* sift up from the bottom */
+		for (i = hp->n++; i > 0 && hp->key[(i-1)/2] > key; i = (i-1)/2) {
+			hp->np[i] = hp->np[(i-1)/2];
+			hp->key[i] = hp->key[(i-1)/2];
+		}
+	} else {
+		if (hp->max == 0 || key <= hp->key[0])
+			return;
+		/* sift down from the top */
+		for (i = 0; (c = 2*i + 1) < hp->n; i = c) {
+			if (c+1 < hp->n && hp->key[c+1] < hp->key[c])
+				c++;
+			if (hp->key[c] >= key)
+				break;
+			hp->np[i] = hp->np[c];
+			hp->key[i] = hp->key[c];
+		}
+	}
+	hp->np[i] = np;
+	hp->key[i] = key;
+}
+
+/*
+ * Take the nodes out of a heap into list[], biggest first
+ */
+static void
+heapout(hp, list)
+struct heap *hp;
+struct node **list;
+{
+	struct	node *np;
+	long	key;
+	int	i, c, n;
+
+	for (n = hp->n; n > 0; ) {
+		list[--n] = hp->np[0];
+		/* move the last one up to the top, and sift it down */
+		np = hp->np[n];
+		key = hp->key[n];
+		for (i = 0; (c = 2*i + 1) < n; i = c) {
+			if (c+1 < n && hp->key[c+1] < hp->key[c])
+				c++;
+			if (hp->key[c] >= key)
+				break;
+			hp->np[i] = hp->np[c];
+			hp->key[i] = hp->key[c];
+		}
+		hp->np[i] = np;
+		hp->key[i] = key;
+	}
+}
+
+/*
+ * Find the k biggest leaves below np, and the k biggest directories
+ * by their own size, and put them in leaves[] and dirs[] (k long),
+ * biggest first.  Either may be NULL if not wanted.  The number found
+ * of each goes in *nleaves and *ndirs.
+ */
+int
+topfind(np, k, leaves, nleaves, dirs, ndirs)
+struct node *np;
+int k;
+struct node **leaves, **dirs;
+int *nleaves, *ndirs;
+{
+	struct	heap	lheap, dheap;
+	struct	node	**stack, *cp, *rootp;
+	long	nstack, maxstack;
+	double	t;
+
+	t = stattime();
+	lheap.max = leaves ? k : 0;
+	dheap.max = dirs ? k : 0;
+	lheap.n = dheap.n = 0;
+	lheap.np = (struct node **)malloc((lheap.max+1) * sizeof(struct node *));
+	lheap.key = (long *)malloc((lheap.max+1) * sizeof(long));
+	dheap.np = (struct node **)malloc((dheap.max+1) * sizeof(struct node *));
+	dheap.key = (long *)malloc((dheap.max+1) * sizeof(long));
+	maxstack = 1024;
+	stack = (struct node **)malloc(maxstack * sizeof(struct node *));
+	if (lheap.np == NULL || lheap.key == NULL || dheap.np == NULL
+	 || dheap.key == NULL || stack == NULL) {
+		fprintf(stderr, "xdu: out of memory\n");
+		exit(1);
+	}
+
+	nstack = 0;
+	stack[nstack++] = rootp = np;
+	while (nstack > 0) {
+		np = stack[--nstack];
+		stats.topvisits++;
+		if (np == rootp) {
+			;	/* where we are: only what is below it counts */
+		} else if (np->child == NODE_NULL) {
+			heapadd(&lheap, np, np->size);
+			continue;
+		} else {
+			heapadd(&dheap, np, ownsize(np));
+		}
+		for (cp = np->child; cp != NODE_NULL; cp = cp->peer) {
+			if (nstack >= maxstack) {
+				maxstack *= 2;
+				stack = (struct node **)realloc((char *)stack,
+					maxstack * sizeof(struct node *));
+				if (stack == NULL) {
+					fprintf(stderr, "xdu: out of memory\n");
+					exit(1);
+				}
+			}
+			stack[nstack++] = cp;
+		}
+	}
+
+	if (leaves != NULL)
+		heapout(&lheap, leaves);
+	if (dirs != NULL)
+		heapout(&dheap, dirs);
+	if (nleaves != NULL)
+		*nleaves = lheap.n;
+	if (ndirs != NULL)
+		*ndirs = dheap.n;
+	free((char *)stack);
+	free((char *)lheap.np);
+	free((char *)lheap.key);
+	free((char *)dheap.np);
+	free((char *)dheap.key);
+	stats.tops++;
+	stats.toptime += stattime() - t;
+	return	lheap.n + dheap.n;
+}
+
+/*
+ * The biggest topk of each below np, as text: a heading, then a line
+ * for each, with its size and its whole path.  The text is malloc'd.
+ */
+char *
+toptext(np)
+struct node *np;
+{
+	struct	node	**leaves, **dirs;
+	char	path[MAXPATH], *buf;
+	long	len, max;
+	int	nleaves, ndirs, i;
+
+	leaves = (struct node **)malloc((topk+1) * sizeof(struct node *));
+	dirs = (struct node **)malloc((topk+1) * sizeof(struct node *));
+	max = 2 * (topk+2) * 80;
+	buf = malloc(max);
+	if (leaves == NULL || dirs == NULL || buf == NULL) {
+		fprintf(stderr, "xdu: out of memory\n");
+		exit(1);
+	}
+	topfind(np, topk, leaves, &nleaves, dirs, &ndirs);
+
+	len = 0;
+	for (i = -1; i < nleaves + ndirs + 1; i++) {
+		/* room for the longest line there could be */
+		if (len + MAXPATH + 64 > max) {
+			max = 2 * max + MAXPATH + 64;
+			if ((buf = realloc(buf, max)) == NULL) {
+				fprintf(stderr, "xdu: out of memory\n");
+				exit(1);
+			}
+		}
+		if (i == -1) {
+			sprintf(&buf[len], "Biggest %d with nothing below them:\n",
+				nleaves);
+		} else if (i < nleaves) {
+			sprintf(&buf[len], "%-12ld %s\n", leaves[i]->size,
+				searchpath(leaves[i], path));
+		} else if (i == nleaves) {
+			sprintf(&buf[len], "\nBiggest %d by their own size:\n",
+				ndirs);
+		} else {
+			np = dirs[i - nleaves - 1];
+			sprintf(&buf[len], "%-12ld %s\n", ownsize(np),
+				searchpath(np, path));
+		}
+		len += strlen(&buf[len]);
+	}
+	free((char *)leaves);
+	free((char *)dirs);
+	return	buf;
+}
@@ -0,0 +1,283 @@
+/*
+ * XDU - Adding up the tree.
+ *
+ * Once the tree is read, one pass from the bottom up fills in what
+ * each node has below it: the size du left out (a directory that
+ * only its subdirectories were listed for), its own size less that
+ * of its children, the files and directories at any depth below it,
+ * and how many levels go down from it.  The tree can then be sorted
+ * or labelled by any of these without looking at it again.
+ *
+ * A big tree is cut up amongst threads.  The top levels are taken
+ * breadth first until there are plenty of subtrees below them; the
+ * threads add up those subtrees, each on its own, and then the levels
+ * above are done from the bottom up.
+ *
+ * From du output there is no telling a file from an empty directory,
+ * so anything with nothing below it counts as a file (which it is,
+ * with du -a).  A directory that was scanned knows its own files.
+ *
+ * Copyright (c)	Phillip C. Dykstra	1991, 1993, 1994
+ * The X Consortium, and any party obtaining a copy of these files from
+ * the X Consortium, directly or indirectly, is granted, free of charge, a
+ * full and unrestricted irrevocable, world-wide, paid up, royalty-free,
+ * nonexclusive right and license to deal in this software and
+ * documentation files (the "Software"), including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons who receive
+ * copies from any such party to do so.  This license includes without
+ * limitation a license to do the foregoing actions under any patents of
+ * the party supplying this software to the X Consortium.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "xdu.h"
+#include "stats.h"
+
+#define	NTASKS		16	/* subtrees to cut the tree into, per thread */
+#define	MINSPLIT	65536	/* fewer nodes than this aren't worth it */
+
+/* EXPORTS: routines that this module exports outside */
+extern void totaltree();
+extern void totals();
+extern void subtotal();
+extern long cuttree();
+int totalstale = 0;		/* the tree changed since it was added up */
+long totalgen = 0;		/* times it was, or was changed, to tell if it has */
+
+/* internal routines */
+static void addup();
+static void total();
+static void split();
+static void *worker();
+
+/* the subtrees below the top levels, for the threads */
+static struct node **tasks;
+static long ntasks, nexttask, grab;
+static pthread_mutex_t tasklock = PTHREAD_MUTEX_INITIALIZER;
+
+#define	ISDIR(np)	((np)->child != NODE_NULL || (np)->dir != NULL \
+			 || (np)->hidden > 0)
+
+/*
+ * Fill in np from its children, which are done
+ */
+static void
+addup(np)
+struct node *np;
+{
+	struct	node *cp;
+	long	sum, files, dirs;
+	int	depth;
+
+	if (np->hidden > 0)
+		return;		/* added up before what was below went */
+	sum = 0;
+	files = (np->dir != NULL) ? np->dir->files : 0;
+	dirs = 0;
+	depth = 0;
+	if (!ISDIR(np))
+		files = 1;
+	for (cp = np->child; cp != NODE_NULL; cp = cp->peer) {
+		sum += cp->size;
+		files += cp->files;
+		if (ISDIR(cp))
+			dirs += 1 + cp->dirs;
+		if (cp->depth + 1 > depth)
+			depth = cp->depth + 1;
+	}
+	if (np->size < 0)
+		np->size = sum;		/* du didn't say */
+	np->own = np->size - sum;
+	np->files = files;
+	np->dirs = dirs;
+	np->depth = depth;
+}
+
+/*
+ * Add up np and everything below it
+ */
+static void
+total(np)
+struct node *np;
+{
+	struct	node *cp;
+
+	for (cp = np->child; cp != NODE_NULL; cp = cp->peer)
+		total(cp);
+	addup(np);
+}
+
+/*
+ * Add up np and everything below it, on this thread, without counting
+ * it as adding up the tree (for collapse.c)
+ */
+void
+subtotal(np)
+struct node *np;
+{
+	total(np);
+}
+
+/*
+ * adding thread: take subtrees off the list until there are none left
+ */
+static void *
+worker(arg)
+void *arg;
+{
+	long	i, n;
+
+	for (;;) {
+		pthread_mutex_lock(&tasklock);
+		i = nexttask;
+		n = (ntasks - i < grab) ? ntasks - i : grab;
+		nexttask += n;
+		pthread_mutex_unlock(&tasklock);
+		if (n <= 0)
+			break;
+		for (; n > 0; n--, i++)
+			total(tasks[i]);
+	}
+	return	arg;
+}
+
+/*
+ * Add up the whole tree below np, on as many threads as the tree
+ * was read on
+ */
+void
+totaltree(np)
+struct node *np;
+{
+	double	t;
+	int	n;
+
+	t = stattime();
+	n = nthreads;
+	if (n <= 0)
+		n = sysconf(_SC_NPROCESSORS_ONLN);
+	if (n <= 1 || stats.nodes < MINSPLIT)
+		total(np);
+	else
+		split(np, n);
+	if (np == &top) {
+		totalstale = 0;
+		totalgen++;
+	}
+	stats.totals++;
+	stats.totaltime += stattime() - t;
+}
+
+/*
+ * Cut the tree below np into subtrees for n threads: the top levels,
+ * breadth first, until the level below them has enough subtrees to go
+ * round.  Each level follows the one above it in *upperp, so going
+ * back through it does children first; the subtrees below go in
+ * *tasksp.  Both are malloc'd.  Returns the number of top nodes.
+ */
+long
+cuttree(np, n, upperp, tasksp, ntasksp)
+struct node *np;
+int n;
+struct node ***upperp, ***tasksp;
+long *ntasksp;
+{
+	struct	node	**upper, **tasks, *cp;
+	long	nupper, maxupper, lo, hi, i, below, ntasks;
+
+	maxupper = 1024;
+	if ((upper = (struct node **)malloc(maxupper
+	    * sizeof(struct node *))) == NULL) {
+		fprintf(stderr, "xdu: out of memory\n");
+		exit(1);
+	}
+	nupper = 0;
+	upper[nupper++] = np;
+	lo = 0;
+	for (;;) {
+		hi = nupper;
+		below = 0;
+		for (i = lo; i < hi; i++)
+			for (cp = upper[i]->child; cp != NODE_NULL; cp = cp->peer)
+				below++;
+		if (below == 0 || below >= NTASKS * n)
+			break;
+		if (nupper + below > maxupper) {
+			maxupper = 2 * (nupper + below);
+			upper = (struct node **)realloc((char *)upper,
+				maxupper * sizeof(struct node *));
+			if (upper == NULL) {
+				fprintf(stderr, "xdu: out of memory\n");
+				exit(1);
+			}
+		}
+		for (i = lo; i < hi; i++)
+			for (cp = upper[i]->child; cp != NODE_NULL; cp = cp->peer)
+				upper[nupper++] = cp;
+		lo = hi;
+	}
+
+	tasks = (struct node **)malloc((below + 1) * sizeof(struct node *));
+	if (tasks == NULL) {
+		fprintf(stderr, "xdu: out of memory\n");
+		exit(1);
+	}
+	ntasks = 0;
+	for (i = lo; i < hi; i++)
+		for (cp = upper[i]->child; cp != NODE_NULL; cp = cp->peer)
+			tasks[ntasks++] = cp;
+	*upperp = upper;
+	*tasksp = tasks;
+	*ntasksp = ntasks;
+	return	nupper;
+}
+
+/*
+ * Add up np and everything below it on n threads
+ */
+static void
+split(np, n)
+struct node *np;
+int n;
+{
+	struct	node	**upper;
+	pthread_t	*tids;
+	long	nupper, i;
+
+	nupper = cuttree(np, n, &upper, &tasks, &ntasks);
+	nexttask = 0;
+	grab = ntasks / (NTASKS * n);	/* a few at a time when there are lots */
+	if (grab < 1)
+		grab = 1;
+	if (n > ntasks)
+		n = ntasks;
+	tids = (pthread_t *)malloc(n * sizeof(pthread_t));
+	for (i = 0; i < n; i++) {
+		if (pthread_create(&tids[i], NULL, worker, NULL) != 0) {
+			fprintf(stderr, "xdu: can't start thread\n");
+			exit(1);
+		}
+	}
+	for (i = 0; i < n; i++)
+		pthread_join(tids[i], NULL);
+	free((char *)tids);
+	free((char *)tasks);
+
+	/* then the top levels, from the bottom up */
+	for (i = nupper - 1; i >= 0; i--)
+		addup(upper[i]);
+	free((char *)upper);
+}
+
+/*
+ * Add up the tree again if it changed since the last time
+ */
+void
+totals()
+{
+	if (totalstale)
+		totaltree(&top);
+}
@@ -0,0 +1,454 @@
+/*
+ * XDU - Reading du output, compressed or not.
+ *
+ * An input is read in big blocks rather than through stdio, and split
+ * into lines here.  Its first few bytes tell whether it was compressed
+ * with gzip or zstd.  If it was, a thread of its own unpacks it into a
+ * ring of NRING blocks while the parser works on the ones before, so
+ * that unpacking and building the tree go on at the same time, and
+ * the parser only waits when it has caught up.  That is faster than
+ * "zcat file |", where the two take turns through a pipe.
+ *
+ * gzip needs zlib (HAVE_ZLIB), and zstd needs libzstd (HAVE_ZSTD).
+ * Without them such inputs are refused, by name.
+ *
+ * Copyright (c)	Phillip C. Dykstra	1991, 1993, 1994
+ * The X Consortium, and any party obtaining a copy of these files from
+ * the X Consortium, directly or indirectly, is granted, free of charge, a
+ * full and unrestricted irrevocable, world-wide, paid up, royalty-free,
+ * nonexclusive right and license to deal in this software and
+ * documentation files (the "Software"), including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons who receive
+ * copies from any such party to do so.  This license includes without
+ * limitation a license to do the foregoing actions under any patents of
+ * the party supplying this software to the X Consortium.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+#include "xdu.h"
+#include "stats.h"
+
+#define	BLOCKSIZE	(1 << 20)	/* bytes in a block */
+#define	NRING		4		/* blocks unpacked ahead */
+
+/* what an input was compressed with */
+#define	PACK_NONE	0
+#define	PACK_GZIP	1
+#define	PACK_ZSTD	2
+
+/* EXPORTS: routines that this module exports outside */
+extern struct reader *ropen();
+extern char *rgets();
+extern void rclose();
+
+/* internal routines */
+static int fill();
+static int nextblock();
+static char *putblock();
+static void *unpacker();
+
+/*
+ * Reader Structure
+ * One input being read.  With compression, the ring of blocks is
+ * shared with the thread unpacking it: we use up the count full ones
+ * from head, and it fills in the ones after them.
+ */
+struct reader {
+	char	*name;
+	int	fd;
+	int	pack;		/* PACK_NONE, ... */
+	struct	input *ip;	/* for the counts */
+
+	/* what the first read got, before we knew what it was */
+	unsigned char	start[4];
+	int	nstart;
+
+	/* the ring */
+	char	*ring[NRING];
+	int	len[NRING];	/* bytes in each */
+	int	head;		/* next block to use */
+	int	count;		/* blocks full */
+	int	done;		/* no more are coming */
+	int	failed;		/* because the input was bad */
+	pthread_mutex_t lock;
+	pthread_cond_t	changed;
+	pthread_t	tid;
+	double	packtime;	/* unpacking thread seconds */
+
+	/* the block being split into lines */
+	char	*block;
+	int	blocklen;
+	int	pos;
+	int	inuse;		/* block is ring[head], to give back */
+};
+
+/*
+ * Open an input ("-" for standard input), and find out whether it is
+ * compressed.  Compressed inputs start being unpacked at once.
+ */
+struct reader *
+ropen(ip)
+struct input *ip;
+{
+	struct	reader	*rp;
+	int	i, n;
+
+	rp = (struct reader *)calloc(1, sizeof(struct reader));
+	rp->name = ip->filename;
+	rp->ip = ip;
+	if (strcmp(ip->filename, "-") == 0) {
+		rp->fd = 0;
+	} else if ((rp->fd = open(ip->filename, O_RDONLY)) < 0) {
+		fprintf(stderr, "xdu: can't open \"%s\"\n", ip->filename);
+		exit(1);
+	}
+
+	/* the magic numbers, or as much as there is */
+	for (rp->nstart = 0; rp->nstart < sizeof(rp->start); rp->nstart += n) {
+		n = read(rp->fd, &rp->start[rp->nstart],
+			sizeof(rp->start) - rp->nstart);
+		if (n <= 0)
+			break;
+	}
+	if (rp->nstart >= 2 && rp->start[0] == 0x1f && rp->start[1] == 0x8b)
+		rp->pack = PACK_GZIP;
+	else if (rp->nstart >= 4 && rp->start[0] == 0x28
+	 && rp->start[1] == 0xb5 && rp->start[2] == 0x2f && rp->start[3] == 0xfd)
+		rp->pack = PACK_ZSTD;
+	else
+		rp->pack = PACK_NONE;
+
+#ifndef HAVE_ZLIB
+	if (rp->pack == PACK_GZIP) {
+		fprintf(stderr,
+			"xdu: \"%s\" is gzipped, and xdu was built without zlib\n",
+			ip->filename);
+		exit(1);
+	}
+#endif
+#ifndef HAVE_ZSTD
+	if (rp->pack == PACK_ZSTD) {
+		fprintf(stderr,
+			"xdu: \"%s\" is zstd, and xdu was built without libzstd\n",
+			ip->filename);
+		exit(1);
+	}
+#endif
+
+	if (rp->pack == PACK_NONE) {
+		/* read straight into one block, after what we have */
+		if ((rp->block = malloc(BLOCKSIZE)) == NULL) {
+			fprintf(stderr, "xdu: out of memory\n");
+			exit(1);
+		}
+		memcpy(rp->block, rp->start, rp->nstart);
+		rp->blocklen = rp->nstart;
+		return	rp;
+	}
+
+	for (i = 0; i < NRING; i++) {
+		if ((rp->ring[i] = malloc(BLOCKSIZE)) == NULL) {
+			fprintf(stderr, "xdu: out of memory\n");
+			exit(1);
+		}
+	}
+	pthread_mutex_init(&rp->lock, NULL);
+	pthread_cond_init(&rp->changed, NULL);
+	if (pthread_create(&rp->tid, NULL, unpacker, (void *)rp) != 0) {
+		fprintf(stderr, "xdu: can't start thread\n");
+		exit(1);
+	}
+	return	rp;
+}
+
+/*
+ * Get the next block to split into lines.  Returns 0 at the end.
+ */
+static int
+nextblock(rp)
+struct reader *rp;
+{
+	double	t;
+	int	n;
+
+	if (rp->pack == PACK_NONE) {
+		n = read(rp->fd, rp->block, BLOCKSIZE);
+		rp->blocklen = (n > 0) ? n : 0;
+		rp->pos = 0;
+		return	rp->blocklen > 0;
+	}
+
+	pthread_mutex_lock(&rp->lock);
+	if (rp->inuse) {
+		/* give the last one back to be filled again */
+		rp->head = (rp->head + 1) % NRING;
+		rp->count--;
+		rp->inuse = 0;
+		pthread_cond_signal(&rp->changed);
+	}
+	if (rp->count == 0 && !rp->done) {
+		t = stattime();
+		while (rp->count == 0 && !rp->done)
+			pthread_cond_wait(&rp->changed, &rp->lock);
+		rp->ip->unpackwait += stattime() - t;
+	}
+	if (rp->count == 0) {
+		pthread_mutex_unlock(&rp->lock);
+		if (rp->failed) {
+			fprintf(stderr, "xdu: \"%s\" is corrupt\n", rp->name);
+			exit(1);
+		}
+		return	0;
+	}
+	rp->block = rp->ring[rp->head];
+	rp->blocklen = rp->len[rp->head];
+	rp->pos = 0;
+	rp->inuse = 1;
+	pthread_mutex_unlock(&rp->lock);
+	return	1;
+}
+
+/*
+ * Read a line, like fgets()
+ */
+char *
+rgets(buf, size, rp)
+char *buf;
+int size;
+struct reader *rp;
+{
+	char	*nl;
+	int	n, got;
+
+	got = 0;
+	while (got < size-1) {
+		if (rp->pos >= rp->blocklen && !nextblock(rp))
+			break;
+		n = rp->blocklen - rp->pos;
+		if (n > size-1 - got)
+			n = size-1 - got;
+		if ((nl = memchr(&rp->block[rp->pos], '\n', n)) != NULL)
+			n = nl - &rp->block[rp->pos] + 1;
+		memcpy(&buf[got], &rp->block[rp->pos], n);
+		rp->pos += n;
+		got += n;
+		if (nl != NULL)
+			break;
+	}
+	if (got == 0)
+		return	NULL;
+	buf[got] = '\0';
+	return	buf;
+}
+
+/*
+ * Done with an input
+ */
+void
+rclose(rp)
+struct reader *rp;
+{
+	int	i;
+
+	if (rp->pack == PACK_NONE) {
+		free(rp->block);
+	} else {
+		/* let the unpacker finish, if we stopped early */
+		pthread_mutex_lock(&rp->lock);
+		rp->done = 1;
+		pthread_cond_signal(&rp->changed);
+		pthread_mutex_unlock(&rp->lock);
+		pthread_join(rp->tid, NULL);
+		rp->ip->unpacktime += rp->packtime;
+		for (i = 0; i < NRING; i++)
+			free(rp->ring[i]);
+		pthread_mutex_destroy(&rp->lock);
+		pthread_cond_destroy(&rp->changed);
+	}
+	if (rp->fd != 0)
+		close(rp->fd);
+	free((char *)rp);
+}
+
+/*  The Unpacking Thread  */
+
+/*
+ * Read some of the compressed input into buf (n long), starting with
+ * the bytes looked at to see what it was.  Returns bytes read, 0 at
+ * the end.
+ */
+static int
+fill(rp, buf, n)
+struct reader *rp;
+char *buf;
+int n;
+{
+	int	got;
+
+	if (rp->nstart > 0) {
+		got = rp->nstart;
+		memcpy(buf, rp->start, got);
+		rp->nstart = 0;
+		return	got;
+	}
+	got = read(rp->fd, buf, n);
+	return	(got > 0) ? got : 0;
+}
+
+/*
+ * Pass on the block just filled, with len bytes in it (if any), then
+ * wait for the next one to be free to fill, and return it.  Returns
+ * NULL if the reader has given up, so there is no point going on.
+ */
+static char *
+putblock(rp, len)
+struct reader *rp;
+int len;
+{
+	char	*next;
+
+	pthread_mutex_lock(&rp->lock);
+	if (len > 0) {
+		rp->len[(rp->head + rp->count) % NRING] = len;
+		rp->count++;
+		rp->ip->unpacked += len;
+		pthread_cond_signal(&rp->changed);
+	}
+	while (rp->count == NRING && !rp->done)
+		pthread_cond_wait(&rp->changed, &rp->lock);
+	next = rp->done ? NULL : rp->ring[(rp->head + rp->count) % NRING];
+	pthread_mutex_unlock(&rp->lock);
+	return	next;
+}
+
+static void *
+unpacker(arg)
+void *arg;
+{
+	struct	reader *rp = (struct reader *)arg;
+	char	*in, *out;
+	int	n, len, ok;
+	double	t, waited;
+
+	t = stattime();
+	waited = 0;
+	if ((in = malloc(BLOCKSIZE)) == NULL) {
+		fprintf(stderr, "xdu: out of memory\n");
+		exit(1);
+	}
+	ok = 1;
+	len = 0;
+	out = NULL;	/* the ring block being filled */
+
+#ifdef HAVE_ZLIB
+	if (rp->pack == PACK_GZIP) {
+		z_stream	z;
+		int	ret;
+
+		memset((char *)&z, 0, sizeof(z));
+		if (inflateInit2(&z, 15 + 32) != Z_OK)	/* gzip header */
+			ok = 0;
+		ret = Z_OK;
+		while (ok) {
+			if (z.avail_in == 0) {
+				if ((n = fill(rp, in, BLOCKSIZE)) == 0) {
+					/* cut short? */
+					ok = (ret == Z_STREAM_END);
+					break;
+				}
+				z.next_in = (Bytef *)in;
+				z.avail_in = n;
+			}
+			if (out == NULL || len == BLOCKSIZE) {
+				double	w = stattime();
+
+				if ((out = putblock(rp, len)) == NULL)
+					break;
+				waited += stattime() - w;
+				len = 0;
+			}
+			z.next_out = (Bytef *)&out[len];
+			z.avail_out = BLOCKSIZE - len;
+			ret = inflate(&z, Z_NO_FLUSH);
+			len = BLOCKSIZE - z.avail_out;
+			if (ret == Z_STREAM_END) {
+				/* gzip files may be several, one after another */
+				inflateReset(&z);
+			} else if (ret != Z_OK && ret != Z_BUF_ERROR) {
+				ok = 0;
+			}
+		}
+		inflateEnd(&z);
+	}
+#endif
+#ifdef HAVE_ZSTD
+	if (rp->pack == PACK_ZSTD) {
+		ZSTD_DStream	*zs;
+		ZSTD_inBuffer	zin;
+		ZSTD_outBuffer	zout;
+		size_t	ret;
+
+		if ((zs = ZSTD_createDStream()) == NULL
+		 || ZSTD_isError(ZSTD_initDStream(zs)))
+			ok = 0;
+		zin.src = in;
+		zin.size = zin.pos = 0;
+		ret = 0;
+		while (ok) {
+			if (zin.pos == zin.size) {
+				if ((n = fill(rp, in, BLOCKSIZE)) == 0) {
+					/* cut short? */
+					ok = (ret == 0);
+					break;
+				}
+				zin.size = n;
+				zin.pos = 0;
+			}
+			if (out == NULL || len == BLOCKSIZE) {
+				double	w = stattime();
+
+				if ((out = putblock(rp, len)) == NULL)
+					break;
+				waited += stattime() - w;
+				len = 0;
+			}
+			zout.dst = out;
+			zout.size = BLOCKSIZE;
+			zout.pos = len;
+			ret = ZSTD_decompressStream(zs, &zout, &zin);
+			len = zout.pos;
+			if (ZSTD_isError(ret))
+				ok = 0;
+		}
+		if (zs != NULL)
+			ZSTD_freeDStream(zs);
+	}
+#endif
+
+	/* pass on the last block */
+	pthread_mutex_lock(&rp->lock);
+	if (len > 0 && !rp->done) {
+		rp->len[(rp->head + rp->count) % NRING] = len;
+		rp->count++;
+		rp->ip->unpacked += len;
+	}
+	rp->failed = !ok;
+	rp->done = 1;
+	pthread_cond_signal(&rp->changed);
+	pthread_mutex_unlock(&rp->lock);
+
+	free(in);
+	rp->packtime = stattime() - t - waited;
+	return	arg;
+}
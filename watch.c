@@ -0,0 +1,298 @@
+/*
+ * XDU - Watching a scanned tree for changes.
+ *
+ * With -watch, every directory of a scanned tree (see scan.c) gets
+ * an inotify watch.  Reading the events only marks the directories
+ * they were for as dirty, which costs the same however many events
+ * there are for one directory, so an event storm (rm -rf of a big
+ * tree, say) comes down to one reading of each directory involved.
+ * The dirty directories are read again a few at a time, from a timer,
+ * and the display is repainted at most once each time.
+ *
+ * Copyright (c)	Phillip C. Dykstra	1991, 1993, 1994
+ * The X Consortium, and any party obtaining a copy of these files from
+ * the X Consortium, directly or indirectly, is granted, free of charge, a
+ * full and unrestricted irrevocable, world-wide, paid up, royalty-free,
+ * nonexclusive right and license to deal in this software and
+ * documentation files (the "Software"), including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons who receive
+ * copies from any such party to do so.  This license includes without
+ * limitation a license to do the foregoing actions under any patents of
+ * the party supplying this software to the X Consortium.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "xdu.h"
+#include "stats.h"
+
+#ifdef HAVE_INOTIFY
+#include <errno.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#endif
+
+#define	WATCHBUDGET	100	/* most msec of rereading per update */
+
+/* EXPORTS: routines that this module exports outside */
+extern int watchstart();
+extern void watchread();
+extern int watchupdate();
+extern void watchtree();
+extern void unwatchtree();
+int watchflag = 0;		/* watch scanned trees for changes */
+
+#ifdef HAVE_INOTIFY
+
+#define	WATCHMASK	(IN_CREATE|IN_DELETE|IN_MODIFY|IN_ATTRIB|IN_MOVED_FROM \
+			|IN_MOVED_TO|IN_DELETE_SELF|IN_MOVE_SELF|IN_ONLYDIR \
+			|IN_EXCL_UNLINK)
+
+/* internal routines */
+static void markdirty();
+
+static int fd = -1;			/* inotify instance */
+static struct node **wdnode = NULL;	/* node for each watch */
+static int maxwd = 0;			/* allocated entries */
+static int *dirtywd = NULL;		/* watches waiting to be read again */
+static int dirtyhead, dirtytail;	/* next one to read, next free */
+static int maxdirty = 0;
+static int nowatches = 0;		/* ran out, said so */
+
+/*
+ * Start watching every scanned tree at the top.  Returns the file
+ * descriptor to wait for events on, or -1 if there is nothing to do.
+ */
+int
+watchstart()
+{
+	struct	node	*np;
+
+	for (np = top.child; np != NODE_NULL; np = np->peer) {
+		if (np->dir != NULL)
+			break;
+	}
+	if (np == NODE_NULL) {
+		fprintf(stderr, "xdu: -watch only works on trees read with -scan\n");
+		return	-1;
+	}
+	if ((fd = inotify_init1(IN_NONBLOCK|IN_CLOEXEC)) < 0) {
+		perror("xdu: inotify_init1");
+		return	-1;
+	}
+	for (np = top.child; np != NODE_NULL; np = np->peer)
+		watchtree(np);
+
+	return	fd;
+}
+
+/*
+ * Watch a scanned directory and everything below it
+ */
+void
+watchtree(np)
+struct node *np;
+{
+	char	path[MAXPATH];
+	struct	node	*cp;
+	int	wd, n;
+
+	if (fd < 0 || np->dir == NULL)
+		return;
+
+	if ((wd = inotify_add_watch(fd, nodepath(np, path), WATCHMASK)) < 0) {
+		if (errno == ENOSPC && !nowatches) {
+			fprintf(stderr, "xdu: out of inotify watches, %s\n",
+				"some changes won't be seen (see max_user_watches)");
+			nowatches = 1;
+		}
+	} else {
+		if (wd >= maxwd) {
+			n = maxwd;
+			maxwd = (wd < 1024) ? 1024 : 2 * wd;
+			wdnode = (struct node **)realloc((char *)wdnode,
+				maxwd * sizeof(struct node *));
+			if (wdnode == NULL) {
+				fprintf(stderr, "xdu: out of memory\n");
+				exit(1);
+			}
+			while (n < maxwd)
+				wdnode[n++] = NODE_NULL;
+		}
+		wdnode[wd] = np;
+		np->dir->wd = wd;
+	}
+
+	for (cp = np->child; cp != NODE_NULL; cp = cp->peer)
+		watchtree(cp);
+}
+
+/*
+ * Stop watching a directory and everything below it, which is
+ * about to be taken out of the tree.  If the same directory is
+ * watched as another node now (it was moved), leave that alone.
+ */
+void
+unwatchtree(np)
+struct node *np;
+{
+	struct	node	*cp;
+
+	if (np->dir == NULL)
+		return;
+	if (np->dir->wd >= 0 && wdnode[np->dir->wd] == np) {
+		inotify_rm_watch(fd, np->dir->wd);
+		wdnode[np->dir->wd] = NODE_NULL;
+	}
+	np->dir->wd = -1;
+
+	for (cp = np->child; cp != NODE_NULL; cp = cp->peer)
+		unwatchtree(cp);
+}
+
+/*
+ * Put a watched directory on the list to be read again,
+ * unless it is there already.  The list holds watches, not
+ * nodes, so that a node can go away while it is on it.
+ */
+static void
+markdirty(np)
+struct node *np;
+{
+	if (np->dir->dirty || np->dir->wd < 0)
+		return;
+	if (dirtytail >= maxdirty && dirtyhead > 0) {
+		/* those already read again make room */
+		memmove((char *)dirtywd, (char *)&dirtywd[dirtyhead],
+			(dirtytail - dirtyhead) * sizeof(int));
+		dirtytail -= dirtyhead;
+		dirtyhead = 0;
+	}
+	if (dirtytail >= maxdirty) {
+		maxdirty = maxdirty ? 2 * maxdirty : 1024;
+		dirtywd = (int *)realloc((char *)dirtywd,
+			maxdirty * sizeof(int));
+		if (dirtywd == NULL) {
+			fprintf(stderr, "xdu: out of memory\n");
+			exit(1);
+		}
+	}
+	dirtywd[dirtytail++] = np->dir->wd;
+	np->dir->dirty = 1;
+}
+
+/*
+ * Read all of the events waiting, and mark the directories they
+ * were for.  Called whenever the descriptor is readable.
+ */
+void
+watchread()
+{
+	char	buf[64 * 1024];
+	struct	inotify_event *ev;
+	struct	node	*np;
+	char	*cp;
+	int	n, wd;
+
+	while ((n = read(fd, buf, sizeof(buf))) > 0) {
+		for (cp = buf; cp < buf + n;
+		    cp += sizeof(struct inotify_event) + ev->len) {
+			ev = (struct inotify_event *)cp;
+			stats.events++;
+			if (ev->mask & IN_Q_OVERFLOW) {
+				/* we lost some, so anything might have changed */
+				stats.overflows++;
+				for (wd = 0; wd < maxwd; wd++) {
+					if (wdnode[wd] != NODE_NULL)
+						markdirty(wdnode[wd]);
+				}
+				continue;
+			}
+			if (ev->wd < 0 || ev->wd >= maxwd
+			 || (np = wdnode[ev->wd]) == NODE_NULL)
+				continue;
+			if (ev->mask & IN_IGNORED) {
+				/*
+				 * The directory was deleted, or moved out from
+				 * under the watch.  Its parent gets told too, and
+				 * will find it missing or scan whatever is there
+				 * now instead.
+				 */
+				wdnode[ev->wd] = NODE_NULL;
+				np->dir->wd = -1;
+				np->dir->gone = 1;
+				if (np->parent != NODE_NULL && np->parent->dir != NULL)
+					markdirty(np->parent);
+				continue;
+			}
+			markdirty(np);
+		}
+	}
+}
+
+/*
+ * Read the dirty directories again, for up to WATCHBUDGET msec, or
+ * until the scan rate (see rate.c) says to wait.  Any left over wait
+ * for the next call.  Returns how many were read, so the caller knows
+ * whether to repaint.
+ */
+int
+watchupdate()
+{
+	struct	node	*np;
+	double	start;
+	int	n, wd;
+
+	n = 0;
+	start = stattime();
+	while (dirtyhead < dirtytail && ratewait() == 0) {
+		wd = dirtywd[dirtyhead++];
+		if ((np = wdnode[wd]) == NODE_NULL)
+			continue;	/* gone since */
+		np->dir->dirty = 0;
+		stats.rereads++;
+		rescandir(np);
+		n++;
+		if ((stattime() - start) * 1000 >= WATCHBUDGET)
+			break;
+	}
+	if (dirtyhead == dirtytail)
+		dirtyhead = dirtytail = 0;
+
+	return	n;
+}
+
+#else /* HAVE_INOTIFY */
+
+int
+watchstart()
+{
+	fprintf(stderr, "xdu: -watch isn't supported here\n");
+	return	-1;
+}
+
+void
+watchread()
+{
+}
+
+int
+watchupdate()
+{
+	return	0;
+}
+
+void
+watchtree(np)
+struct node *np;
+{
+}
+
+void
+unwatchtree(np)
+struct node *np;
+{
+}
+
+#endif /* HAVE_INOTIFY */
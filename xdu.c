@@ -20,22 +20,27 @@
  * the party supplying this software to the X Consortium.
  */
 #include <stdio.h>
+#include <math.h>
+#include <pthread.h>
 #include "version.h"
+#include "xdu.h"
+#include "stats.h"
 
-extern char *malloc(), *calloc();
+extern char *malloc(), *calloc(), *realloc();
 
-#define	MAXDEPTH	80	/* max elements in a path */
-#define	MAXNAME		1024	/* max pathname element length */
-#define	MAXPATH		4096	/* max total pathname length */
 #define	NCOLS		5	/* default number of columns in display */
+#define	BUDGET		20	/* default msec of drawing per frame */
 
-/* What we IMPORT from xwin.c */
-extern int xsetup(), xmainloop(), xdrawrect(), xrepaint();
+/* What we IMPORT from the display: xwin.c, render.c or bench.c */
+struct display *display;
 
 /* What we EXPORT to xwin.c */
 extern int press(), reset(), repaint(), setorder(), reorder();
-extern nodeinfo(), helpinfo();
+extern int setlayout(), relayout(), drawmore();
+extern int setmeasure(), remeasure(), setlabel(), relabel(), gotonode();
+extern nodeinfo(), topinfo(), helpinfo();
 int ncols = NCOLS;
+int budget = BUDGET;
 
 /* internal routines */
 char *strdup();
@@ -45,68 +50,67 @@ void parse_entry();
 void dumptree();
 void clearrects();
 void sorttree();
+void drawnode();
+void drawchildren();
+void drawtreemap();
+void drawtreechildren();
+void squarify();
+void queuedraw();
+void freetree();
+static void newtop();
+static void *loader();
+static void waitsettled();
 
-/* order to sort paths by */
-#define	ORD_FIRST	1
-#define	ORD_LAST	2
-#define	ORD_ALPHA	3
-#define	ORD_SIZE	4
-#define	ORD_RALPHA	5
-#define	ORD_RSIZE	6
-#define	ORD_DEFAULT	ORD_FIRST
 int order = ORD_DEFAULT;
+int layout = LAYOUT_COLUMNS;
+int label = LABEL_SIZE;
+int diffmode = 0;	/* showing the changes between two inputs */
 
-/*
- * Rectangle Structure
- * Stores window coordinates of a displayed rectangle
- * so that we can "find" it again on key presses.
- */
-struct rect {
-	int	left;
-	int	top;
-	int	width;
-	int	height;
-};
-
-/*
- * Node Structure
- * Each node in the path tree is linked in with one of these.
- */
-struct node {
-	char	*name;
-	long	size;		/* from here down in the tree */
-	long	num;		/* entry number - for resorting */
-	struct	rect rect;	/* last drawn screen rectangle */
-	struct	node *peer;	/* siblings */
-	struct	node *child;	/* list of children if !NULL */
-	struct	node *parent;	/* backpointer to parent */
-} top;
+struct node top;
 struct node *topp = &top;
-#define	NODE_NULL ((struct node *)0)
+struct node *drawnp = NODE_NULL;	/* root of the last drawn display */
 long nnodes = 0;
 
+/* loading on a thread of its own while the window is set up */
+static pthread_t loadtid;
+static int loadargc;
+static char **loadargv;
+static int unsettled = 0;	/* the display hasn't said how to sort yet */
+static char *settledmeasure;	/* what it said to show the sizes in */
+static pthread_mutex_t settlelock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t settledcond = PTHREAD_COND_INITIALIZER;
+
 /*
- * create a new node with the given name and size info
+ * create a new node with the given name and size info,
+ * counted against the input being read, if any.  It is called from
+ * many threads at once while loading, so it leaves marking the totals
+ * and the name index stale to whoever puts it in the tree.
  */
 struct node *
-makenode(name,size)
+makenode(name,size,ip)
 char *name;
-int size;
+long size;
+struct input *ip;
 {
 	struct	node	*np;
 
 	np = (struct node *)calloc(1,sizeof(struct node));
-	np->name = strdup(name);
+	np->nameid = intern(name);
 	np->size = size;
-	np->num = nnodes;
-	nnodes++;
+	if (ip != NULL) {
+		np->num = ip->nodes++;
+	} else {
+		np->num = nnodes++;
+		stats.nodes++;
+	}
 
 	return	np;
 }
 
 /*
  * Return the node (if any) which has a draw rectangle containing
- * the given x,y point.
+ * the given x,y point.  Only the drawn part of the tree is searched:
+ * a node that wasn't drawn has no drawn descendants either.
  */
 struct node *
 findnode(treep, x, y)
@@ -116,14 +120,23 @@ int	x, y;
 	struct	node	*np;
 	struct	node	*np2;
 
-	if (treep == NODE_NULL)
+	if (treep == NODE_NULL || treep->rect.width == 0)
 		return	NODE_NULL;
 
 	if (x >= treep->rect.left && x < treep->rect.left+treep->rect.width
 	 && y >= treep->rect.top && y < treep->rect.top+treep->rect.height) {
-		/*printf("found %s\n", treep->name);*/
+		/*printf("found %s\n", NAME(treep));*/
+		if (layout == LAYOUT_TREEMAP) {
+			/* children nest inside, return the deepest one */
+			for (np = treep->child; np != NULL; np = np->peer) {
+				if ((np2 = findnode(np,x,y)) != NODE_NULL)
+					return	np2;
+			}
+		}
 		return	treep;	/* found */
 	}
+	if (layout == LAYOUT_TREEMAP)
+		return	NODE_NULL;	/* children lie inside of us */
 
 	/* for each child */
 	for (np = treep->child; np != NULL; np = np->peer) {
@@ -152,31 +165,8 @@ struct node *nodep;
 	return	n;
 }
 
-/*
- * fix_tree - This function repairs the tree when certain nodes haven't
- * 	      had their sizes initialized. [DPT911113]
- *	      * * * This function is recursive * * *
- */
-long
-fix_tree(top)
-struct node *top;
-{
-	struct node *nd;
-
-	if (top == NODE_NULL)		/* recursion end conditions */
-		return 0;
-	if (top->size >= 0) 		/* also halt recursion on valid size */
-		return top->size;	/* (remember: sizes init. to -1) */
-
-	top->size = 0;
-	for (nd = top->child; nd != NODE_NULL; nd = nd->peer)
-		top->size += fix_tree(nd);
-
-	return top->size;
-}
-
 static char usage[] = "\
-Usage: xdu [-options ...] filename\n\
+Usage: xdu [-options ...] filename ...\n\
    or  xdu [-options ...] < du.out\n\
 \n\
 Graphically displays the output of du in an X window\n\
@@ -188,78 +178,353 @@ Graphically displays the output of du in an X window\n\
   -a          Sort in alphabetical order\n\
   -ra         Sort in reverse alphabetical order\n\
   -c num      Set number of columns to num\n\
+  -t          Use a treemap layout instead of columns\n\
+  -stats      Dump profiling stats to standard error on exit\n\
+  -render file  Draw into a PNG or SVG file instead of a window\n\
+  -query      Print sizes as text or JSON instead (see -query -help)\n\
+  -diff old new  Display what changed from old to new\n\
+  -record dir    Add the input to the history in dir as the next day\n\
+  -history dir   Display what changed over the last days in dir\n\
+  -window days   How many days back -history looks (30)\n\
+  -serve sock ...  Load the tree once and hand it out on the socket sock\n\
+  -attach sock   Display the tree served on the socket sock\n\
+  -j num      Read inputs on num threads (one per cpu)\n\
+  -maxnodes num  Keep no more than num nodes, collapsing the smallest directories\n\
+  -scan dir ...  Read the directories instead of du output\n\
+  -watch      Keep up with changes to the directories scanned\n\
+  -snapshot file  Save the scan in file, and skip what is unchanged next time\n\
+                 (without -scan, display the scan saved in file)\n\
+  -checkpoint file  Log the scan in file as it goes, and carry on from it\n\
+  -apparent   Show the apparent sizes of scanned files\n\
+  -rate num   Scan at most num files a second (and less when it is busy)\n\
+  -estimate   Show an estimate of the scan at once, then make it exact\n\
+  -label what Show each box's own size, files, dirs or depth, not its size\n\
+  -zoom ms    Take ms to move from one view to the next (200, 0 to jump)\n\
   Toolkit options: -fg, -bg, -rv, -display, -geometry, etc.\n\
 ";
 
-main(argc,argv)
+/*
+ * Load the tree from the inputs named by the (remaining) command line
+ * arguments, and get it ready for display.  A single file is the tree;
+ * several files, or a directory of them, each go under a node of
+ * their own.
+ */
+void
+load(argc,argv)
 int argc;
 char **argv;
 {
-	top.name = strdup("[root]");
+	static	struct	node old;	/* older tree in diff mode */
+	static	char	*stdinput[] = { "-", NULL };
+	char	*snapname = NULL;
+	char	*histname = NULL;
+	char	*attachname = NULL;
+	double	t;
+	int	i, n, scan, window, m;
+
+	/* take out our own options */
+	n = 1;
+	scan = 0;
+	window = 0;
+	for (i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-diff") == 0) {
+			diffmode = 1;
+		} else if (strcmp(argv[i], "-history") == 0 && i+1 < argc) {
+			histname = argv[++i];
+		} else if (strcmp(argv[i], "-attach") == 0 && i+1 < argc) {
+			attachname = argv[++i];
+		} else if (strcmp(argv[i], "-window") == 0 && i+1 < argc) {
+			window = atoi(argv[++i]);
+			if (window < 1) {
+				fprintf(stderr, "xdu: bad window\n");
+				exit(1);
+			}
+		} else if (strcmp(argv[i], "-scan") == 0) {
+			scan = 1;
+		} else if (strcmp(argv[i], "-estimate") == 0) {
+			estimating = 1;
+		} else if (strcmp(argv[i], "-snapshot") == 0 && i+1 < argc) {
+			snapname = argv[++i];
+		} else if (strcmp(argv[i], "-checkpoint") == 0 && i+1 < argc) {
+			checkname = argv[++i];
+		} else if (strcmp(argv[i], "-j") == 0 && i+1 < argc) {
+			nthreads = atoi(argv[++i]);
+			if (nthreads < 1) {
+				fprintf(stderr, "xdu: bad number of threads\n");
+				exit(1);
+			}
+		} else if (strcmp(argv[i], "-maxnodes") == 0 && i+1 < argc) {
+			nodebudget = atol(argv[++i]);
+			if (nodebudget < 1) {
+				fprintf(stderr, "xdu: bad number of nodes\n");
+				exit(1);
+			}
+		} else if (strcmp(argv[i], "-rate") == 0 && i+1 < argc) {
+			ratelimit = atol(argv[++i]);
+			if (ratelimit < 0) {
+				fprintf(stderr, "xdu: bad rate\n");
+				exit(1);
+			}
+		} else if (argv[i][0] == '-' && argv[i][1] != '\0') {
+			fprintf(stderr, usage);
+			exit(1);
+		} else {
+			argv[n++] = argv[i];
+		}
+	}
+	argc = n;
+
+	top.nameid = intern("[root]");
 	top.size = -1;
+	m = measure;
+
+	if (nodebudget > 0 && (scan || snapname != NULL || histname != NULL
+	 || attachname != NULL || diffmode)) {
+		fprintf(stderr, "xdu: -maxnodes only goes with du output\n");
+		exit(1);
+	}
+	if (checkname != NULL && (!scan || estimating)) {
+		fprintf(stderr,
+			"xdu: -checkpoint only goes with -scan, not -estimate\n");
+		exit(1);
+	}
 
-	xsetup(&argc,argv);
-	if (argc == 1) {
+	t = stattime();
+	if (histname != NULL) {
+		/* two days of the history, as if they were -diff inputs */
+		if (argc != 1 || scan || diffmode || snapname != NULL
+		 || estimating) {
+			fprintf(stderr, usage);
+			exit(1);
+		}
+		old.nameid = top.nameid;
+		old.size = -1;
+		loadhistory(histname, window, &old, &top);
+		diffmode = 1;
+	} else if (attachname != NULL) {
+		/* a tree someone else read */
+		if (argc != 1 || scan || diffmode || snapname != NULL
+		 || estimating) {
+			fprintf(stderr, usage);
+			exit(1);
+		}
+		attach(attachname, &top);
+	} else if (scan) {
+		/* read the directories ourselves */
+		if (argc == 1 || diffmode) {
+			fprintf(stderr, usage);
+			exit(1);
+		}
+		if (estimating && snapname != NULL) {
+			fprintf(stderr, "xdu: -estimate doesn't go with -snapshot\n");
+			exit(1);
+		}
+		scanall(&argv[1], argc-1, snapname);
+	} else if (snapname != NULL && argc == 1 && !diffmode && !estimating) {
+		/* a scan saved before */
+		loadsnap(snapname);
+		scan = 1;
+	} else if (snapname != NULL || estimating) {
+		fprintf(stderr, "xdu: %s only goes with -scan\n",
+			estimating ? "-estimate" : "-snapshot");
+		exit(1);
+	} else if (diffmode) {
+		/* both at once */
+		if (argc != 3) {
+			fprintf(stderr, usage);
+			exit(1);
+		}
+		old.nameid = top.nameid;
+		old.size = -1;
+		addinputs(&argv[1], 1, &old);
+		addinputs(&argv[2], 1, &top);
+	} else if (argc == 1) {
 		if (isatty(fileno(stdin))) {
 			fprintf(stderr, usage);
 			exit(1);
-		} else {
-			parse_file("-");
 		}
-	} else if (argc == 2 && strcmp(argv[1],"-help") != 0) {
-		parse_file(argv[1]);
+		addinputs(stdinput, 1, &top);
 	} else {
-		fprintf(stderr, usage);
-		exit(1);
+		addinputs(&argv[1], argc-1, &top);
+	}
+	if (!scan && histname == NULL && attachname == NULL)
+		readinputs();
+	stats.parsetime += stattime() - t;
+
+	/* the threads that made the new nodes are done with */
+	if (searchbuilt)
+		searchstale = 1;	/* they're not in the index */
+	totalstale = 1;			/* nor in the totals */
+
+	totaltree(&top);
+	if (diffmode) {
+		totaltree(&old);
+		nameranks();	/* it merges lists by name */
+		difftree(&top, &old);
+		totaltree(&top);	/* it has the old tree's nodes now */
 	}
-	top.size = fix_tree(&top);
+
+	/* the display's resources may say to show it otherwise */
+	waitsettled();
+	if (measure != m && measuretree() > 0)
+		totaltree(&top);
+	if (diffmode && order == ORD_DEFAULT)
+		order = ORD_GROWTH;
 
 	/*dumptree(&top,0);*/
-	if (order != ORD_DEFAULT)
+	if (order != ORD_DEFAULT) {
+		t = stattime();
+		nameranks();
 		sorttree(&top, order);
+		stats.sorttime += stattime() - t;
+		stats.sorts++;
+	}
 
 	topp = &top;
 	/* don't display root if only one child */
 	if (numchildren(topp) == 1)
 		topp = topp->child;
+}
+
+/*
+ * How many arguments arg takes up if it is one of load()'s options:
+ * 2 with its value, 1 on its own, 0 if it isn't one
+ */
+int
+loadoption(arg)
+char *arg;
+{
+	static	char	*alone[] = { "-diff", "-scan", "-estimate", NULL };
+	static	char	*withvalue[] = { "-history", "-window", "-attach",
+				"-snapshot", "-checkpoint", "-j", "-maxnodes",
+				"-rate", NULL };
+	int	i;
 
-	xmainloop();
-	exit(0);
+	for (i = 0; alone[i] != NULL; i++)
+		if (strcmp(arg, alone[i]) == 0)
+			return	1;
+	for (i = 0; withvalue[i] != NULL; i++)
+		if (strcmp(arg, withvalue[i]) == 0)
+			return	2;
+	return	0;
 }
 
+/*
+ * Start load() on a thread of its own, with the arguments that are
+ * its, so that the inputs are read while the display is set up.  It
+ * waits for loadsettled() before it sorts the tree.
+ */
 void
-parse_file(filename)
-char *filename;
+loadstart(argc, argv)
+int argc;
+char **argv;
 {
-	char	buf[4096];
-	char	name[4096];
-	int	size;
-	FILE	*fp;
+	loadargc = argc;
+	loadargv = argv;
+	unsettled = 1;
+	if (pthread_create(&loadtid, NULL, loader, NULL) != 0) {
+		fprintf(stderr, "xdu: can't start thread\n");
+		exit(1);
+	}
+}
 
-	if (strcmp(filename, "-") == 0) {
-		fp = stdin;
-	} else {
-		if ((fp = fopen(filename, "r")) == 0) {
-			fprintf(stderr, "xdu: can't open \"%s\"\n", filename);
+static void *
+loader(arg)
+void *arg;
+{
+	load(loadargc, loadargv);
+	return	arg;
+}
+
+/*
+ * The display has set the order and so on from its resources, so the
+ * tree can be got ready to show.  The measure (m) is read all through
+ * a scan, so the loader sets it once it has finished reading.
+ */
+void
+loadsettled(m)
+char *m;
+{
+	pthread_mutex_lock(&settlelock);
+	settledmeasure = m;
+	unsettled = 0;
+	pthread_cond_broadcast(&settledcond);
+	pthread_mutex_unlock(&settlelock);
+}
+
+static void
+waitsettled()
+{
+	pthread_mutex_lock(&settlelock);
+	while (unsettled)
+		pthread_cond_wait(&settledcond, &settlelock);
+	pthread_mutex_unlock(&settlelock);
+	if (settledmeasure != NULL)
+		setmeasure(settledmeasure);
+}
+
+/*
+ * Make sure that the arguments the display's toolkit left are all
+ * ones that were given to loadstart(), then wait for the tree
+ */
+void
+loadfinish(argc, argv)
+int argc;
+char **argv;
+{
+	double	t;
+	int	i, n;
+
+	for (i = 1; i < argc; i++) {
+		if ((n = loadoption(argv[i])) > 1)
+			i++;
+		else if (n == 0 && argv[i][0] == '-' && argv[i][1] != '\0') {
+			fprintf(stderr, usage);
 			exit(1);
 		}
 	}
-	while (fgets(buf,sizeof(buf),fp) != NULL) {
-		sscanf(buf, "%d %s\n", &size, name);
-		/*printf("%d %s\n", size, name);*/
-		parse_entry(name,size);
+	t = stattime();
+	pthread_join(loadtid, NULL);
+	stats.loadwait = stattime() - t;
+}
+
+/*
+ * Read one input into its tree.  This may be running on several
+ * threads at once, one input each, so it only changes the input's
+ * tree and counts.
+ */
+void
+parse_file(ip)
+struct input *ip;
+{
+	char	buf[4096];
+	char	name[4096];
+	long	size;
+	struct	reader	*rp;
+
+	rp = ropen(ip);		/* and unpacks it, if need be */
+	while (rgets(buf,sizeof(buf),rp) != NULL) {
+		ip->readbytes += strlen(buf);
+		ip->lines++;
+		sscanf(buf, "%ld %s\n", &size, name);
+		/*printf("%ld %s\n", size, name);*/
+		parse_entry(name,size,ip);
+		if (ip->budget > 0 && ip->nodes - ip->freed > ip->budget)
+			trim(ip);
 	}
-	fclose(fp);
+	rclose(rp);
+	endtrim(ip);
 }
 
 /* bust up a path string and link it into the tree */
 void
-parse_entry(name,size)
+parse_entry(name,size,ip)
 char *name;
-int size;
+long size;
+struct input *ip;
 {
-	char	*path[MAXDEPTH]; /* break up path into this list */
-	char	buf[MAXNAME];	 /* temp space for path element name */
+	char	*path[MAXDEPTH+1]; /* break up path into this list */
+	char	buf[MAXPATH];	 /* the elements, each null terminated */
 	int	arg, indx;
 	int	length;		/* nelson@reed.edu - trailing / fix */
 
@@ -272,28 +537,46 @@ int size;
 		name[length-1] = 0;
 	}
 
+	/* the elements point into buf, makenode() copies the ones it keeps */
 	arg = 0; indx = 0;
-	bzero(path,sizeof(path));
-	bzero(buf,sizeof(buf));
-	while (*name != NULL) {
+	path[arg++] = buf;
+	while (*name != '\0' && indx < MAXPATH-1) {
 		if (*name == '/') {
-			buf[indx] = 0;
-			path[arg++] = strdup(buf);
-			indx = 0;
+			buf[indx++] = 0;
 			if (arg >= MAXDEPTH)
 				break;
+			path[arg++] = &buf[indx];
 		} else {
 			buf[indx++] = *name;
-			if (indx >= MAXNAME)
-				break;
 		}
 		name++;
 	}
 	buf[indx] = 0;
-	path[arg++] = strdup(buf);
 	path[arg] = NULL;
 
-	addtree(&top,path,size);
+	addtree(ip->rootp,path,size,ip);
+}
+
+/*
+ * What a node is sorted by in one of the orders from totals.c
+ */
+static long
+totalkey(np, order)
+struct node *np;
+int order;
+{
+	switch (order) {
+	case ORD_OWN:
+	case ORD_ROWN:
+		return	np->own;
+	case ORD_FILES:
+	case ORD_RFILES:
+		return	np->files;
+	case ORD_DIRS:
+	case ORD_RDIRS:
+		return	np->dirs;
+	}
+	return	np->depth;
 }
 
 /*
@@ -308,28 +591,57 @@ compare(n1,n2,order)
 struct node *n1, *n2;
 int order;
 {
-	int	ret;
+	long	d1, d2;
 
+	stats.compares++;
 	switch (order) {
 	case ORD_SIZE:
-		ret = n2->size - n1->size;
-		if (ret == 0)
-			return strcmp(n1->name,n2->name);
+		if (n1->size == n2->size)
+			return namecmp(n1->nameid,n2->nameid);
 		else
-			return ret;
+			return (n1->size > n2->size) ? -1 : 1;
 		break;
 	case ORD_RSIZE:
-		ret = n1->size - n2->size;
-		if (ret == 0)
-			return strcmp(n1->name,n2->name);
+		if (n1->size == n2->size)
+			return namecmp(n1->nameid,n2->nameid);
 		else
-			return ret;
+			return (n1->size < n2->size) ? -1 : 1;
 		break;
 	case ORD_ALPHA:
-		return strcmp(n1->name,n2->name);
+		return namecmp(n1->nameid,n2->nameid);
 		break;
 	case ORD_RALPHA:
-		return strcmp(n2->name,n1->name);
+		return namecmp(n2->nameid,n1->nameid);
+		break;
+	case ORD_GROWTH:
+	case ORD_RGROWTH:
+		d1 = (n1->delta < 0) ? -n1->delta : n1->delta;
+		d2 = (n2->delta < 0) ? -n2->delta : n2->delta;
+		if (d1 == d2)
+			return namecmp(n1->nameid,n2->nameid);
+		if (order == ORD_GROWTH)
+			return (d1 > d2) ? -1 : 1;
+		else
+			return (d1 < d2) ? -1 : 1;
+		break;
+	case ORD_OWN:
+	case ORD_ROWN:
+	case ORD_FILES:
+	case ORD_RFILES:
+	case ORD_DIRS:
+	case ORD_RDIRS:
+	case ORD_DEPTH:
+	case ORD_RDEPTH:
+		/* the biggest first, then the other way round */
+		d1 = totalkey(n1, order);
+		d2 = totalkey(n2, order);
+		if (d1 == d2)
+			return namecmp(n1->nameid,n2->nameid);
+		if (order == ORD_OWN || order == ORD_FILES
+		 || order == ORD_DIRS || order == ORD_DEPTH)
+			return (d1 > d2) ? -1 : 1;
+		else
+			return (d1 < d2) ? -1 : 1;
 		break;
 	case ORD_FIRST:
 		/*return -1;*/
@@ -388,34 +700,45 @@ int order;		/* FIRST, LAST, ALPHA, SIZE */
 	np1->peer = childp;
 }
 
-/* add path as a child of top - recursively */
+/*
+ * add path as a child of top - recursively
+ * New children go on the end, in the order they were read: load()
+ * sorts the whole tree afterwards if some other order was asked for.
+ */
 void
-addtree(top, path, size)
+addtree(top, path, size, ip)
 struct node *top;
 char *path[];
-int size;
+long size;
+struct input *ip;	/* being read, for the counts */
 {
-	struct	node *np;
+	struct	node *np, **npp;
 
-	/*printf("addtree(\"%s\",\"%s\",%d)\n", top->name, path[0], size);*/
+	/*printf("addtree(\"%s\",\"%s\",%ld)\n", NAME(top), path[0], size);*/
 
 	/* check all children for a match */
-	for (np = top->child; np != NULL; np = np->peer) {
-		if (strcmp(path[0],np->name) == 0) {
+	for (npp = &top->child; (np = *npp) != NULL; npp = &np->peer) {
+		ip->strcmps++;
+		if (strcmp(path[0],NAME(np)) == 0) {
 			/* name matches */
 			if (path[1] == NULL) {
 				/* end of the chain, save size */
 				np->size = size;
+				if (ip->budget > 0 && np->child != NODE_NULL)
+					finished(np, ip);
 				return;
 			}
+			if (np->hidden > 0)
+				return;	/* collapsed, it's in the size */
 			/* recurse */
-			addtree(np,&path[1],size);
+			addtree(np,&path[1],size,ip);
 			return;
 		}
 	}
 	/* no child matched, add a new child */
-	np = makenode(path[0],-1);
-	insertchild(top,np,order);
+	np = makenode(path[0],-1L,ip);
+	np->parent = top;
+	*npp = np;
 
 	if (path[1] == NULL) {
 		/* end of the chain, save size */
@@ -423,7 +746,7 @@ int size;
 		return;
 	}
 	/* recurse */
-	addtree(np,&path[1],size);
+	addtree(np,&path[1],size,ip);
 	return;
 }
 
@@ -439,7 +762,7 @@ int level;
 	for (i = 0; i < level; i++)
 		printf("   ");
 
-	printf("%s %d\n", np->name, np->size);
+	printf("%s %ld\n", NAME(np), np->size);
 	for (subnp = np->child; subnp != NULL; subnp = subnp->peer) {
 		dumptree(subnp,level+1);
 	}
@@ -482,19 +805,62 @@ int order;
 }
 
 /*
- * Draws a node in the given rectangle, and all of its children
- * to the "right" of the given rectangle.
+ * Drawing Work Queue
+ * The display is drawn breadth first, a tree level at a time, so that
+ * the leftmost columns (or outermost boxes) show up right away and the
+ * deeper levels fill in as time allows.  Each entry holds a node whose
+ * children still have to be drawn, and the rectangle to draw them in.
  */
+struct work {
+	struct	node *node;
+	struct	rect rect;
+};
+struct	work *workq;
+int	workhead, worktail;	/* next entry to draw, next free entry */
+int	workmax;		/* allocated entries */
+
+/*
+ * add a node to the end of the drawing work queue
+ */
+void
+queuedraw(nodep, rect)
+struct node *nodep;
+struct rect rect;
+{
+	if (nodep->child == NODE_NULL)
+		return;		/* nothing to draw */
+
+	if (worktail >= workmax) {
+		workmax = workmax ? 2*workmax : 1024;
+		workq = (struct work *)realloc((char *)workq,
+			workmax * sizeof(struct work));
+		if (workq == NULL) {
+			fprintf(stderr, "xdu: out of memory\n");
+			exit(1);
+		}
+	}
+	workq[worktail].node = nodep;
+	workq[worktail].rect = rect;
+	worktail++;
+}
+
+/*
+ * Draws a node in the given rectangle, and queues all of its
+ * children to be drawn to the "right" of the given rectangle.
+ */
+void
 drawnode(nodep, rect)
 struct node *nodep;	/* node whose children we should draw */
 struct rect rect;	/* rectangle to draw all children in */
 {
 	struct rect subrect;
 
-	/*printf("Drawing \"%s\" %d\n", nodep->name, nodep->size);*/
+	/*printf("Drawing \"%s\" %ld\n", NAME(nodep), nodep->size);*/
 
-	xdrawrect(nodep->name, nodep->size,
+	(*display->drawrect)(NAME(nodep), sizelabel(nodep),
 		rect.left,rect.top,rect.width,rect.height);
+	stats.visits++;
+	stats.boxes++;
 
 	/* save current screen rectangle for lookups */
 	nodep->rect.left = rect.left;
@@ -507,25 +873,26 @@ struct rect rect;	/* rectangle to draw all children in */
 	subrect.top = rect.top;
 	subrect.width = rect.width;
 	subrect.height = rect.height;
-	drawchildren(nodep, subrect);
+	queuedraw(nodep, subrect);
 }
 
 /*
  * Draws all children of a node within the given rectangle.
- * Recurses on children.
+ * Queues the children of each of them to be drawn next.
  */
+void
 drawchildren(nodep, rect)
 struct node *nodep;	/* node whose children we should draw */
 struct rect rect;	/* rectangle to draw all children in */
 {
-	int	totalsize;
+	long	totalsize;
 	int	totalheight;
 	struct	node	*np;
 	double	fractsize;
 	int	height;
 	int	top;
 
-	/*printf("Drawing children of \"%s\", %d\n", nodep->name, nodep->size);*/
+	/*printf("Drawing children of \"%s\", %ld\n", NAME(nodep), nodep->size);*/
 	/*printf("In [%d,%d,%d,%d]\n", rect.left,rect.top,rect.width,rect.height);*/
 
 	top = rect.top;
@@ -541,14 +908,16 @@ struct rect rect;	/* rectangle to draw all children in */
 
 	/* for each child */
 	for (np = nodep->child; np != NULL; np = np->peer) {
+		stats.visits++;
 		fractsize = np->size / (double)totalsize;
 		height = fractsize * totalheight + 0.5;
 		if (height > 1) {
 			struct rect subrect;
-			/*printf("%s, drawrect[%d,%d,%d,%d]\n", np->name,
+			/*printf("%s, drawrect[%d,%d,%d,%d]\n", NAME(np),
 				rect.left,top,rect.width,height);*/
-			xdrawrect(np->name, np->size,
+			(*display->drawrect)(NAME(np), sizelabel(np),
 				rect.left,top,rect.width,height);
+			stats.boxes++;
 
 			/* save current screen rectangle for lookups */
 			np->rect.left = rect.left;
@@ -561,16 +930,171 @@ struct rect rect;	/* rectangle to draw all children in */
 			subrect.top = top;
 			subrect.width = rect.width;
 			subrect.height = height;
-			drawchildren(np, subrect);
+			queuedraw(np, subrect);
 
 			top += height;
 		}
 	}
 }
 
+/*
+ * Draws a node filling the given rectangle, and queues all of its
+ * children to be nested inside of it as a squarified treemap.  A strip
+ * along the top of each box is kept free for its label when there is
+ * room for one.
+ */
+void
+drawtreemap(nodep, rect)
+struct node *nodep;	/* node to draw */
+struct rect rect;	/* rectangle to draw it and its children in */
+{
+	struct	rect subrect;
+	int	label;
+
+	(*display->drawrect)(NAME(nodep), sizelabel(nodep),
+		rect.left,rect.top,rect.width,rect.height);
+	stats.boxes++;
+
+	/* save current screen rectangle for lookups */
+	nodep->rect = rect;
+
+	if (nodep->child == NODE_NULL)
+		return;
+
+	/* leave a margin, and room for the label if it can be shown */
+	label = (*display->textheight)() + 2;
+	if (rect.height < label)
+		label = 2;
+	subrect.left = rect.left + 2;
+	subrect.top = rect.top + label;
+	subrect.width = rect.width - 4;
+	subrect.height = rect.height - label - 2;
+	if (subrect.width < 2 || subrect.height < 2)
+		return;
+	queuedraw(nodep, subrect);
+}
+
+/*
+ * Draws all children of a node as a treemap within the given rectangle.
+ */
+void
+drawtreechildren(nodep, rect)
+struct node *nodep;	/* node whose children we should draw */
+struct rect rect;	/* rectangle to draw all children in */
+{
+	struct	node *np;
+	long	totalsize;
+
+	totalsize = nodep->size;
+	if (totalsize <= 0) {
+		/* total the sizes of the children */
+		totalsize = 0;
+		for (np = nodep->child; np != NULL; np = np->peer)
+			totalsize += np->size;
+		nodep->size = totalsize;
+	}
+	if (totalsize <= 0)
+		return;
+
+	/* the children get a share of our area in proportion to size */
+	squarify(nodep->child, rect,
+		(double)rect.width * rect.height / totalsize);
+}
+
+/*
+ * Lay out a list of peers in the given rectangle, a row at a time,
+ * using the squarified treemap algorithm (Bruls, Huizing and van
+ * Wijk).  Each row runs along the shorter side of the space that is
+ * left and grows for as long as that improves its worst aspect ratio.
+ * Peers are taken in their current sort order, so every one of them is
+ * looked at no more than twice.  Boxes too thin to see aren't drawn.
+ */
+void
+squarify(list, rect, scale)
+struct node *list;	/* first of the peers to lay out */
+struct rect rect;	/* space to lay them out in */
+double scale;		/* pixels of area per unit of size */
+{
+	struct	node	*np, *rowp;
+	struct	rect	subrect;
+	double	x, y, w, h;	/* space that is left */
+	double	side, area, sum, min, max, worst, ratio, thick, pos;
+	int	i0, i1;
+
+	x = rect.left;
+	y = rect.top;
+	w = rect.width;
+	h = rect.height;
+
+	np = list;
+	while (np != NODE_NULL && w >= 1 && h >= 1) {
+		side = (w < h) ? w : h;
+
+		/* grow a row while the worst aspect ratio improves */
+		rowp = np;
+		sum = 0;
+		worst = 0;
+		for (; np != NODE_NULL; np = np->peer) {
+			stats.visits++;
+			if (np->size <= 0)
+				continue;
+			area = np->size * scale;
+			if (sum == 0) {
+				min = max = area;
+			} else {
+				min = (area < min) ? area : min;
+				max = (area > max) ? area : max;
+			}
+			ratio = side*side*max / ((sum+area)*(sum+area));
+			if (ratio < (sum+area)*(sum+area) / (side*side*min))
+				ratio = (sum+area)*(sum+area) / (side*side*min);
+			if (sum > 0 && ratio > worst)
+				break;		/* np starts the next row */
+			sum += area;
+			worst = ratio;
+		}
+		if (sum == 0)
+			break;
+
+		/* lay the row out along the shorter side */
+		thick = sum / side;
+		pos = (w < h) ? x : y;
+		for (; rowp != np; rowp = rowp->peer) {
+			if (rowp->size <= 0)
+				continue;
+			i0 = pos + 0.5;
+			pos += rowp->size * scale / thick;
+			i1 = pos + 0.5;
+			if (w < h) {
+				subrect.left = i0;
+				subrect.width = i1 - i0;
+				subrect.top = y + 0.5;
+				subrect.height = (int)(y + thick + 0.5) - subrect.top;
+			} else {
+				subrect.top = i0;
+				subrect.height = i1 - i0;
+				subrect.left = x + 0.5;
+				subrect.width = (int)(x + thick + 0.5) - subrect.left;
+			}
+			if (subrect.width > 1 && subrect.height > 1)
+				drawtreemap(rowp, subrect);
+		}
+
+		/* and take it away from the space that is left */
+		if (w < h) {
+			y += thick;
+			h -= thick;
+		} else {
+			x += thick;
+			w -= thick;
+		}
+	}
+}
+
 /*
  * clear the rectangle information of a given node
- * and all of its decendents
+ * and all of its decendents.  Nodes that weren't drawn
+ * can't have drawn decendents, so we stop there.
  */
 void
 clearrects(nodep)
@@ -578,7 +1102,7 @@ struct	node *nodep;
 {
 	struct	node	*np;
 
-	if (nodep == NODE_NULL)
+	if (nodep == NODE_NULL || nodep->rect.width == 0)
 		return;
 
 	nodep->rect.left = 0;
@@ -592,6 +1116,92 @@ struct	node *nodep;
 	}
 }
 
+/*
+ * Add delta to the size of a node and of each of its ancestors,
+ * moving each back into its place amongst its siblings if we are
+ * sorted by size.  This is all that changes when one directory does,
+ * so it costs the depth of the tree, not the size of it.
+ */
+void
+resizenode(np, delta)
+struct node *np;
+long delta;
+{
+	struct	node *pp, **npp;
+
+	if (delta == 0)
+		return;
+	for (; np != NODE_NULL; np = pp) {
+		np->size += delta;
+		pp = np->parent;
+		if (pp != NODE_NULL && (order == ORD_SIZE || order == ORD_RSIZE)) {
+			for (npp = &pp->child; *npp != np; npp = &(*npp)->peer)
+				;
+			*npp = np->peer;
+			np->peer = NODE_NULL;
+			insertchild(pp, np, order);
+		}
+	}
+}
+
+/*
+ * free a node and everything below it
+ */
+void
+freetree(np)
+struct node *np;
+{
+	struct	node *subnp, *next;
+
+	for (subnp = np->child; subnp != NODE_NULL; subnp = next) {
+		next = subnp->peer;
+		freetree(subnp);
+	}
+	if (np->dir != NULL) {
+		if (np->dir->links != NULL)
+			free((char *)np->dir->links);
+		clearshares(np->dir);
+		free((char *)np->dir);
+	}
+	free((char *)np);	/* the name stays in the dictionary */
+}
+
+/*
+ * Take a node and everything below it out of the tree, and its size
+ * out of its ancestors'.  If the display was showing any of it, it
+ * backs up to the parent.
+ */
+void
+removenode(np)
+struct node *np;
+{
+	struct	node *pp, **npp;
+
+	for (pp = topp; pp != NODE_NULL; pp = pp->parent) {
+		if (pp == np) {
+			topp = np->parent;
+			break;
+		}
+	}
+	for (pp = drawnp; pp != NODE_NULL; pp = pp->parent) {
+		if (pp == np) {
+			drawnp = NODE_NULL;
+			break;
+		}
+	}
+	workhead = worktail = 0;	/* may have some of it queued */
+	if (searchbuilt)
+		searchstale = 1;	/* the index points into it */
+	totalstale = 1;
+
+	pp = np->parent;
+	resizenode(pp, -np->size);
+	for (npp = &pp->child; *npp != np; npp = &(*npp)->peer)
+		;
+	*npp = np->peer;
+	freetree(np);
+}
+
 pwd()
 {
 	struct node *np;
@@ -614,14 +1224,50 @@ pwd()
 
 	path[0] = '\0';
 	while (--num >= 0) {
-		strcat(path,stack[num]->name);
+		strcat(path,NAME(stack[num]));
 		if (num != 0)
 			strcat(path,"/");
 	}
-	printf("%s %d (%.2f%%)\n", path, topp->size,
+	printf("%s %ld (%.2f%%)\n", path, topp->size,
 		100.0*topp->size/rootp->size);
 }
 
+/*
+ * Return the size of a node as it should be shown: the change
+ * in size, with its sign, in diff mode.  An estimate is marked
+ * with a ~, and its error (two standard deviations) as a percentage.
+ * Or whichever other number from totals.c is being shown instead.
+ */
+char *
+sizelabel(np)
+struct node *np;
+{
+	static	char	buf[64];
+	double	err;
+
+	if (label == LABEL_OWN) {
+		sprintf(buf, "%ld own", np->own);
+	} else if (label == LABEL_FILES) {
+		sprintf(buf, "%ld files", np->files);
+	} else if (label == LABEL_DIRS) {
+		sprintf(buf, "%ld dirs", np->dirs);
+	} else if (label == LABEL_DEPTH) {
+		sprintf(buf, "%d deep", np->depth);
+	} else if (diffmode && histdays > 0) {
+		sprintf(buf, "%+ld, %+ld/day", np->delta, np->delta / histdays);
+	} else if (diffmode) {
+		sprintf(buf, "%+ld", np->delta);
+	} else if (np->dir != NULL && np->dir->var > 0) {
+		err = (np->size > 0) ? 200 * sqrt(np->dir->var) / np->size : 999;
+		sprintf(buf, "~%ld +-%.0f%%", np->size, err < 999 ? err : 999.0);
+	} else {
+		sprintf(buf, "%ld", np->size);
+	}
+	if (np->hidden > 0)
+		strcat(buf, " (collapsed)");	/* see -maxnodes */
+	return	buf;
+}
+
 char *
 strdup(s)
 char *s;
@@ -645,27 +1291,45 @@ int x, y;
 	struct node *np;
 
 	/*printf("press(%d,%d)...\n",x,y);*/
-	np = findnode(&top,x,y);
-	/*printf("Found \"%s\"\n", np?np->name:"(null)");*/
+	np = findnode(topp,x,y);
+	/*printf("Found \"%s\"\n", np?NAME(np):"(null)");*/
 	if (np == topp) {
 		/* already top, go up if possible */
 		if (np->parent != &top || numchildren(&top) != 1)
 			np = np->parent;
-		/*printf("Already top, parent = \"%s\"\n", np?np->name:"(null)");*/
-	}
-	if (np != NODE_NULL) {
-		topp = np;
-		xrepaint();
+		/*printf("Already top, parent = \"%s\"\n", np?NAME(np):"(null)");*/
 	}
+	if (np != NODE_NULL)
+		newtop(np);
 }
 
 int
 reset()
 {
-	topp = &top;
-	if (numchildren(topp) == 1)
-		topp = topp->child;
-	xrepaint();
+	struct node *np;
+
+	np = &top;
+	if (numchildren(np) == 1)
+		np = np->child;
+	newtop(np);
+}
+
+/*
+ * Show the display from np down, moving there
+ * from the old top if the display can
+ */
+static void
+newtop(np)
+struct node *np;
+{
+	struct node *oldtop;
+
+	oldtop = topp;
+	topp = np;
+	if (display->zoom != NULL && oldtop != np)
+		(*display->zoom)(oldtop);
+	else
+		(*display->repaint)();
 }
 
 int
@@ -673,6 +1337,12 @@ repaint(width,height)
 int width, height;
 {
 	struct	rect rect;
+	double	t;
+
+	t = stattime();
+	stats.repaints++;
+	if (label != LABEL_SIZE)
+		totals();	/* the numbers shown */
 
 	/* define a rectangle to draw into */
 	rect.top = 0;
@@ -680,11 +1350,52 @@ int width, height;
 	rect.width = width/ncols;
 	rect.height = height;
 
-	clearrects(&top);	/* clear current rectangle info */
-	drawnode(topp,rect);	/* draw tree into given rectangle */
+	clearrects(drawnp);	/* clear current rectangle info */
+	drawnp = topp;
+	workhead = worktail = 0;	/* forget any unfinished drawing */
+	if (layout == LAYOUT_TREEMAP) {
+		rect.width = width;
+		drawtreemap(topp,rect);
+	} else {
+		drawnode(topp,rect);	/* draw tree into given rectangle */
+	}
 #if 0
 	pwd();			/* display current path */
 #endif
+	stats.drawtime += stattime() - t;
+	return drawmore();
+}
+
+/*
+ * Draw more of the display queued up by repaint(), breadth first,
+ * for up to "budget" milliseconds (or until done if budget is zero).
+ * The first level is always drawn.  Returns non-zero if there is
+ * still more to be drawn, in which case we should be called again.
+ */
+int
+drawmore()
+{
+	struct	work	w;
+	double	start, now;
+	int	first;
+
+	start = now = stattime();
+	first = (workhead == 0);
+	while (workhead < worktail) {
+		w = workq[workhead++];
+		if (layout == LAYOUT_TREEMAP)
+			drawtreechildren(w.node, w.rect);
+		else
+			drawchildren(w.node, w.rect);
+		if (budget > 0 && !first) {
+			now = stattime();
+			if ((now - start) * 1000 >= budget)
+				break;
+		}
+		first = 0;
+	}
+	stats.drawtime += stattime() - start;
+	return (workhead < worktail);
 }
 
 int
@@ -703,6 +1414,45 @@ char *op;
 		order = ORD_FIRST;
 	} else if (strcmp(op, "last") == 0) {
 		order = ORD_LAST;
+	} else if (strcmp(op, "growth") == 0) {
+		order = ORD_GROWTH;
+	} else if (strcmp(op, "rgrowth") == 0) {
+		order = ORD_RGROWTH;
+	} else if (strcmp(op, "own") == 0) {
+		order = ORD_OWN;
+	} else if (strcmp(op, "rown") == 0) {
+		order = ORD_ROWN;
+	} else if (strcmp(op, "files") == 0) {
+		order = ORD_FILES;
+	} else if (strcmp(op, "rfiles") == 0) {
+		order = ORD_RFILES;
+	} else if (strcmp(op, "dirs") == 0) {
+		order = ORD_DIRS;
+	} else if (strcmp(op, "rdirs") == 0) {
+		order = ORD_RDIRS;
+	} else if (strcmp(op, "depth") == 0) {
+		order = ORD_DEPTH;
+	} else if (strcmp(op, "rdepth") == 0) {
+		order = ORD_RDEPTH;
+	} else if (strcmp(op, "label") == 0) {
+		/* by the number shown */
+		switch (label) {
+		case LABEL_SIZE:
+			order = diffmode ? ORD_GROWTH : ORD_SIZE;
+			break;
+		case LABEL_OWN:
+			order = ORD_OWN;
+			break;
+		case LABEL_FILES:
+			order = ORD_FILES;
+			break;
+		case LABEL_DIRS:
+			order = ORD_DIRS;
+			break;
+		case LABEL_DEPTH:
+			order = ORD_DEPTH;
+			break;
+		}
 	} else if (strcmp(op, "reverse") == 0) {
 		switch (order) {
 		case ORD_ALPHA:
@@ -723,6 +1473,24 @@ char *op;
 		case ORD_LAST:
 			order = ORD_FIRST;
 			break;
+		case ORD_GROWTH:
+			order = ORD_RGROWTH;
+			break;
+		case ORD_RGROWTH:
+			order = ORD_GROWTH;
+			break;
+		case ORD_OWN:
+		case ORD_FILES:
+		case ORD_DIRS:
+		case ORD_DEPTH:
+			order++;	/* to the r one after it */
+			break;
+		case ORD_ROWN:
+		case ORD_RFILES:
+		case ORD_RDIRS:
+		case ORD_RDEPTH:
+			order--;
+			break;
 		}
 	} else {
 		fprintf(stderr, "xdu: bad order \"%s\"\n", op);
@@ -733,9 +1501,128 @@ int
 reorder(op)
 char *op;	/* order name */
 {
+	double	t;
+
 	setorder(op);
+	t = stattime();
+	if (order >= ORD_OWN)
+		totals();	/* they sort by those */
+	nameranks();
 	sorttree(topp, order);
-	xrepaint();
+	stats.sorttime += stattime() - t;
+	stats.sorts++;
+	(*display->repaint)();
+}
+
+int
+setlayout(op)
+char *op;
+{
+	if (strcmp(op, "columns") == 0) {
+		layout = LAYOUT_COLUMNS;
+	} else if (strcmp(op, "treemap") == 0) {
+		layout = LAYOUT_TREEMAP;
+	} else if (strcmp(op, "toggle") == 0) {
+		if (layout == LAYOUT_TREEMAP)
+			layout = LAYOUT_COLUMNS;
+		else
+			layout = LAYOUT_TREEMAP;
+	} else {
+		fprintf(stderr, "xdu: bad layout \"%s\"\n", op);
+	}
+}
+
+int
+relayout(op)
+char *op;	/* layout name */
+{
+	setlayout(op);
+	(*display->repaint)();
+}
+
+int
+setlabel(op)
+char *op;
+{
+	if (strcmp(op, "size") == 0) {
+		label = LABEL_SIZE;
+	} else if (strcmp(op, "own") == 0) {
+		label = LABEL_OWN;
+	} else if (strcmp(op, "files") == 0) {
+		label = LABEL_FILES;
+	} else if (strcmp(op, "dirs") == 0) {
+		label = LABEL_DIRS;
+	} else if (strcmp(op, "depth") == 0) {
+		label = LABEL_DEPTH;
+	} else if (strcmp(op, "next") == 0) {
+		label = (label == LABEL_DEPTH) ? LABEL_SIZE : label + 1;
+	} else {
+		fprintf(stderr, "xdu: bad label \"%s\"\n", op);
+	}
+}
+
+int
+relabel(op)
+char *op;	/* label name */
+{
+	setlabel(op);
+	(*display->repaint)();
+}
+
+int
+setmeasure(op)
+char *op;
+{
+	if (strcmp(op, "allocated") == 0) {
+		measure = MEASURE_ALLOCATED;
+	} else if (strcmp(op, "apparent") == 0) {
+		measure = MEASURE_APPARENT;
+	} else if (strcmp(op, "toggle") == 0) {
+		if (measure == MEASURE_APPARENT)
+			measure = MEASURE_ALLOCATED;
+		else
+			measure = MEASURE_APPARENT;
+	} else {
+		fprintf(stderr, "xdu: bad measure \"%s\"\n", op);
+	}
+}
+
+/*
+ * Show the sizes of scanned trees in another measure.  Both were
+ * kept when they were scanned, so it only takes adding them up.
+ */
+int
+remeasure(op)
+char *op;	/* measure name */
+{
+	double	t;
+
+	setmeasure(op);
+	if (measuretree() == 0)
+		return;		/* nothing scanned, so du said it all */
+	totalstale = 1;		/* own sizes changed */
+	if (order == ORD_SIZE || order == ORD_RSIZE) {
+		t = stattime();
+		nameranks();
+		sorttree(&top, order);
+		stats.sorttime += stattime() - t;
+		stats.sorts++;
+	}
+	(*display->repaint)();
+}
+
+/*
+ * Show a node found by name.  One with nothing below it is shown
+ * amongst its siblings, so that there is something to see.
+ */
+int
+gotonode(np)
+struct node *np;
+{
+	if (np->child == NODE_NULL && np->parent != NODE_NULL
+	 && np->parent != &top)
+		np = np->parent;
+	newtop(np);
 }
 
 int
@@ -748,10 +1635,40 @@ nodeinfo()
 
 	/* display each child of this node */
 	for (np = topp->child; np != NULL; np = np->peer) {
-		printf("%-8d %s\n", np->size, np->name);
+		printf("%-8s %s\n", sizelabel(np), NAME(np));
 	}
 }
 
+/*
+ * Print the biggest things anywhere below the current root node
+ */
+int
+topinfo()
+{
+	char	*text;
+
+	pwd();
+	text = toptext(topp);
+	fputs(text, stdout);
+	free(text);
+}
+
+/*
+ * Print the space below the current root node by extension or by
+ * owner (by)
+ */
+int
+breakinfo(by)
+int by;
+{
+	char	*text;
+
+	pwd();
+	text = breaktext(topp, by);
+	fputs(text, stdout);
+	free(text);
+}
+
 int
 helpinfo()
 {
@@ -759,12 +1676,22 @@ helpinfo()
 XDU Version %s - Keyboard Commands\n\
   a  sort alphabetically\n\
   n  sort numerically (largest first)\n\
+  g  sort by amount of change (diff mode)\n\
   f  sort first-in-first-out\n\
   l  sort last-in-first-out\n\
   r  reverse sort\n\
+  t  toggle treemap layout\n\
+  b  toggle apparent and allocated sizes (-scan)\n\
+  c  show size, own size, files, dirs or depth in turn\n\
+  o  sort by what is shown (largest first)\n\
+ ^F  find by name\n\
   /  goto the root\n\
   q  quit (also Escape)\n\
   i  info to standard out\n\
+  k  biggest things below here (K to standard out)\n\
+  e  space by extension below here (E to standard out)\n\
+  u  space by owner below here (U to standard out)\n\
+  p  profiling stats to standard out\n\
 0-9  set number of columns (0=10)\n\
 ", XDU_VERSION);
 }
@@ -0,0 +1,290 @@
+/*
+ * XDU - Definitions shared between the modules.
+ */
+#define	MAXDEPTH	80	/* max elements in a path */
+#define	MAXNAME		1024	/* max pathname element length */
+#define	MAXPATH		4096	/* max total pathname length */
+
+/* order to sort paths by */
+#define	ORD_FIRST	1
+#define	ORD_LAST	2
+#define	ORD_ALPHA	3
+#define	ORD_SIZE	4
+#define	ORD_RALPHA	5
+#define	ORD_RSIZE	6
+#define	ORD_GROWTH	7	/* biggest change first (diff mode) */
+#define	ORD_RGROWTH	8
+#define	ORD_OWN		9	/* biggest own size first, see totals.c */
+#define	ORD_ROWN	10
+#define	ORD_FILES	11	/* most files below first */
+#define	ORD_RFILES	12
+#define	ORD_DIRS	13	/* most directories below first */
+#define	ORD_RDIRS	14
+#define	ORD_DEPTH	15	/* most levels below first */
+#define	ORD_RDEPTH	16
+#define	ORD_DEFAULT	ORD_FIRST
+
+/* how to lay out the display */
+#define	LAYOUT_COLUMNS	1	/* one column per tree level */
+#define	LAYOUT_TREEMAP	2	/* nested squarified rectangles */
+
+/* label choices: what number is shown with each name */
+#define	LABEL_SIZE	1	/* from here down (or the change, diffing) */
+#define	LABEL_OWN	2	/* less that of the children */
+#define	LABEL_FILES	3
+#define	LABEL_DIRS	4
+#define	LABEL_DEPTH	5
+
+/* what to break a subtree's space down by, see breakdown.c */
+#define	BY_EXT		0	/* extension of the file name */
+#define	BY_OWNER	1	/* user the file belongs to */
+#define	NBY		2
+
+/* what of a scanned directory is only estimated */
+#define	EST_FILES	1	/* files only sampled */
+#define	EST_UNREAD	2	/* not read at all, like its neighbours */
+
+/* what the size of a scanned file is */
+#define	MEASURE_ALLOCATED 1	/* space on the disk, as du gives */
+#define	MEASURE_APPARENT  2	/* length of the data */
+
+/*
+ * Rectangle Structure
+ * Stores window coordinates of a displayed rectangle
+ * so that we can "find" it again on key presses.
+ */
+struct rect {
+	int	left;
+	int	top;
+	int	width;
+	int	height;
+};
+
+/*
+ * Node Structure
+ * Each node in the path tree is linked in with one of these.
+ */
+struct node {
+	unsigned int nameid;	/* in the dictionary, see NAME() */
+	int	depth;		/* levels below it */
+	long	size;		/* from here down in the tree */
+	long	own;		/* size less that of the children (see collapse.c) */
+	long	files;		/* files from here down */
+	long	dirs;		/* directories below here */
+	long	num;		/* entry number - for resorting */
+	long	delta;		/* change from the old tree (diff mode) */
+	long	hidden;		/* nodes let go from below it (collapse.c) */
+	struct	rect rect;	/* last drawn screen rectangle */
+	struct	node *peer;	/* siblings */
+	struct	node *child;	/* list of children if !NULL */
+	struct	node *parent;	/* backpointer to parent */
+	struct	dir *dir;	/* if we read the directory ourselves */
+};
+#define	NODE_NULL ((struct node *)0)
+
+/*
+ * Names are kept once each in a dictionary (names.c), in chunks of
+ * NAMECHUNK that never move.  NAME() is the name of a node.
+ */
+#define	NAMESHIFT	16
+#define	NAMECHUNK	(1 << NAMESHIFT)
+#define	NAMEMASK	(NAMECHUNK - 1)
+#define	NAMECHUNKS	65536		/* so as many names as there are ids */
+#define	namestr(id)	(namestrs[(id) >> NAMESHIFT][(id) & NAMEMASK])
+#define	NAME(np)	namestr((np)->nameid)
+
+/*
+ * Share Structure
+ * Space in a directory taken by the files of one kind: those with
+ * one extension, or those of one owner.
+ */
+struct share {
+	unsigned int key;	/* name number of the extension, or uid */
+	long	own;		/* kilobytes allocated */
+	long	bytes;		/* apparent size */
+};
+#define	KEY_NONE	0xffffffffU	/* no extension */
+#define	KEY_OTHER	0xfffffffeU	/* not in any file known of */
+
+/*
+ * Directory Link Structure
+ * A file with more than one link, counted in a directory
+ */
+struct dirlink {
+	unsigned long dev;
+	unsigned long ino;
+	long	own;		/* what it added to the directory */
+	long	bytes;
+	unsigned int ext;	/* its extension and owner, see breakdown.c */
+	unsigned int uid;
+};
+
+/*
+ * Directory Structure
+ * What the scanner (scan.c) keeps about a directory that it read
+ * itself, so that it can read just that directory again later.
+ */
+struct dir {
+	long	own;		/* kilobytes in it, not counting subdirectories */
+	long	bytes;		/* apparent size of the same */
+	long	files;		/* files counted in it */
+	struct	share *shares[NBY];	/* them by extension and by owner */
+	int	nshares[NBY];
+	struct	dirlink *links;	/* files with more than one link it counted */
+	int	nlinks;
+	char	est;		/* what is estimated, see estimate.c */
+	double	ownvar;		/* variance of the estimate of own */
+	double	var;		/* the same, for everything below too */
+	unsigned long ino;	/* as it was when read, to tell if it changed */
+	long	mtime;
+	long	ctime;
+	int	wd;		/* inotify watch on it, or -1 */
+	char	dirty;		/* waiting to be read again */
+	char	gone;		/* deleted or replaced since it was read */
+	long	checkid;	/* its number in the checkpoint log */
+	char	unread;		/* in it, but not read yet (checkpoint.c) */
+	char	kept;		/* read back from it for this scan */
+};
+
+/*
+ * Input Structure
+ * One du output being read.  The parser keeps everything it changes
+ * in here, so that any number of inputs can be read at once.
+ */
+struct input {
+	char	*filename;	/* "-" for standard input */
+	long	bytes;		/* its size, -1 if unknown */
+	struct	node *destp;	/* tree it is read into */
+	struct	node *rootp;	/* destp, or a node for its host */
+	long	readbytes;	/* counts, added to the stats after */
+	long	lines;
+	long	nodes;
+	long	strcmps;
+	long	budget;		/* nodes it may keep, see collapse.c */
+	long	freed;		/* nodes let go to keep to it */
+	long	collapsed;	/* directories they were let go from */
+	struct	done *done;	/* directories finished, smallest first */
+	long	ndone, maxdone;
+	long	unpacked;	/* bytes uncompressed (unpack.c) */
+	double	unpacktime;	/* seconds uncompressing them */
+	double	unpackwait;	/* seconds the parser waited for them */
+};
+
+/*
+ * Display Structure
+ * What xdu.c draws on: the X window (xwin.c), an image
+ * file (render.c), or nothing at all (bench.c).
+ */
+struct display {
+	int	(*drawrect)();		/* draw a box, with name and size */
+	int	(*textheight)();	/* height of a label */
+	int	(*repaint)();		/* clear and draw it all again */
+	int	(*zoom)();		/* move to a new top, NULL if it can't */
+};
+
+/* xdu.c */
+extern struct node top, *topp;
+extern struct display *display;
+extern int order, layout, label, ncols, budget, diffmode;
+extern void load(), parse_file();
+extern void loadstart(), loadsettled(), loadfinish();
+extern int loadoption();
+extern void insertchild(), resizenode(), removenode();
+extern struct node *makenode(), *findnode();
+extern char *sizelabel();
+extern int repaint(), drawmore(), setorder(), setlayout(), setmeasure();
+extern int setlabel();
+extern int gotonode();
+extern void sorttree();
+
+/* input.c */
+extern int nthreads;
+extern void addinputs(), readinputs();
+
+/* collapse.c */
+extern long nodebudget;
+extern void finished(), trim(), endtrim();
+
+/* names.c */
+extern char **namestrs[];
+extern unsigned int nnames;
+extern unsigned int intern();
+extern int namecmp();
+extern void nameranks();
+extern int utf8len();
+
+/* totals.c */
+extern int totalstale;
+extern long totalgen;
+extern void totaltree(), totals(), subtotal();
+extern long cuttree();
+
+/* breakdown.c */
+extern unsigned int extkey();
+extern void addshare(), clearshares();
+extern struct share *breakdown();
+extern char *breaktext(), *keyname();
+
+/* unpack.c */
+extern struct reader *ropen();
+extern char *rgets();
+extern void rclose();
+
+/* scan.c */
+extern int measure;
+extern void scanall();
+extern struct node *scantree(), *newdir();
+extern void rescandir(), releasetree(), loadsnap();
+extern int measuretree();
+extern long sizetree();
+
+/* checkpoint.c */
+extern char *checkname;
+extern long checkopen(), checkid();
+extern struct node *checkresume();
+extern struct checkbuf *checkbuf();
+extern void checktop(), checkdir(), checkfree(), checkdone();
+
+/* estimate.c */
+extern int estimating;
+extern void estimateall(), unestimate(), dropestimate();
+extern int estimateupdate();
+extern char *nodepath();
+
+/* search.c */
+extern int searchbuilt, searchstale;
+extern int searchmore(), searchfind();
+extern char *searchpath();
+
+/* topk.c */
+extern int topk;
+extern int topfind();
+extern char *toptext();
+extern long ownsize();
+
+/* rate.c */
+extern long ratelimit;
+extern void ratestart();
+extern double ratepace(), ratewait();
+extern int ratethreads();
+
+/* watch.c */
+extern int watchflag;
+extern int watchstart(), watchupdate();
+extern void watchread(), watchtree(), unwatchtree();
+
+/* history.c */
+extern int histdays;
+extern void loadhistory();
+
+/* zoom.c */
+extern int zoomstart();
+extern void zoomframe();
+
+/* serve.c */
+extern int attached;
+extern void attach();
+extern int attachupdate();
+
+/* diff.c */
+extern void difftree();
@@ -3,6 +3,10 @@
  *
  * We hide all of the X hieroglyphics inside of this module.
  *
+ * Everything is drawn into a pixmap the size of the window, then
+ * copied onto it, so the window never shows a half drawn display,
+ * and when part of it is uncovered it is copied again, not redrawn.
+ *
  * Phillip C. Dykstra
  * <phil@arl.mil>
  * 4 Sep 1991.
@@ -27,8 +31,12 @@
 #include <X11/Xaw/AsciiSrc.h>
 #include <X11/Xaw/Form.h>
 #include <X11/Xaw/Label.h>
+#include <X11/Xaw/List.h>
 
 #include <stdio.h>
+#include <string.h>
+#include "xdu.h"
+#include "stats.h"
 
 #ifndef X_NOT_STDC_ENV
 #include <stdlib.h>	/* for exit() */
@@ -40,21 +48,60 @@ extern int reset();
 extern int repaint();
 extern int reorder();
 extern int setorder();
+extern int relayout();
+extern int setlayout();
+extern int remeasure();
+extern int setmeasure();
+extern int relabel();
+extern int setlabel();
+extern int drawmore();
 extern int nodeinfo();
+extern int topinfo();
+extern int breakinfo();
 extern int helpinfo();
+extern int gotonode();
+extern int zoomstart();
+extern void zoomframe();
 extern int ncols;
+extern int budget;
+extern int layout;
 
 /* EXPORTS: routines that this module exports outside */
 extern int xsetup();
+extern int xoption();
 extern int xmainloop();
 extern int xclear();
 extern int xrepaint();
 extern int xrepaint_noclear();
+extern int xzoom();
 extern int xdrawrect();
+extern int xtextheight();
+extern struct display xdisplay;
 
 /* internal routines */
 static void help_popup();
 static void help_popdown();
+static void text_popup();
+static void text_popdown();
+static void find_popup();
+static void find_popdown();
+static void find_refresh();
+static void startsearch();
+static Boolean w_drawmore();
+static Boolean w_search();
+static void i_watch();
+static void t_watch();
+static void t_refine();
+static void t_attach();
+static void t_zoom();
+static void stopzoom();
+static void clearback();
+static void showback();
+static void firstpaint();
+
+#define	REFINEINTERVAL	250	/* msec between making estimates exact */
+#define	ZOOMFRAME	16	/* msec between frames, about 60 a second */
+#define	MAXFOUND	20	/* names found to list */
 
 static String fallback_resources[] = {
 "*window.width:		600",
@@ -73,6 +120,15 @@ typedef struct {
 	int	ncol;
 	Boolean	showsize;
 	char	*order;
+	char	*layout;
+	char	*measure;
+	char	*label;
+	int	budget;
+	Boolean	stats;
+	Boolean	watch;
+	int	watchinterval;
+	int	top;
+	int	zoomtime;
 } res_data, *res_data_ptr;
 static res_data res;
 
@@ -88,7 +144,25 @@ static XtResource application_resources[] = {
 	{ "showsize", "ShowSize", XtRBoolean, sizeof(Boolean),
 		XtOffset(res_data_ptr,showsize), XtRString, "True"},
 	{ "order", "Order", XtRString, sizeof(String),
-		XtOffset(res_data_ptr,order), XtRString, "first"}
+		XtOffset(res_data_ptr,order), XtRString, "first"},
+	{ "layout", "Layout", XtRString, sizeof(String),
+		XtOffset(res_data_ptr,layout), XtRString, "columns"},
+	{ "measure", "Measure", XtRString, sizeof(String),
+		XtOffset(res_data_ptr,measure), XtRString, "allocated"},
+	{ "label", "Label", XtRString, sizeof(String),
+		XtOffset(res_data_ptr,label), XtRString, "size"},
+	{ "budget", "Budget", XtRInt, sizeof(int),
+		XtOffset(res_data_ptr,budget), XtRString, "20"},
+	{ "stats", "Stats", XtRBoolean, sizeof(Boolean),
+		XtOffset(res_data_ptr,stats), XtRString, "False"},
+	{ "watch", "Watch", XtRBoolean, sizeof(Boolean),
+		XtOffset(res_data_ptr,watch), XtRString, "False"},
+	{ "watchInterval", "WatchInterval", XtRInt, sizeof(int),
+		XtOffset(res_data_ptr,watchinterval), XtRString, "500"},
+	{ "top", "Top", XtRInt, sizeof(int),
+		XtOffset(res_data_ptr,top), XtRString, "100"},
+	{ "zoomTime", "ZoomTime", XtRInt, sizeof(int),
+		XtOffset(res_data_ptr,zoomtime), XtRString, "200"}
 };
 
 /* Command Line Options */
@@ -99,9 +173,21 @@ static XrmOptionDescRec options[] = {
 	{"-n",		"*order",	XrmoptionNoArg,		"size"},
 	{"-rn",		"*order",	XrmoptionNoArg,		"rsize"},
 	{"-a",		"*order",	XrmoptionNoArg,		"alpha"},
-	{"-ra",		"*order",	XrmoptionNoArg,		"ralpha"}
+	{"-ra",		"*order",	XrmoptionNoArg,		"ralpha"},
+	{"-t",		"*layout",	XrmoptionNoArg,		"treemap"},
+	{"+t",		"*layout",	XrmoptionNoArg,		"columns"},
+	{"-apparent",	"*measure",	XrmoptionNoArg,		"apparent"},
+	{"-label",	"*label",	XrmoptionSepArg,	NULL},
+	{"-stats",	"*stats",	XrmoptionNoArg,		"True"},
+	{"-watch",	"*watch",	XrmoptionNoArg,		"True"},
+	{"-top",	"*top",		XrmoptionSepArg,	NULL},
+	{"-zoom",	"*zoomTime",	XrmoptionSepArg,	NULL}
 };
 
+/* what the find popup is showing */
+static struct node *found[MAXFOUND];
+static int nfound;
+
 /* action routines */
 static void a_goto();
 static void a_reset();
@@ -109,9 +195,19 @@ static void a_quit();
 static void a_reorder();
 static void a_size();
 static void a_ncol();
+static void a_layout();
+static void a_measure();
+static void a_label();
 static void a_info();
+static void a_top();
+static void a_breakdown();
+static void a_removetop();
+static void a_stats();
 static void a_help();
 static void a_removehelp();
+static void a_find();
+static void a_findgo();
+static void a_removefind();
 
 static XtActionsRec actionsTable[] = {
 	{ "reset",	a_reset },
@@ -120,9 +216,19 @@ static XtActionsRec actionsTable[] = {
 	{ "reorder",	a_reorder },
 	{ "size",	a_size },
 	{ "ncol",	a_ncol },
+	{ "layout",	a_layout },
+	{ "measure",	a_measure },
+	{ "label",	a_label },
 	{ "info",	a_info },
+	{ "top",	a_top },
+	{ "breakdown",	a_breakdown },
+	{ "RemoveTop",	a_removetop },
+	{ "stats",	a_stats },
 	{ "help",	a_help },
-	{ "RemoveHelp",	a_removehelp }
+	{ "RemoveHelp",	a_removehelp },
+	{ "find",	a_find },
+	{ "FindGo",	a_findgo },
+	{ "RemoveFind",	a_removefind }
 };
 
 static char defaultTranslations[] = "\
@@ -131,14 +237,27 @@ static char defaultTranslations[] = "\
 :<Key>/: reset()\n\
 <Key>S:	size()\n\
 <Key>I:	info()\n\
+:<Key>K: top(print)\n\
+<Key>K:	top(popup)\n\
+:<Key>E: breakdown(ext,print)\n\
+<Key>E:	breakdown(ext,popup)\n\
+:<Key>U: breakdown(owner,print)\n\
+<Key>U:	breakdown(owner,popup)\n\
+<Key>P:	stats()\n\
 <Key>H: help()\n\
 <Key>Help: help()\n\
 :<Key>?: help()\n\
+Ctrl<Key>F: find()\n\
 <Key>A:	reorder(alpha)\n\
 <Key>N:	reorder(size)\n\
+<Key>G:	reorder(growth)\n\
 <Key>F:	reorder(first)\n\
 <Key>L:	reorder(last)\n\
 <Key>R:	reorder(reverse)\n\
+<Key>T:	layout(toggle)\n\
+<Key>B:	measure(toggle)\n\
+<Key>C:	label(next)\n\
+<Key>O:	reorder(label)\n\
 <Key>1:	ncol(1)\n\
 <Key>2:	ncol(2)\n\
 <Key>3:	ncol(3)\n\
@@ -231,6 +350,45 @@ Cardinal *num_params;
 	xrepaint();
 }
 
+static void a_layout(w, event, params, num_params)
+Widget w;
+XEvent *event;
+String *params;
+Cardinal *num_params;
+{
+	if (*num_params != 1) {
+		fprintf(stderr, "xdu: bad number of params to layout action\n");
+	} else {
+		relayout(*params);
+	}
+}
+
+static void a_measure(w, event, params, num_params)
+Widget w;
+XEvent *event;
+String *params;
+Cardinal *num_params;
+{
+	if (*num_params != 1) {
+		fprintf(stderr, "xdu: bad number of params to measure action\n");
+	} else {
+		remeasure(*params);
+	}
+}
+
+static void a_label(w, event, params, num_params)
+Widget w;
+XEvent *event;
+String *params;
+Cardinal *num_params;
+{
+	if (*num_params != 1) {
+		fprintf(stderr, "xdu: bad number of params to label action\n");
+	} else {
+		relabel(*params);
+	}
+}
+
 static void a_info(w, event, params, num_params)
 Widget w;
 XEvent *event;
@@ -240,6 +398,74 @@ Cardinal *num_params;
 	nodeinfo();
 }
 
+static void a_top(w, event, params, num_params)
+Widget w;
+XEvent *event;
+String *params;
+Cardinal *num_params;
+{
+	char	title[64];
+
+	if (*num_params != 1) {
+		fprintf(stderr, "xdu: bad number of params to top action\n");
+	} else if (strcmp(*params, "print") == 0) {
+		topinfo();
+	} else if (strcmp(*params, "popup") == 0) {
+		sprintf(title, "XDU Biggest %d", topk);
+		text_popup(title, toptext(topp));
+	} else {
+		fprintf(stderr, "xdu: bad value to top action\n");
+	}
+}
+
+static void a_breakdown(w, event, params, num_params)
+Widget w;
+XEvent *event;
+String *params;
+Cardinal *num_params;
+{
+	int	by;
+
+	if (*num_params != 2) {
+		fprintf(stderr, "xdu: bad number of params to breakdown action\n");
+		return;
+	}
+	if (strcmp(params[0], "ext") == 0) {
+		by = BY_EXT;
+	} else if (strcmp(params[0], "owner") == 0) {
+		by = BY_OWNER;
+	} else {
+		fprintf(stderr, "xdu: bad value to breakdown action\n");
+		return;
+	}
+	if (strcmp(params[1], "print") == 0) {
+		breakinfo(by);
+	} else if (strcmp(params[1], "popup") == 0) {
+		text_popup(by == BY_EXT ? "XDU By Extension" : "XDU By Owner",
+			breaktext(topp, by));
+	} else {
+		fprintf(stderr, "xdu: bad value to breakdown action\n");
+	}
+}
+
+static void a_removetop(w, event, params, num_params)
+Widget w;
+XEvent *event;
+String *params;
+Cardinal *num_params;
+{
+	text_popdown();
+}
+
+static void a_stats(w, event, params, num_params)
+Widget w;
+XEvent *event;
+String *params;
+Cardinal *num_params;
+{
+	statsinfo();
+}
+
 static void a_help(w, event, params, num_params)
 Widget w;
 XEvent *event;
@@ -259,6 +485,35 @@ Cardinal *num_params;
 	help_popdown();
 }
 
+static void a_find(w, event, params, num_params)
+Widget w;
+XEvent *event;
+String *params;
+Cardinal *num_params;
+{
+	find_popup();
+}
+
+static void a_findgo(w, event, params, num_params)
+Widget w;
+XEvent *event;
+String *params;
+Cardinal *num_params;
+{
+	/* to the biggest of them */
+	if (nfound > 0)
+		gotonode(found[0]);
+}
+
+static void a_removefind(w, event, params, num_params)
+Widget w;
+XEvent *event;
+String *params;
+Cardinal *num_params;
+{
+	find_popdown();
+}
+
 /* callback routines */
 
 static void c_resize(w, data, event, continue_to_dispatch)
@@ -289,10 +544,168 @@ static Visual *vis;
 static Window win;
 static GC gc;
 static GC cleargc;
+static Pixmap back;		/* what is drawn, to copy onto win */
+static int backwidth, backheight;
+static int depth;
 static XtAppContext app_con;
+static XtWorkProcId drawid;	/* non-zero while drawing is unfinished */
+static XtWorkProcId searchid;	/* non-zero while indexing names */
+static XtIntervalId zoomid;	/* non-zero while moving to a new view */
+static double zoomstarted;
 
 Widget toplevel;
 
+/* how xdu.c gets at us */
+struct display xdisplay = { xdrawrect, xtextheight, xrepaint, xzoom };
+
+/* work procedures */
+
+/*
+ * Draw the next slice of a display that didn't fit in one frame.
+ * Xt only calls us when there are no events waiting, and a new
+ * repaint() starts over, so navigating cancels the old drawing.
+ */
+static Boolean w_drawmore(data)
+XtPointer data;
+{
+	unsigned long	req;
+	int	more;
+
+	req = NextRequest(dpy);
+	more = drawmore();
+	showback();
+	stats.lastxrequests += NextRequest(dpy) - req;
+	stats.xrequests += NextRequest(dpy) - req;
+	if (more) {
+		XFlush(dpy);
+		return False;	/* call us again */
+	}
+	drawid = 0;
+	startsearch();
+	return True;		/* done, remove us */
+}
+
+/*
+ * Index some more names for finding (see search.c).  Drawing comes
+ * first: when there is some to do, we stop, and are started again
+ * when it is done.
+ */
+static Boolean w_search(data)
+XtPointer data;
+{
+	if (drawid == 0 && searchmore(budget))
+		return False;	/* call us again */
+	searchid = 0;
+	return True;		/* done, remove us */
+}
+
+static void
+startsearch()
+{
+	if (searchid == 0 && drawid == 0)
+		searchid = XtAppAddWorkProc(app_con, w_search, NULL);
+}
+
+/* input and timer callbacks */
+
+/*
+ * inotify events are waiting: note which directories changed
+ */
+static void i_watch(data, source, id)
+XtPointer data;
+int *source;
+XtInputId *id;
+{
+	watchread();
+}
+
+/*
+ * Read the changed directories again, and show the result.  Runs
+ * every watchInterval msec, however often things change, so that
+ * a storm of changes can't keep us repainting.
+ */
+static void t_watch(data, id)
+XtPointer data;
+XtIntervalId *id;
+{
+	if (watchupdate() > 0) {
+		find_refresh();
+		xrepaint();
+	}
+	XtAppAddTimeOut(app_con, res.watchinterval, t_watch, NULL);
+}
+
+/*
+ * Make some of the estimates exact (see estimate.c), and show
+ * the result.  Runs until there are none left.
+ */
+static void t_refine(data, id)
+XtPointer data;
+XtIntervalId *id;
+{
+	if (estimateupdate() > 0) {
+		find_refresh();
+		xrepaint();
+	}
+	if (estimating)
+		XtAppAddTimeOut(app_con, REFINEINTERVAL, t_refine, NULL);
+}
+
+/*
+ * Swap in the tree the server has published since, if it has (see
+ * serve.c).  Runs for as long as the server is there.
+ */
+static void t_attach(data, id)
+XtPointer data;
+XtIntervalId *id;
+{
+	if (attachupdate() > 0) {
+		find_refresh();
+		xrepaint();
+	}
+	if (attached)
+		XtAppAddTimeOut(app_con, res.watchinterval, t_attach, NULL);
+}
+
+/*
+ * Draw the next frame of the move to a new view, or once
+ * zoomTime msec have gone by, the new view itself
+ */
+static void t_zoom(data, id)
+XtPointer data;
+XtIntervalId *id;
+{
+	double	now, f;
+	int	next;
+
+	now = stattime();
+	f = (now - zoomstarted) * 1000 / res.zoomtime;
+	if (f >= 1) {
+		zoomid = 0;
+		xrepaint();
+		return;
+	}
+	clearback(backwidth, backheight);
+	zoomframe(f);
+	showback();
+	XFlush(dpy);
+
+	/* the next one a frame after this one started */
+	next = ZOOMFRAME - (stattime() - now) * 1000;
+	if (next < 1)
+		next = 1;
+	zoomid = XtAppAddTimeOut(app_con, next, t_zoom, NULL);
+}
+
+static void
+stopzoom()
+{
+	if (zoomid != 0) {
+		XtRemoveTimeOut(zoomid);
+		zoomid = 0;
+	}
+}
+
 /*  External Functions  */
 
 int
@@ -305,8 +718,10 @@ char **argv;
 	XGCValues gcv;
 	int n;
 	Arg args[5];
+	double t;
 
 	/* Create the top level Widget */
+	t = stattime();
 	n = 0;
 	XtSetArg(args[n], XtNtitle, "XDU Disk Usage Display ('h' for help)\n"); n++;
 	toplevel = XtAppInitialize(&app_con, "XDu",
@@ -318,6 +733,19 @@ char **argv;
 		application_resources, XtNumber(application_resources),
 		NULL, 0 );
 
+	setorder(res.order);
+	setlayout(res.layout);
+	setlabel(res.label);
+	ncols = res.ncol;
+	budget = res.budget;
+	statsflag = res.stats;
+	watchflag = res.watch;
+	if (res.top > 0)
+		topk = res.top;
+	if (res.watchinterval < 1)
+		res.watchinterval = 1;
+	loadsettled(res.measure);	/* the tree can be sorted meanwhile */
+
 	XtAppAddActions(app_con, actionsTable, XtNumber(actionsTable));
 	trans_table = XtParseTranslationTable(defaultTranslations);
 
@@ -343,43 +771,202 @@ char **argv;
 	gcv.foreground = res.foreground;
 	gcv.background = res.background;
 	gcv.font = res.font->fid;
-	gc = XCreateGC(dpy, win, (GCFont|GCForeground|GCBackground), &gcv);
+	gcv.graphics_exposures = False;		/* copying the pixmap */
+	gc = XCreateGC(dpy, win,
+		(GCFont|GCForeground|GCBackground|GCGraphicsExposures), &gcv);
+	gcv.foreground = res.background;
+	cleargc = XCreateGC(dpy, win, GCForeground, &gcv);
 
-	setorder(res.order);
-	ncols = res.ncol;
+	/* the pixmap covers all of it, so the server needn't clear it first */
+	XSetWindowBackgroundPixmap(dpy, win, None);
+	depth = DefaultDepth(dpy, screen);
+	stats.xsetuptime = stattime() - t;
+}
+
+/*
+ * How many arguments arg takes up if it is an option of ours or of the
+ * toolkit's: 2 with its value, 1 on its own, 0 if it isn't one.  As
+ * with the toolkit, an abbreviation will do if there's no mistaking it.
+ */
+int
+xoption(arg)
+char *arg;
+{
+	static	struct	{
+		char	*name;
+		int	n;
+	} xtoptions[] = {
+		{ "-background", 2 },	{ "-bd", 2 },	{ "-bg", 2 },
+		{ "-bordercolor", 2 },	{ "-borderwidth", 2 },
+		{ "-bw", 2 },		{ "-display", 2 },
+		{ "-fg", 2 },		{ "-fn", 2 },	{ "-font", 2 },
+		{ "-foreground", 2 },	{ "-geometry", 2 },
+		{ "-iconic", 1 },	{ "-name", 2 },	{ "-reverse", 1 },
+		{ "-rv", 1 },		{ "+rv", 1 },
+		{ "-selectionTimeout", 2 },
+		{ "-synchronous", 1 },	{ "+synchronous", 1 },
+		{ "-title", 2 },	{ "-xnllanguage", 2 },
+		{ "-xrm", 2 },		{ "-xtsessionID", 2 }
+	};
+	int	i, len, n, found;
+
+	for (i = 0; i < XtNumber(options); i++)
+		if (strcmp(arg, options[i].option) == 0)
+			return	(options[i].argKind == XrmoptionSepArg) ? 2 : 1;
+	for (i = 0; i < XtNumber(xtoptions); i++)
+		if (strcmp(arg, xtoptions[i].name) == 0)
+			return	xtoptions[i].n;
+
+	len = strlen(arg);
+	if (len < 2)
+		return	0;
+	n = 0;
+	found = 0;
+	for (i = 0; i < XtNumber(options); i++) {
+		if (strncmp(arg, options[i].option, len) == 0) {
+			n = (options[i].argKind == XrmoptionSepArg) ? 2 : 1;
+			found++;
+		}
+	}
+	for (i = 0; i < XtNumber(xtoptions); i++) {
+		if (strncmp(arg, xtoptions[i].name, len) == 0) {
+			n = xtoptions[i].n;
+			found++;
+		}
+	}
+	return	(found == 1) ? n : 0;
 }
 
 xmainloop()
 {
+	int	fd;
+
+	if (watchflag && (fd = watchstart()) >= 0) {
+		XtAppAddInput(app_con, fd, (XtPointer)XtInputReadMask,
+			i_watch, NULL);
+		XtAppAddTimeOut(app_con, res.watchinterval, t_watch, NULL);
+	}
+	if (estimating)
+		XtAppAddTimeOut(app_con, REFINEINTERVAL, t_refine, NULL);
+	if (attached)
+		XtAppAddTimeOut(app_con, res.watchinterval, t_attach, NULL);
+	startsearch();
 	XtAppMainLoop(app_con);
 	return(0);
 }
 
 xclear()
 {
-	XClearWindow(dpy, win);
+	clearback(backwidth, backheight);
+	showback();
 }
 
 xrepaint()
 {
 	XWindowAttributes xwa;
+	unsigned long	req;
+	int	more;
 
-	XClearWindow(dpy, win);
+	stopzoom();
+	req = NextRequest(dpy);
 	XGetWindowAttributes(dpy, win, &xwa);
-	repaint(xwa.width, xwa.height);
+	clearback(xwa.width, xwa.height);
+	more = repaint(xwa.width, xwa.height);
+	showback();
+	stats.lastxrequests = NextRequest(dpy) - req;
+	stats.xrequests += stats.lastxrequests;
+	firstpaint();
+	if (more && drawid == 0)
+		drawid = XtAppAddWorkProc(app_con, w_drawmore, NULL);
+	else if (!more)
+		startsearch();
 }
 
+/*
+ * Put what is drawn back on the window, after it was uncovered
+ */
 xrepaint_noclear()
+{
+	if (back == None)
+		xrepaint();	/* nothing drawn yet */
+	else
+		showback();
+}
+
+/*
+ * The top just changed from oldtop: move the boxes to the new
+ * view a frame at a time, if there is a way to
+ */
+xzoom(oldtop)
+struct node *oldtop;
 {
 	XWindowAttributes xwa;
 
+	stopzoom();
+	if (drawid != 0) {
+		XtRemoveWorkProc(drawid);	/* the old view, unfinished */
+		drawid = 0;
+	}
 	XGetWindowAttributes(dpy, win, &xwa);
-	repaint(xwa.width, xwa.height);
+	if (res.zoomtime <= 0 || back == None
+	 || !zoomstart(oldtop, xwa.width, xwa.height)) {
+		xrepaint();
+		return;
+	}
+	zoomstarted = stattime();
+	t_zoom(NULL, NULL);
+}
+
+/*
+ * Make sure the pixmap is width by height, and clear it
+ */
+static void
+clearback(width, height)
+int width, height;
+{
+	if (back == None || width != backwidth || height != backheight) {
+		if (back != None)
+			XFreePixmap(dpy, back);
+		back = XCreatePixmap(dpy, win, width, height, depth);
+		backwidth = width;
+		backheight = height;
+	}
+	XFillRectangle(dpy, back, cleargc, 0, 0, width, height);
+}
+
+/*
+ * Copy what is drawn onto the window
+ */
+static void
+showback()
+{
+	if (back != None)
+		XCopyArea(dpy, back, win, gc, 0, 0, backwidth, backheight, 0, 0);
+}
+
+/*
+ * Note how long it took to get something on the screen
+ */
+static void
+firstpaint()
+{
+	if (stats.firstpaint == 0) {
+		XFlush(dpy);
+		stats.firstpaint = stattime() - stats.start;
+	}
+}
+
+/*
+ * Height of a line of label text
+ */
+xtextheight()
+{
+	return res.font->ascent + res.font->descent;
 }
 
 xdrawrect(name, size, x, y, width, height)
 char *name;
-int size;
+char *size;	/* as it should be shown */
 int x, y, width, height;
 {
 	int	textx, texty;
@@ -389,10 +976,10 @@ int x, y, width, height;
 	int	cheight;
 
 	/*printf("draw(%d,%d,%d,%d)\n", x, y, width, height );*/
-	XDrawRectangle(dpy, win, gc, x, y, width, height);
+	XDrawRectangle(dpy, back, gc, x, y, width, height);
 
 	if (res.showsize) {
-		sprintf(label,"%s (%d)", name, size);
+		sprintf(label,"%s (%s)", name, size);
 		name = label;
 	}
 
@@ -404,8 +991,15 @@ int x, y, width, height;
 
 	/* print label */
 	textx = x + 4;
-	texty = y + height/2.0 + (overall.ascent - overall.descent)/2.0 + 1.5;
-	XDrawString(dpy, win, gc, textx, texty, name, strlen(name));
+	if (layout == LAYOUT_TREEMAP) {
+		/* along the top, children fill the rest of the box */
+		if (overall.width + 6 > width)
+			return;
+		texty = y + overall.ascent + 2;
+	} else {
+		texty = y + height/2.0 + (overall.ascent - overall.descent)/2.0 + 1.5;
+	}
+	XDrawString(dpy, back, gc, textx, texty, name, strlen(name));
 }
 
 static Widget popup;
@@ -457,12 +1051,22 @@ XDU Version 3.0 - Phil Dykstra <phil@arl.mil>\n\
 Keyboard Commands\n\
   a  sort alphabetically\n\
   n  sort numerically (largest first)\n\
+  g  sort by amount of change (diff mode)\n\
   f  sort first-in-first-out\n\
   l  sort last-in-first-out\n\
   r  reverse sort\n\
   s  toggle size display\n\
+  t  toggle treemap layout\n\
+  b  toggle apparent and allocated sizes (-scan)\n\
+  c  show size, own size, files, dirs or depth in turn\n\
+  o  sort by what is shown (largest first)\n\
+ ^F  find by name\n\
   /  goto the root\n\
   i  node info to standard out\n\
+  k  biggest things below here (K to standard out)\n\
+  e  space by extension below here (E to standard out)\n\
+  u  space by owner below here (U to standard out)\n\
+  p  profiling stats to standard out\n\
   h  this help message\n\
   q  quit (also Escape)\n\
 0-9  set number of columns (0=10)\n\
@@ -494,3 +1098,217 @@ help_popdown()
 {
 	XtPopdown(popup);
 }
+
+static Widget findpopup, findtext, findlist, findcount;
+static String foundlabels[MAXFOUND];
+static char foundbuf[MAXFOUND][MAXPATH+40];
+
+/*
+ * The text to find changed: find it again, and list the biggest
+ */
+static void c_findtext(w, data, call)
+Widget w;
+XtPointer data;
+XtPointer call;
+{
+	find_refresh();
+}
+
+/*
+ * One of the list was picked: go to it
+ */
+static void c_findpick(w, data, call)
+Widget w;
+XtPointer data;
+XtPointer call;
+{
+	XawListReturnStruct *lp = (XawListReturnStruct *)call;
+
+	if (lp->list_index >= 0 && lp->list_index < nfound)
+		gotonode(found[lp->list_index]);
+}
+
+static void
+find_refresh()
+{
+	String	text;
+	char	count[64], path[MAXPATH];
+	int	i, n;
+
+	if (findpopup == NULL)
+		return;
+	text = NULL;
+	XtVaGetValues(findtext, XtNstring, &text, NULL);
+	n = searchfind(text ? text : "", found, MAXFOUND);
+	nfound = (n < MAXFOUND) ? n : MAXFOUND;
+	for (i = 0; i < nfound; i++) {
+		sprintf(foundbuf[i], "%-12s ", sizelabel(found[i]));
+		strncat(foundbuf[i], searchpath(found[i], path), MAXPATH);
+		foundlabels[i] = foundbuf[i];
+	}
+	if (nfound == 0) {
+		strcpy(foundbuf[0], "");
+		foundlabels[0] = foundbuf[0];
+	}
+	XawListChange(findlist, foundlabels, nfound ? nfound : 1, 0, True);
+
+	if (nfound < n)
+		sprintf(count, "%d found, the biggest %d shown", n, nfound);
+	else
+		sprintf(count, "%d found", n);
+	XtVaSetValues(findcount, XtNlabel, count, NULL);
+}
+
+static void
+find_popup()
+{
+	Widget form, src;
+	Arg args[15];
+	int n;
+	Atom wm_delete_window;
+	XtTranslations trans_table;
+
+	if (findpopup != NULL) {
+		XtPopup(findpopup, XtGrabNone);
+		return;
+	}
+
+	/* popup shell */
+	n = 0;
+	XtSetArg(args[n], XtNtitle, "XDU Find"); n++;
+	findpopup = XtCreatePopupShell("findPopup", transientShellWidgetClass,
+		toplevel, args, n);
+
+	/* form container */
+	n = 0;
+	XtSetArg(args[n], XtNborderWidth, 0); n++;
+	form = XtCreateManagedWidget("form", formWidgetClass,
+		findpopup, args, n);
+
+	/* a line to type the name into */
+	n = 0;
+	XtSetArg(args[n], XtNeditType, XawtextEdit); n++;
+	XtSetArg(args[n], XtNwidth, 500); n++;
+	findtext = XtCreateManagedWidget("findText", asciiTextWidgetClass,
+		form, args, n);
+
+	/* how many were found */
+	n = 0;
+	XtSetArg(args[n], XtNlabel, ""); n++;
+	XtSetArg(args[n], XtNborderWidth, 0); n++;
+	XtSetArg(args[n], XtNwidth, 500); n++;
+	XtSetArg(args[n], XtNjustify, XtJustifyLeft); n++;
+	XtSetArg(args[n], XtNfromVert, findtext); n++;
+	findcount = XtCreateManagedWidget("findCount", labelWidgetClass,
+		form, args, n);
+
+	/* and the biggest of them */
+	foundlabels[0] = foundbuf[0];
+	n = 0;
+	XtSetArg(args[n], XtNlist, foundlabels); n++;
+	XtSetArg(args[n], XtNnumberStrings, 1); n++;
+	XtSetArg(args[n], XtNdefaultColumns, 1); n++;
+	XtSetArg(args[n], XtNforceColumns, True); n++;
+	XtSetArg(args[n], XtNwidth, 500); n++;
+	XtSetArg(args[n], XtNfromVert, findcount); n++;
+	findlist = XtCreateManagedWidget("findList", listWidgetClass,
+		form, args, n);
+	XtAddCallback(findlist, XtNcallback, c_findpick, NULL);
+
+	src = XawTextGetSource(findtext);
+	XtAddCallback(src, XtNcallback, c_findtext, NULL);
+
+	XtRealizeWidget(findpopup);
+	XtPopup(findpopup, XtGrabNone);
+
+	trans_table = XtParseTranslationTable("\
+<Key>Return: FindGo()\n\
+<Key>Escape: RemoveFind()");
+	XtOverrideTranslations(findtext, trans_table);
+
+	/* Set up ICCCM delete window */
+	wm_delete_window = XInternAtom(XtDisplay(findpopup), "WM_DELETE_WINDOW", False);
+	XtOverrideTranslations(findpopup, XtParseTranslationTable("<Message>WM_PROTOCOLS: RemoveFind()"));
+	XSetWMProtocols(XtDisplay(findpopup), XtWindow(findpopup), &wm_delete_window, 1);
+}
+
+static void
+find_popdown()
+{
+	XtPopdown(findpopup);
+}
+
+static Widget toppopup, toptextw;
+static char *topstring;
+
+/*
+ * Show a list made for the current root node (the biggest things
+ * below it, or its breakdown), in a popup with the title given.  The
+ * list is malloc'd, and is made again each time, for wherever we are
+ * then; the popup is shared by them all.
+ */
+static void
+text_popup(title, text)
+char *title;
+char *text;
+{
+	Widget form;
+	Arg args[15];
+	int n;
+	Atom wm_delete_window;
+	XtTranslations trans_table;
+
+	if (topstring != NULL)
+		free(topstring);
+	topstring = text;
+
+	if (toppopup != NULL) {
+		XtVaSetValues(toppopup, XtNtitle, title, NULL);
+		XtVaSetValues(toptextw, XtNstring, topstring, NULL);
+		XtPopup(toppopup, XtGrabNone);
+		return;
+	}
+
+	/* popup shell */
+	n = 0;
+	XtSetArg(args[n], XtNtitle, title); n++;
+	toppopup = XtCreatePopupShell("topPopup", transientShellWidgetClass,
+		toplevel, args, n);
+
+	/* form container */
+	n = 0;
+	XtSetArg(args[n], XtNborderWidth, 0); n++;
+	XtSetArg(args[n], XtNdefaultDistance, 0); n++;
+	form = XtCreateManagedWidget("form", formWidgetClass,
+		toppopup, args, n);
+
+	/* text widget in form, with the text in it */
+	n = 0;
+	XtSetArg(args[n], XtNborderWidth, 0); n++;
+	XtSetArg(args[n], XtNtype, XawAsciiString); n++;
+	XtSetArg(args[n], XtNeditType, XawtextRead); n++;
+	XtSetArg(args[n], XtNstring, topstring); n++;
+	XtSetArg(args[n], XtNscrollVertical, XawtextScrollWhenNeeded); n++;
+	XtSetArg(args[n], XtNwidth, 600); n++;
+	XtSetArg(args[n], XtNheight, 400); n++;
+	toptextw = XtCreateManagedWidget("top", asciiTextWidgetClass,
+		form, args, n);
+
+	XtRealizeWidget(toppopup);
+	XtPopup(toppopup, XtGrabNone);
+
+	trans_table = XtParseTranslationTable("<Key>Q: RemoveTop()");
+	XtAugmentTranslations(form, trans_table);
+	XtAugmentTranslations(toptextw, trans_table);
+
+	/* Set up ICCCM delete window */
+	wm_delete_window = XInternAtom(XtDisplay(toppopup), "WM_DELETE_WINDOW", False);
+	XtOverrideTranslations(toppopup, XtParseTranslationTable("<Message>WM_PROTOCOLS: RemoveTop()"));
+	XSetWMProtocols(XtDisplay(toppopup), XtWindow(toppopup), &wm_delete_window, 1);
+}
+
+static void
+text_popdown()
+{
+	XtPopdown(toppopup);
+}
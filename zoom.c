@@ -0,0 +1,310 @@
+/*
+ * XDU - Moving smoothly from one view to the next.
+ *
+ * When the display goes to a new top (a click, "/" or a find),
+ * rather than jumping there, each box can slide and stretch from
+ * where it was to where it is going, a frame at a time, so that it
+ * is easy to see where the new view came from.
+ *
+ * Both layouts are worked out once, at the start: the old one is
+ * in the nodes' rectangles already, and the new one is laid out as
+ * repaint() would, drawing nothing.  A frame is then just the boxes
+ * drawn part way between the two, with no laying out.
+ *
+ * A box in both views goes straight from one place to the other.  One
+ * in only one of them moves with the view: the new top (zooming in)
+ * or the old one (zooming out) is in both, and the rest go the way it
+ * goes, moved and stretched as it is.  If neither is in both views,
+ * there is nothing to move with, and the new view is just drawn.
+ *
+ * Copyright (c)	Phillip C. Dykstra	1991, 1993, 1994
+ * The X Consortium, and any party obtaining a copy of these files from
+ * the X Consortium, directly or indirectly, is granted, free of charge, a
+ * full and unrestricted irrevocable, world-wide, paid up, royalty-free,
+ * nonexclusive right and license to deal in this software and
+ * documentation files (the "Software"), including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons who receive
+ * copies from any such party to do so.  This license includes without
+ * limitation a license to do the foregoing actions under any patents of
+ * the party supplying this software to the X Consortium.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "xdu.h"
+#include "stats.h"
+
+/* as far off the window as a box is taken to go */
+#define	FARAWAY		100000.0
+
+/* EXPORTS: routines that this module exports outside */
+extern int zoomstart();
+extern void zoomframe();
+
+/* IMPORTS: routines that this module uses from xdu.c */
+extern struct node *drawnp;
+extern int repaint();
+extern int drawmore();
+
+/* internal routines */
+static int nodraw();
+static struct zoombox *addbox();
+static void oldboxes();
+static void newboxes();
+static int boxcmp();
+static struct rect moverect();
+
+/*
+ * Zoom Box Structure
+ * A node drawn in the old view or the new, and where it is in each
+ */
+struct zoombox {
+	struct	node *np;
+	struct	rect from;
+	struct	rect to;
+};
+static struct zoombox *boxes = NULL;
+static int nboxes = 0;
+static int maxboxes = 0;
+static int width, height;	/* of the display */
+
+/* how the view moves: x in the old view is x * sx + dx in the new */
+static double sx, dx, sy, dy;
+
+/*
+ * The display for laying out the new view
+ */
+static int
+nodraw()
+{
+	return	0;
+}
+
+/*
+ * A new box for np, where it is now
+ */
+static struct zoombox *
+addbox(np)
+struct node *np;
+{
+	if (nboxes >= maxboxes) {
+		maxboxes = maxboxes ? 2 * maxboxes : 1024;
+		boxes = (struct zoombox *)realloc((char *)boxes,
+			maxboxes * sizeof(struct zoombox));
+		if (boxes == NULL) {
+			fprintf(stderr, "xdu: out of memory\n");
+			exit(1);
+		}
+	}
+	boxes[nboxes].np = np;
+	boxes[nboxes].from = boxes[nboxes].to = np->rect;
+	return	&boxes[nboxes++];
+}
+
+/*
+ * Add a box for each node drawn from np down.  Nodes that weren't
+ * drawn can't have drawn descendants, as in clearrects().
+ */
+static void
+oldboxes(np)
+struct node *np;
+{
+	struct	node	*cp;
+
+	if (np->rect.width == 0)
+		return;
+	addbox(np);
+	for (cp = np->child; cp != NODE_NULL; cp = cp->peer)
+		oldboxes(cp);
+}
+
+static int
+boxcmp(b1, b2)
+struct zoombox *b1, *b2;
+{
+	if (b1->np == b2->np)
+		return	0;
+	return	(b1->np < b2->np) ? -1 : 1;
+}
+
+/*
+ * Add a box for each node drawn from np down that isn't amongst the
+ * first nold, those from the old view, in node order
+ */
+static void
+newboxes(np, nold)
+struct node *np;
+int nold;
+{
+	struct	node	*cp;
+	struct	zoombox	key;
+
+	if (np->rect.width == 0)
+		return;
+	key.np = np;
+	if (bsearch((char *)&key, (char *)boxes, nold, sizeof(struct zoombox),
+	    boxcmp) == NULL)
+		addbox(np);
+	for (cp = np->child; cp != NODE_NULL; cp = cp->peer)
+		newboxes(cp, nold);
+}
+
+/*
+ * Move a rectangle in the old view to where it goes in the new,
+ * or back the other way
+ */
+static struct rect
+moverect(r, back)
+struct rect r;
+int back;
+{
+	struct	rect	m;
+	double	x0, x1, y0, y1;
+
+	if (back) {
+		x0 = (r.left - dx) / sx;
+		x1 = (r.left + r.width - dx) / sx;
+		y0 = (r.top - dy) / sy;
+		y1 = (r.top + r.height - dy) / sy;
+	} else {
+		x0 = r.left * sx + dx;
+		x1 = (r.left + r.width) * sx + dx;
+		y0 = r.top * sy + dy;
+		y1 = (r.top + r.height) * sy + dy;
+	}
+	/* way off the display is far enough, and still fits in an int */
+	x0 = (x0 < -FARAWAY) ? -FARAWAY : (x0 > FARAWAY) ? FARAWAY : x0;
+	x1 = (x1 < -FARAWAY) ? -FARAWAY : (x1 > FARAWAY) ? FARAWAY : x1;
+	y0 = (y0 < -FARAWAY) ? -FARAWAY : (y0 > FARAWAY) ? FARAWAY : y0;
+	y1 = (y1 < -FARAWAY) ? -FARAWAY : (y1 > FARAWAY) ? FARAWAY : y1;
+	m.left = x0 + 0.5;
+	m.top = y0 + 0.5;
+	m.width = (int)(x1 + 0.5) - m.left;
+	m.height = (int)(y1 + 0.5) - m.top;
+	return	m;
+}
+
+/*
+ * The top has just gone from oldtop to topp: lay the new view out
+ * in a w by h display, and work out where everything goes.  Returns
+ * zero if there is no way to move from one view to the other, in
+ * which case the new view should just be drawn.
+ */
+int
+zoomstart(oldtop, w, h)
+struct node *oldtop;
+int w, h;
+{
+	static	struct	display layoutonly;
+	struct	display	*real;
+	struct	zoombox	*bp, *anchor;
+	double	t;
+	int	i, nold;
+
+	t = stattime();
+	width = w;
+	height = h;
+	nboxes = 0;
+	if (drawnp != NODE_NULL)
+		oldboxes(drawnp);
+	nold = nboxes;
+	qsort((char *)boxes, nold, sizeof(struct zoombox), boxcmp);
+
+	/* lay out the new view as repaint() would, without drawing it */
+	real = display;
+	layoutonly = *real;
+	layoutonly.drawrect = nodraw;
+	display = &layoutonly;
+	if (repaint(w, h))
+		while (drawmore())
+			;	/* all of it, not a budget's worth */
+	display = real;
+
+	/* what was drawn is in the new view if it still has a rectangle */
+	anchor = NULL;
+	for (i = 0; i < nold; i++) {
+		bp = &boxes[i];
+		if (bp->np->rect.width == 0)
+			continue;
+		bp->to = bp->np->rect;
+		if (bp->np == topp || (bp->np == oldtop && anchor == NULL))
+			anchor = bp;
+	}
+	if (anchor == NULL || anchor->from.width <= 0
+	 || anchor->from.height <= 0) {
+		stats.zoomtime += stattime() - t;
+		return	0;
+	}
+	sx = anchor->to.width / (double)anchor->from.width;
+	dx = anchor->to.left - anchor->from.left * sx;
+	sy = anchor->to.height / (double)anchor->from.height;
+	dy = anchor->to.top - anchor->from.top * sy;
+
+	/* those only in the old view go with it, as if they were still there */
+	for (i = 0; i < nold; i++) {
+		if (boxes[i].np->rect.width == 0)
+			boxes[i].to = moverect(boxes[i].from, 0);
+	}
+	/* and those only in the new come from where they would have been */
+	newboxes(topp, nold);
+	for (i = nold; i < nboxes; i++)
+		boxes[i].from = moverect(boxes[i].to, 1);
+
+	stats.zooms++;
+	stats.zoomtime += stattime() - t;
+	return	1;
+}
+
+/*
+ * Draw the boxes part way, f from 0 (the old view) to 1 (the new).
+ * They speed up at the start and slow down at the end.
+ */
+void
+zoomframe(f)
+double f;
+{
+	struct	zoombox	*bp;
+	struct	rect	r;
+	double	t, e, x1, y1;
+	int	i;
+
+	t = stattime();
+	e = f * f * (3 - 2 * f);
+	for (i = 0; i < nboxes; i++) {
+		bp = &boxes[i];
+		r.left = bp->from.left + (bp->to.left - bp->from.left) * e + 0.5;
+		r.top = bp->from.top + (bp->to.top - bp->from.top) * e + 0.5;
+		x1 = bp->from.left + bp->from.width + (bp->to.left + bp->to.width
+			- bp->from.left - bp->from.width) * e;
+		y1 = bp->from.top + bp->from.height + (bp->to.top + bp->to.height
+			- bp->from.top - bp->from.height) * e;
+		r.width = (int)(x1 + 0.5) - r.left;
+		r.height = (int)(y1 + 0.5) - r.top;
+
+		/* only what can be seen, and no further off the display */
+		if (r.width < 1 || r.height < 1 || r.left >= width
+		 || r.top >= height || r.left + r.width <= 0
+		 || r.top + r.height <= 0)
+			continue;
+		if (r.left < -1) {
+			r.width += r.left + 1;
+			r.left = -1;
+		}
+		if (r.top < -1) {
+			r.height += r.top + 1;
+			r.top = -1;
+		}
+		if (r.left + r.width > width + 1)
+			r.width = width + 1 - r.left;
+		if (r.top + r.height > height + 1)
+			r.height = height + 1 - r.top;
+		(*display->drawrect)(NAME(bp->np), sizelabel(bp->np),
+			r.left, r.top, r.width, r.height);
+		stats.zoomboxes++;
+	}
+	t = stattime() - t;
+	stats.zoomframes++;
+	stats.zoomtime += t;
+	if (t > stats.zoomslowest)
+		stats.zoomslowest = t;
+}